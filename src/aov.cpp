@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+
+#include "aov.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+AovLayers::AovLayers(int resolution_x, int resolution_y) {
+  _resolution[0] = resolution_x;
+  _resolution[1] = resolution_y;
+  for (std::vector<float>& layer : _layers) {
+    layer.assign(static_cast<size_t>(resolution_x) * resolution_y, 0);
+  }
+}
+
+/**
+ * @brief Store the cost of a pixel.
+ *
+ * @param pixel pixel cordinate as {x, y}.
+ * @param counters work done while tracing the pixel.
+ * @param seconds time needed for the pixel.
+ */
+void AovLayers::set_pixel(point pixel, const pixel_counters& counters,
+                          float seconds) {
+  size_t index =
+      static_cast<size_t>(_resolution[1] - 1 - pixel.y) * _resolution[0] +
+      pixel.x;
+  _layers[AOV_NODES][index] = counters.nodes;
+  _layers[AOV_TRIANGLES][index] = counters.triangles;
+  _layers[AOV_SHADOW_RAYS][index] = counters.shadow_rays;
+  _layers[AOV_TIME][index] = seconds;
+}
+
+std::string AovLayers::get_name(aov_layer layer) {
+  switch (layer) {
+    case AOV_NODES:
+      return "nodes";
+    case AOV_TRIANGLES:
+      return "triangles";
+    case AOV_SHADOW_RAYS:
+      return "shadow_rays";
+    case AOV_TIME:
+      return "time";
+  }
+  return "";
+}
+
+void AovLayers::write_to_files(std::string prefix) {
+  for (int i = 0; i < AOV_LAYER_COUNT; i++) {
+    std::string name = prefix + "_" + get_name(static_cast<aov_layer>(i));
+    const std::vector<float>& layer = _layers[i];
+
+    // raw values, the same value in all three channels
+    std::vector<float> rgb(layer.size() * 3);
+    for (size_t p = 0; p < layer.size(); p++) {
+      rgb[p * 3] = rgb[p * 3 + 1] = rgb[p * 3 + 2] = layer[p];
+    }
+    ImageWriter writer(name + ".pfm", _resolution[0], _resolution[1]);
+    writer.write_rows(rgb.data(), _resolution[1]);
+    writer.finish();
+
+    write_heatmap(name + ".png", layer);
+  }
+}
+
+void AovLayers::write_heatmap(std::string filename,
+                              const std::vector<float>& layer) {
+  // scale to a high percentile, so single outliers do not hide the rest
+  std::vector<float> sorted = layer;
+  size_t n = (sorted.size() - 1) * AOV_HEATMAP_PERCENTILE;
+  std::nth_element(sorted.begin(), sorted.begin() + n, sorted.end());
+  float max = sorted[n];
+  if (max <= 0) {
+    max = 1;
+  }
+  std::cout << filename << ": 0 - " << max << "\n";
+
+  std::vector<unsigned char> rgb(layer.size() * 3);
+  for (size_t p = 0; p < layer.size(); p++) {
+    vec3 color = get_heat_color(std::min(layer[p] / max, 1.f)) * 255.f;
+    rgb[p * 3] = color.x;
+    rgb[p * 3 + 1] = color.y;
+    rgb[p * 3 + 2] = color.z;
+  }
+  ImageWriter writer(filename, _resolution[0], _resolution[1]);
+  writer.write_rows(rgb.data(), _resolution[1]);
+  writer.finish();
+}
+
+/**
+ * @brief Map a value between 0 and 1 to a color (black, blue, red, yellow,
+ * white).
+ */
+vec3 AovLayers::get_heat_color(float value) {
+  const vec3 colors[5] = {vec3(0, 0, 0), vec3(0.1, 0.1, 0.8),
+                          vec3(0.9, 0.1, 0.1), vec3(1, 0.9, 0),
+                          vec3(1, 1, 1)};
+  float position = value * 4;
+  int i = std::min(static_cast<int>(position), 3);
+  return glm::mix(colors[i], colors[i + 1], position - i);
+}
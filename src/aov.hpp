@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "image.hpp"
+#include "objects/traversal_stats.hpp"
+
+// values above this percentile get the hottest color in the heatmaps
+#define AOV_HEATMAP_PERCENTILE 0.99f
+
+enum aov_layer { AOV_NODES, AOV_TRIANGLES, AOV_SHADOW_RAYS, AOV_TIME };
+
+#define AOV_LAYER_COUNT 4
+
+/**
+ * @brief Per pixel cost layers rendered next to the beauty image.
+ *
+ * Every layer is written as pfm with the raw values (counts or seconds) and
+ * as png heatmap scaled to the AOV_HEATMAP_PERCENTILE of the layer. Node and
+ * triangle counts need GET_STATS.
+ */
+class AovLayers {
+ public:
+  AovLayers(int resolution_x, int resolution_y);
+
+  void set_pixel(point pixel, const pixel_counters& counters, float seconds);
+
+  /// @brief writes <prefix>_<layer>.pfm and <prefix>_<layer>.png.
+  void write_to_files(std::string prefix);
+
+  static std::string get_name(aov_layer layer);
+
+ private:
+  void write_heatmap(std::string filename, const std::vector<float>& layer);
+  vec3 get_heat_color(float value);
+
+  int _resolution[2];
+  /// @brief row major with the top row first (same as Image).
+  std::array<std::vector<float>, AOV_LAYER_COUNT> _layers;
+};
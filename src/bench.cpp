@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "benchmark.hpp"
+#include "scenes/scenes.hpp"
+
+/**
+ * Benchmark driver, selects scene and acceleration structure at runtime and
+ * writes the measured metrics as json.
+ *
+ * usage: bench [--scene name] [--algorithm grid|sah|lbvh|hlbvh|mid]
+ *              [--integrator recursive|wavefront] [--packets]
+ *              [--light-tree]
+ *              [--threads n] [--resolution WxH] [--samples 1|2|4|5]
+ *              [--warmup n] [--iterations n] [--output file.json]
+ *              [--aov prefix] [--capture file.rays]
+ *              [--bvh-report file.json] [--trace file.json]
+ *              [--perf-counters]
+ *              [--cost-traversal c] [--cost-intersect c] [--autotune]
+ *              [--triangles n] [--distribution uniform|clustered|thin|nested]
+ *              [--spheres n] [--seed n] [--list]
+ *
+ * --autotune builds every mesh with the parameters of its tuning file (and
+ * tunes the meshes without one), it replaces --algorithm.
+ *
+ * --threads caps the threads of building and rendering (the tiles of a strip
+ * and the stages of the wavefront integrator run in parallel), 0 uses all.
+ *
+ * --integrator wavefront renders in stages over ray queues (same image, see
+ * WavefrontIntegrator), cost layers are still rendered recursively.
+ *
+ * --packets traces the camera rays of the recursive integrator in packets of
+ * 4x4 pixels (same image).
+ *
+ * --light-tree shades scenes with many point lights with light cuts (see
+ * Scene::add_light_cut), this approximates the light of the clusters.
+ *
+ * --capture records all rays of an extra render for the replay tool.
+ *
+ * --trace writes the timeline of loading, building and rendering as Chrome
+ * trace-event json (open with chrome://tracing or Perfetto).
+ *
+ * --perf-counters adds cycles, instructions, L1D/LLC misses and branch misses
+ * of the build, primary rays, shadow rays and shading (per phase and per
+ * thread) to the json. Reading the counters slows the timed renders down. If
+ * perf events are not allowed (see /proc/sys/kernel/perf_event_paranoid) the
+ * counters are reported as unavailable.
+ *
+ * --triangles, --distribution, --spheres and --seed configure the generated
+ * scene "synthetic" (e.g. for scaling runs from 10^3 to 10^8 triangles).
+ */
+
+void print_usage() {
+  std::cerr << "usage: bench [--scene name] "
+               "[--algorithm grid|sah|lbvh|hlbvh|mid]\n"
+               "             [--integrator recursive|wavefront] [--packets]\n"
+               "             [--light-tree]\n"
+               "             [--threads n] [--resolution WxH] "
+               "[--samples 1|2|4|5]\n"
+               "             [--warmup n] [--iterations n] "
+               "[--output file.json]\n"
+               "             [--aov prefix] [--capture file.rays] "
+               "[--bvh-report file.json]\n"
+               "             [--trace file.json] [--perf-counters]\n"
+               "             [--cost-traversal c] [--cost-intersect c] "
+               "[--autotune]\n"
+               "             [--triangles n] "
+               "[--distribution uniform|clustered|thin|nested]\n"
+               "             [--spheres n] [--seed n] [--list]\n";
+}
+
+bench_options parse_options(int argc, char **argv) {
+  bench_options options;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--list") {
+      for (const auto &entry : scenes::get_registry()) {
+        std::cout << entry.first << "\n";
+      }
+      exit(0);
+    }
+    if (arg == "--autotune") {
+      options.autotune = true;
+      continue;
+    }
+    if (arg == "--packets") {
+      options.primary_packets = true;
+      continue;
+    }
+    if (arg == "--light-tree") {
+      options.light_tree = true;
+      continue;
+    }
+    if (arg == "--perf-counters") {
+      options.perf_counters = true;
+      continue;
+    }
+    if (arg == "--help" || i + 1 >= argc) {
+      print_usage();
+      exit(arg == "--help" ? 0 : 1);
+    }
+
+    std::string value = argv[++i];
+    if (arg == "--scene") {
+      options.scene = value;
+    } else if (arg == "--algorithm") {
+      options.algorithm = value;
+    } else if (arg == "--integrator") {
+      if (bench_integrators.find(value) == bench_integrators.end()) {
+        throw std::invalid_argument("unknown integrator: " + value);
+      }
+      options.integrator = bench_integrators.at(value);
+    } else if (arg == "--threads") {
+      options.threads = std::stoi(value);
+    } else if (arg == "--resolution") {
+      if (sscanf(value.c_str(), "%dx%d", &options.width, &options.height) !=
+          2) {
+        throw std::invalid_argument("resolution has to be WxH: " + value);
+      }
+    } else if (arg == "--samples") {
+      options.samples = std::stoi(value);
+    } else if (arg == "--warmup") {
+      options.warmup = std::stoi(value);
+    } else if (arg == "--iterations") {
+      options.iterations = std::max(1, std::stoi(value));
+    } else if (arg == "--output") {
+      options.output = value;
+    } else if (arg == "--aov") {
+      options.aov = value;
+    } else if (arg == "--capture") {
+      options.capture = value;
+    } else if (arg == "--trace") {
+      options.trace = value;
+    } else if (arg == "--bvh-report") {
+      options.bvh_report = value;
+    } else if (arg == "--cost-traversal") {
+      options.report_settings.cost_traversal = std::stof(value);
+    } else if (arg == "--cost-intersect") {
+      options.report_settings.cost_intersect = std::stof(value);
+    } else if (arg == "--triangles") {
+      options.generator.triangles = std::stoull(value);
+    } else if (arg == "--distribution") {
+      if (bench_distributions.find(value) == bench_distributions.end()) {
+        throw std::invalid_argument("unknown distribution: " + value);
+      }
+      options.generator.distribution = bench_distributions.at(value);
+    } else if (arg == "--spheres") {
+      options.generator.spheres = std::stoul(value);
+    } else if (arg == "--seed") {
+      options.generator.seed = std::stoul(value);
+    } else {
+      print_usage();
+      exit(1);
+    }
+  }
+  return options;
+}
+
+int main(int argc, char **argv) {
+  bench_options options;
+  try {
+    options = parse_options(argc, argv);
+  } catch (const std::exception &e) {
+    // std::stoi and std::stof throw on values that are no numbers
+    std::cerr << "invalid option: " << e.what() << "\n";
+    print_usage();
+    return 1;
+  }
+
+  // keep stdout for the json, progress of the renderer goes to stderr
+  std::streambuf *stdout_buffer = std::cout.rdbuf(std::cerr.rdbuf());
+
+  bench_result result;
+  try {
+    result = run_benchmark(options);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  // write json
+  std::ofstream file;
+  std::ostream stdout_stream(stdout_buffer);
+  if (!options.output.empty()) {
+    file.open(options.output);
+    if (file.fail()) {
+      std::cerr << "could not open " << options.output << "\n";
+      return 1;
+    }
+  }
+  std::ostream &out = options.output.empty() ? stdout_stream : file;
+
+  std::string algorithm =
+      options.algorithm.empty() ? "scene" : options.algorithm;
+  if (options.autotune) {
+    algorithm = "autotune";
+  }
+  out << "{\n";
+  out << "  \"scene\": \"" << options.scene << "\",\n";
+  out << "  \"algorithm\": \"" << algorithm << "\",\n";
+  out << "  \"integrator\": \""
+      << (options.integrator == IWAVEFRONT ? "wavefront" : "recursive")
+      << "\",\n";
+  out << "  \"primary_packets\": "
+      << (options.primary_packets ? "true" : "false") << ",\n";
+  out << "  \"light_tree\": " << (options.light_tree ? "true" : "false")
+      << ",\n";
+  out << "  \"triangles\": " << result.triangles << ",\n";
+  out << "  \"threads\": " << options.threads << ",\n";
+  out << "  \"resolution\": [" << result.resolution.x << ", "
+      << result.resolution.y << "],\n";
+  out << "  \"samples\": " << options.samples << ",\n";
+  out << "  \"warmup\": " << options.warmup << ",\n";
+  out << "  \"iterations\": " << options.iterations << ",\n";
+  out << "  \"load_time\": " << result.load_time << ",\n";
+  out << "  \"build_time\": " << result.build_time << ",\n";
+  out << "  \"render_time\": {\"mean\": " << result.get_mean_render_time()
+      << ", \"min\": " << result.get_min_render_time()
+      << ", \"max\": " << result.get_max_render_time() << "},\n";
+  out << "  \"render_times\": [";
+  for (size_t i = 0; i < result.render_times.size(); i++) {
+    out << (i == 0 ? "" : ", ") << result.render_times[i];
+  }
+  out << "],\n";
+  out << "  \"rays\": " << result.rays << ",\n";
+  out << "  \"mrays_per_sec\": " << result.get_mrays_per_sec() << ",\n";
+  out << "  \"nodes_per_ray\": " << result.nodes_per_ray << ",\n";
+  out << "  \"triangles_per_ray\": " << result.triangles_per_ray << ",\n";
+  out << "  \"checksum\": \"" << std::hex << result.checksum << std::dec
+      << "\",\n";
+  out << "  \"peak_rss_mb\": " << result.peak_rss << ",\n";
+  out << "  \"memory_build\": ";
+  write_memory_json(&out, result.memory_build, "  ");
+  out << ",\n  \"memory\": ";
+  write_memory_json(&out, result.memory, "  ");
+  if (options.perf_counters) {
+    out << ",\n  \"perf_counters\": ";
+    write_perf_json(&out, result.perf, "  ");
+  }
+  out << "\n";
+  out << "}\n";
+
+  std::cout.rdbuf(stdout_buffer);
+  return 0;
+}
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+
+#include "benchmark.hpp"
+
+#include <sys/resource.h>
+#include <tbb/global_control.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+
+#include "objects/perf_counters.hpp"
+#include "objects/timeline.hpp"
+#include "scenes/scenes.hpp"
+
+const std::map<std::string, Algorithm> bench_algorithms = {{"grid", AGRID},
+                                                           {"sah", ASAH},
+                                                           {"lbvh", ALBVH},
+                                                           {"hlbvh", AHLBVH},
+                                                           {"mid", AMID}};
+
+const std::map<std::string, Distribution> bench_distributions = {
+    {"uniform", DUNIFORM},
+    {"clustered", DCLUSTERED},
+    {"thin", DTHIN},
+    {"nested", DNESTED}};
+
+const std::map<std::string, Integrator> bench_integrators = {
+    {"recursive", IRECURSIVE}, {"wavefront", IWAVEFRONT}};
+
+namespace {
+
+/// @brief sum of the intersection stats of all meshes.
+mesh_stats get_mesh_stats(Scene *scene) {
+  mesh_stats sum;
+  for (size_t i = 0; i < scene->get_mesh_count(); i++) {
+    mesh_stats stats = scene->get_obj_mesh(i)->get_stats();
+    sum.intersects += stats.intersects;
+    sum.node_intersects += stats.node_intersects;
+    sum.triangle_intersects += stats.triangle_intersects;
+    sum.time_building += stats.time_building;
+  }
+  return sum;
+}
+
+/// @brief writes the BVH quality reports of all meshes as json array (null
+/// for meshes with a uniform grid).
+void write_bvh_reports(Scene *scene, const bench_options &options) {
+  std::ofstream file(options.bvh_report);
+  if (file.fail()) {
+    throw std::runtime_error("could not open " + options.bvh_report);
+  }
+  file << "[\n";
+  for (size_t i = 0; i < scene->get_mesh_count(); i++) {
+    Mesh *mesh = scene->get_obj_mesh(i);
+    if (mesh->get_build_parameters().algorithm == AGRID) {
+      file << "  null";
+    } else {
+      write_bvh_report_json(
+          &file, mesh->get_bvh_report(options.report_settings), "  ");
+    }
+    file << (i + 1 < scene->get_mesh_count() ? ",\n" : "\n");
+  }
+  file << "]\n";
+}
+
+}  // namespace
+
+float bench_result::get_mean_render_time() const {
+  float sum = 0;
+  for (float t : render_times) {
+    sum += t;
+  }
+  return render_times.empty() ? 0 : sum / render_times.size();
+}
+
+float bench_result::get_min_render_time() const {
+  return render_times.empty()
+             ? 0
+             : *std::min_element(render_times.begin(), render_times.end());
+}
+
+float bench_result::get_max_render_time() const {
+  return render_times.empty()
+             ? 0
+             : *std::max_element(render_times.begin(), render_times.end());
+}
+
+double bench_result::get_mrays_per_sec() const {
+  float time = get_mean_render_time();
+  return time > 0 ? rays / time / 1000000.0 : 0;
+}
+
+Scene load_scene(const bench_options &options) {
+  auto registry = scenes::get_registry();
+  if (registry.find(options.scene) == registry.end()) {
+    throw std::invalid_argument("unknown scene: " + options.scene);
+  }
+  if (!options.algorithm.empty() &&
+      bench_algorithms.find(options.algorithm) == bench_algorithms.end()) {
+    throw std::invalid_argument("unknown algorithm: " + options.algorithm);
+  }
+
+  // the meshes are built once while the scene is constructed, so load_time
+  // and the memory peak only contain the requested structure
+  std::optional<mesh_build> build;
+  if (options.autotune) {
+    build = mesh_build();
+    build->autotune = true;
+  } else if (!options.algorithm.empty()) {
+    build = bench_algorithms.at(options.algorithm);
+  }
+  if (options.scene == "synthetic") {
+    generator_settings settings = options.generator;
+    if (build) {
+      settings.build = *build;
+    }
+    return scenes::synthetic::get_scene(settings);
+  }
+  return registry.at(options.scene)(build);
+}
+
+bench_result run_benchmark(const bench_options &options) {
+  std::unique_ptr<tbb::global_control> thread_limit;
+  if (options.threads > 0) {
+    thread_limit = std::make_unique<tbb::global_control>(
+        tbb::global_control::max_allowed_parallelism, options.threads);
+  }
+
+  if (!options.trace.empty()) {
+    Timeline::get_instance().clear();
+    Timeline::get_instance().enable();
+  }
+  PerfCounters &counters = PerfCounters::get_instance();
+  if (options.perf_counters) {
+    counters.clear();
+    counters.enable();
+  }
+
+  bench_result result;
+
+  // load scene and build acceleration structures
+  std::chrono::steady_clock::time_point begin =
+      std::chrono::steady_clock::now();
+  Scene scene = load_scene(options);
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  result.load_time =
+      std::chrono::duration_cast<std::chrono::microseconds>(end - begin)
+          .count() /
+      1000000.0;
+  result.build_time = get_mesh_stats(&scene).time_building;
+  counters.disable();
+  result.memory_build = MemoryStats::get_instance().get_report();
+  for (size_t i = 0; i < scene.get_mesh_count(); i++) {
+    result.triangles += scene.get_obj_mesh(i)->get_size();
+  }
+
+  if (!options.bvh_report.empty()) {
+    write_bvh_reports(&scene, options);
+  }
+
+  // render settings
+  Camera *camera = scene.get_camera();
+  if (options.width > 0 && options.height > 0) {
+    // keep sensor height, adapt width to the new aspect ratio
+    vec2 sensor = camera->get_sensor_size();
+    camera->set_resolution(options.width, options.height);
+    camera->set_sensor_size(sensor.y * options.width / options.height,
+                            sensor.y);
+  }
+  if (options.samples > 0) {
+    scene.set_aliasing(options.samples);
+  }
+  result.resolution = camera->get_resolution();
+  scene.set_integrator(options.integrator);
+  scene.set_primary_packets(options.primary_packets);
+  scene.set_light_tree(options.light_tree);
+
+  for (int i = 0; i < options.warmup; i++) {
+    scene.trace_image();
+  }
+
+  mesh_stats stats_before = get_mesh_stats(&scene);
+  uint64_t rays_before = scene.get_stats().rays;
+  if (options.perf_counters) {
+    counters.enable();
+  }
+  for (int i = 0; i < options.iterations; i++) {
+    Image image = scene.trace_image();
+    result.render_times.push_back(scene.get_stats().time_rendering);
+    result.checksum = image.get_checksum();
+  }
+  if (options.perf_counters) {
+    counters.disable();
+    result.perf = counters.get_report();
+  }
+  result.memory = MemoryStats::get_instance().get_report();
+  mesh_stats stats_after = get_mesh_stats(&scene);
+
+  int iterations = std::max(options.iterations, 1);
+  result.rays = (scene.get_stats().rays - rays_before) / iterations;
+  uint64_t intersects = stats_after.intersects - stats_before.intersects;
+  double nodes = stats_after.node_intersects - stats_before.node_intersects;
+  double triangles =
+      stats_after.triangle_intersects - stats_before.triangle_intersects;
+  if (intersects != 0) {
+    result.nodes_per_ray = nodes / intersects;
+    result.triangles_per_ray = triangles / intersects;
+  }
+
+  // cost layers and the ray capture are written by an extra render, so they
+  // do not skew timings
+  if (!options.aov.empty() || !options.capture.empty()) {
+    scene.set_aov_output(options.aov);
+    scene.set_ray_capture(options.capture);
+    scene.trace_image();
+  }
+  if (!options.trace.empty()) {
+    Timeline::get_instance().disable();
+    Timeline::get_instance().write_chrome_trace(options.trace);
+  }
+  result.peak_rss = get_peak_rss();
+  return result;
+}
+
+float get_peak_rss() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  // ru_maxrss is in KiB on linux
+  return usage.ru_maxrss / 1024.f;
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "objects/bvh_report.hpp"
+#include "objects/memory_stats.hpp"
+#include "objects/perf_counters.hpp"
+#include "scene.hpp"
+#include "scene_generator.hpp"
+
+/// @brief settings of one benchmark run (see bench and regression).
+struct bench_options {
+  std::string scene = "performance";
+  std::string algorithm = "";
+  Integrator integrator = IRECURSIVE;
+  /// @brief camera ray packets of the recursive integrator.
+  bool primary_packets = false;
+  /// @brief light cuts for scenes with many point lights.
+  bool light_tree = false;
+  int threads = 0;
+  int width = 0;
+  int height = 0;
+  int samples = 0;
+  int warmup = 1;
+  int iterations = 3;
+  std::string output = "";
+  std::string aov = "";
+  std::string capture = "";
+  /// @brief chrome trace of load, build and render zones (empty disables).
+  std::string trace = "";
+  /// @brief hardware counters of the build and the timed renders (slows the
+  /// rendering down, every phase change reads the counters).
+  bool perf_counters = false;
+  std::string bvh_report = "";
+  bvh_report_settings report_settings;
+  bool autotune = false;
+  /// @brief primitives of the scene "synthetic".
+  generator_settings generator;
+};
+
+struct bench_result {
+  float load_time = 0;
+  float build_time = 0;
+  std::vector<float> render_times;
+  /// @brief rays per rendered image.
+  uint64_t rays = 0;
+  double nodes_per_ray = 0;
+  double triangles_per_ray = 0;
+  float peak_rss = 0;
+  /// @brief triangles of all meshes.
+  uint64_t triangles = 0;
+  vec2 resolution = vec2(0);
+  /// @brief checksum of the last rendered image.
+  uint64_t checksum = 0;
+  /// @brief accounted memory after loading and building the scene.
+  memory_report memory_build;
+  /// @brief accounted memory after the timed renders.
+  memory_report memory;
+  /// @brief counters per phase and thread if options.perf_counters is set.
+  perf_report perf;
+
+  float get_mean_render_time() const;
+  float get_min_render_time() const;
+  float get_max_render_time() const;
+  /// @brief million rays per second of the mean render time.
+  double get_mrays_per_sec() const;
+};
+
+extern const std::map<std::string, Algorithm> bench_algorithms;
+extern const std::map<std::string, Distribution> bench_distributions;
+extern const std::map<std::string, Integrator> bench_integrators;
+
+/**
+ * @brief Load the scene and build the acceleration structures with the
+ * algorithm (or tuning) of options.
+ *
+ * Throws std::invalid_argument for unknown scenes or algorithms.
+ */
+Scene load_scene(const bench_options &options);
+
+/**
+ * @brief Load the scene, build the acceleration structures and time the
+ * rendering as configured in options.
+ *
+ * Throws std::invalid_argument for unknown scenes or algorithms.
+ */
+bench_result run_benchmark(const bench_options &options);
+
+/// @brief peak resident set size of the process in MiB.
+float get_peak_rss();
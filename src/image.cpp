@@ -4,8 +4,11 @@
 
 #include "image.hpp"
 
-#include <fstream>
-#include <iostream>
+#include <algorithm>
+#include <execution>
+#include <numeric>
+
+#include "objects/timeline.hpp"
 
 /**
  * @brief Construct a new Image:: Image object
@@ -17,33 +20,28 @@ Image::Image(int resolution_x, int resolution_y) {
   _resolution[0] = resolution_x;
   _resolution[1] = resolution_y;
 
-  // initialize all pixels to light-blue
-  initialize_matrix(vec3(0, 0, 0));
+  // initialize all pixels to black
+  _pixels.assign(static_cast<size_t>(resolution_x) * resolution_y, vec3(0));
+  _pixel_memory.set(get_vector_bytes(_pixels));
 }
 
 Image::Image(const Image& old_image) {
-  std::cout << "copy image\n";
   _resolution[0] = old_image._resolution[0];
   _resolution[1] = old_image._resolution[1];
-
-  delete_matrix();
-  initialize_matrix(vec3(0));
-  copy_matrix(_matrix, old_image._matrix);
+  _pixels = old_image._pixels;
+  _pixel_memory = old_image._pixel_memory;
+  _tonemapping_scale = old_image._tonemapping_scale;
 }
 Image& Image::operator=(const Image& old_image) {
-  std::cout << "copy assign image\n";
   _resolution[0] = old_image._resolution[0];
   _resolution[1] = old_image._resolution[1];
-
-  delete_matrix();
-  initialize_matrix(vec3(0));
-  copy_matrix(_matrix, old_image._matrix);
+  _pixels = old_image._pixels;
+  _pixel_memory = old_image._pixel_memory;
+  _tonemapping_scale = old_image._tonemapping_scale;
 
   return *this;
 }
 
-Image::~Image() { delete_matrix(); }
-
 /**
  * @brief Set color value for a specific pixel.
  *
@@ -57,20 +55,43 @@ void Image::set_pixel(point pixel, vec3 color) {
       color[i] = 0;
     }
   }
-  _matrix[pixel.x][pixel.y] = color;
+  _pixels[get_index(pixel)] = color;
 }
 
-void Image::apply_tonemapping(float middle_gray) {
-  float avg_luminance = get_average_luminance();
-  for (int y = _resolution[1] - 1; y >= 0; y--) {
-    for (int x = 0; x < _resolution[0]; x++) {
-      float l_p = middle_gray / avg_luminance * get_luminance(_matrix[x][y]);
+vec3 Image::get_pixel(point pixel) { return _pixels[get_index(pixel)]; }
+int Image::get_width() { return _resolution[0]; }
+int Image::get_height() { return _resolution[1]; }
 
-      float new_luminance = l_p / (1 + l_p);
+const vec3* Image::get_row(int row) {
+  return _pixels.data() + static_cast<size_t>(row) * _resolution[0];
+}
 
-      apply_luminance(&_matrix[x][y], new_luminance);
+uint64_t Image::get_checksum() {
+  uint64_t hash = 14695981039346656037ull;
+  for (const vec3& pixel : _pixels) {
+    for (int c = 0; c < 3; c++) {
+      hash ^= static_cast<uint64_t>(std::clamp(pixel[c], 0.f, 255.f) + 0.5f);
+      hash *= 1099511628211ull;
     }
   }
+  return hash;
+}
+
+size_t Image::get_index(point pixel) {
+  return static_cast<size_t>(_resolution[1] - 1 - pixel.y) * _resolution[0] +
+         pixel.x;
+}
+
+/**
+ * @brief Enable tonemapping of the image.
+ *
+ * Only the log-average luminance is computed here, the pixels get tonemapped
+ * together with clamping and quantization when they are written.
+ *
+ * @param middle_gray key value of the image.
+ */
+void Image::apply_tonemapping(float middle_gray) {
+  _tonemapping_scale = middle_gray / get_average_luminance();
 }
 
 /**
@@ -79,76 +100,85 @@ void Image::apply_tonemapping(float middle_gray) {
  * @param filename Path of outputfile.
  */
 void Image::write_to_file(std::string filename) {
-  // initialise File
-  std::ofstream file(filename);
-
-  // File header
-  file << "P3\n" << _resolution[0] << " " << _resolution[1] << "\n255\n";
-
-  // Picture Content
-  for (int y = _resolution[1] - 1; y >= 0; y--) {
-    for (int x = 0; x < _resolution[0]; x++) {
-      vec3 color = _matrix[x][y];
-      file << static_cast<int>(color[0]) << " " << static_cast<int>(color[1])
-           << " " << static_cast<int>(color[2]) << "\n";
-    }
-  }
-  file.close();
+  ImageWriter writer(filename, _resolution[0], _resolution[1]);
+  write_rows(&writer, _resolution[1]);
 }
 
 /**
- * @brief initialize the image matrix.
+ * @brief Stream the next rows which are not yet in the file.
+ *
+ * Tonemapping, clamping and quantization are done in one parallel pass over
+ * the rows before they are handed to the writer.
  *
- * @param standart_color start pixel value.
+ * @param writer writer of the output file.
+ * @param count number of rows to write.
  */
-float Image::get_luminance(vec3 color) {
-  // formula from
-  // https://stackoverflow.com/questions/596216/formula-to-determine-perceived-brightness-of-rgb-color
-  return 0.2126 * color.x + 0.7152 * color.y + 0.0722 * color.z;
-}
-float Image::get_average_luminance() {
-  float avg_luminance = 0;
-  for (int y = _resolution[1] - 1; y >= 0; y--) {
-    for (int x = 0; x < _resolution[0]; x++) {
-      avg_luminance += glm::log(get_luminance(_matrix[x][y]));
-    }
+void Image::write_rows(ImageWriter* writer, int count) {
+  TIMELINE_ZONE("write image rows");
+  int first_row = writer->get_next_row();
+  count = std::min(count, _resolution[1] - first_row);
+  if (count <= 0) {
+    return;
   }
-  avg_luminance /= (_resolution[0] * _resolution[1]);
-  return glm::exp(avg_luminance);
-}
-void Image::apply_luminance(vec3* color, float luminance) {
-  (*color).x *= luminance;
-  (*color).y *= luminance;
-  (*color).z *= luminance;
-}
 
-void Image::initialize_matrix(vec3 standart_color) {
-  _matrix = new vec3*[_resolution[0]];
-  for (int i = 0; i < _resolution[0]; i++) {
-    _matrix[i] = new vec3[_resolution[1]];
-  }
-
-  // set initial values
-  for (int x = 0; x < _resolution[0]; x++) {
-    for (int y = 0; y < _resolution[1]; y++) {
-      _matrix[x][y] = standart_color;
-    }
+  std::vector<int> rows(count);
+  std::iota(rows.begin(), rows.end(), first_row);
+  size_t offset = static_cast<size_t>(first_row) * _resolution[0];
+  size_t size = static_cast<size_t>(count) * _resolution[0] * 3;
+
+  if (writer->get_format() == FORMAT_PFM) {
+    std::vector<float> buffer(size);
+    std::for_each(std::execution::par_unseq, rows.begin(), rows.end(),
+                  [&](int row) {
+                    size_t begin = static_cast<size_t>(row) * _resolution[0];
+                    for (size_t i = begin; i < begin + _resolution[0]; i++) {
+                      vec3 color = postprocess(_pixels[i]) / 255.f;
+                      float* out = &buffer[(i - offset) * 3];
+                      out[0] = color.x;
+                      out[1] = color.y;
+                      out[2] = color.z;
+                    }
+                  });
+    writer->write_rows(buffer.data(), count);
+  } else {
+    std::vector<unsigned char> buffer(size);
+    std::for_each(std::execution::par_unseq, rows.begin(), rows.end(),
+                  [&](int row) {
+                    size_t begin = static_cast<size_t>(row) * _resolution[0];
+                    for (size_t i = begin; i < begin + _resolution[0]; i++) {
+                      vec3 color =
+                          glm::clamp(postprocess(_pixels[i]), 0.f, 255.f);
+                      unsigned char* out = &buffer[(i - offset) * 3];
+                      out[0] = static_cast<unsigned char>(color.x);
+                      out[1] = static_cast<unsigned char>(color.y);
+                      out[2] = static_cast<unsigned char>(color.z);
+                    }
+                  });
+    writer->write_rows(buffer.data(), count);
   }
 }
 
-void Image::copy_matrix(vec3** new_matrix, vec3** old_matrix) {
-  // set values
-  for (int x = 0; x < _resolution[0]; x++) {
-    for (int y = 0; y < _resolution[1]; y++) {
-      new_matrix[x][y] = old_matrix[x][y];
-    }
+/**
+ * @brief Apply tonemapping to a color if enabled.
+ */
+vec3 Image::postprocess(vec3 color) const {
+  if (_tonemapping_scale <= 0) {
+    return color;
   }
+  float l_p = _tonemapping_scale * get_luminance(color);
+  return color * (l_p / (1 + l_p));
 }
 
-void Image::delete_matrix() {
-  // clean up the pointer matrix
-  for (int i = 0; i < _resolution[0]; i++) {
-    delete[] _matrix[i];
-  }
-  delete[] _matrix;
+float Image::get_luminance(vec3 color) {
+  // formula from
+  // https://stackoverflow.com/questions/596216/formula-to-determine-perceived-brightness-of-rgb-color
+  return 0.2126 * color.x + 0.7152 * color.y + 0.0722 * color.z;
+}
+float Image::get_average_luminance() {
+  double sum = std::transform_reduce(
+      std::execution::par_unseq, _pixels.begin(), _pixels.end(), 0.0,
+      std::plus<double>(),
+      [](const vec3& pixel) { return glm::log(get_luminance(pixel)); });
+  float avg_luminance = sum / (_resolution[0] * _resolution[1]);
+  return glm::exp(avg_luminance);
 }
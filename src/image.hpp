@@ -4,8 +4,13 @@
 
 #pragma once
 
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <string>
+#include <vector>
+
+#include "image_writer.hpp"
+#include "objects/memory_stats.hpp"
 
 using glm::vec2;
 using glm::vec3;
@@ -19,30 +24,44 @@ struct point {
  * @brief Datatype for handeling image data.
  *
  * This Class handles images of different resolutions
- * and can write these to the file system as ppm files.
+ * and can write these to the file system as ppm, png or pfm files.
+ * Pixels are stored contiguous and row major with the top row first
+ * (pixel {x, y} with y = 0 is in the bottom row).
  */
 class Image {
  public:
   Image(int resolution_x, int resolution_y);
   Image(const Image& old_image);
   Image& operator=(const Image& old_image);
-  ~Image();
+  Image(Image&& old_image) = default;
+  Image& operator=(Image&& old_image) = default;
 
   void write_to_file(std::string filename);
+  void write_rows(ImageWriter* writer, int count);
 
   // --- configure scene ---
   void set_pixel(point pixel, vec3 color);
   void apply_tonemapping(float middle_gray);
 
+  // --- getters ---
+  vec3 get_pixel(point pixel);
+  int get_width();
+  int get_height();
+  /// @brief pointer to the first pixel of a row (row 0 is the top row).
+  const vec3* get_row(int row);
+  /// @brief FNV-1a hash of the colors quantized to 8 bit (no tonemapping).
+  uint64_t get_checksum();
+
  private:
-  float get_luminance(vec3 color);
+  static float get_luminance(vec3 color);
   float get_average_luminance();
-  void apply_luminance(vec3* color, float luminance);
-  void initialize_matrix(vec3 standart_color);
-  void delete_matrix();
-  void copy_matrix(vec3** new_matrix, vec3** old_matrix);
+  vec3 postprocess(vec3 color) const;
+  size_t get_index(point pixel);
 
   // --- data ---
   int _resolution[2];
-  vec3** _matrix;
+  std::vector<vec3> _pixels;
+  MemoryAccount _pixel_memory{MEM_IMAGES};
+  /// @brief middle gray / average luminance (tonemapping disabled if <= 0).
+  float _tonemapping_scale = 0;
 };
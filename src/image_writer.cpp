@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+
+#include "image_writer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+// largest payload of a stored (uncompressed) deflate block
+#define DEFLATE_BLOCK_SIZE 65535
+
+// modulus of the adler32 checksum
+#define ADLER_MOD 65521
+
+namespace {
+
+std::array<uint32_t, 256> get_crc_table() {
+  std::array<uint32_t, 256> table;
+  for (uint32_t n = 0; n < 256; n++) {
+    uint32_t c = n;
+    for (int k = 0; k < 8; k++) {
+      c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+    }
+    table[n] = c;
+  }
+  return table;
+}
+
+uint32_t update_crc(uint32_t crc, const unsigned char *data, size_t size) {
+  static const std::array<uint32_t, 256> table = get_crc_table();
+  for (size_t i = 0; i < size; i++) {
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+void append_u32_be(std::vector<unsigned char> *data, uint32_t value) {
+  data->push_back(value >> 24);
+  data->push_back(value >> 16);
+  data->push_back(value >> 8);
+  data->push_back(value);
+}
+
+}  // namespace
+
+/**
+ * @brief Open file and write the header of the image.
+ *
+ * @param filename path of the output file, extension sets the format.
+ * @param width image width.
+ * @param height image height.
+ */
+ImageWriter::ImageWriter(std::string filename, int width, int height)
+    : _file(filename, std::ios::binary | std::ios::trunc),
+      _format(get_format(filename)),
+      _width(width),
+      _height(height) {
+  if (!_file) {
+    throw std::runtime_error("could not open image file " + filename);
+  }
+  write_header();
+}
+
+ImageWriter::~ImageWriter() { finish(); }
+
+image_format ImageWriter::get_format(std::string filename) {
+  std::string extension = filename.substr(filename.find_last_of('.') + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 ::tolower);
+  if (extension == "png") {
+    return FORMAT_PNG;
+  }
+  if (extension == "pfm") {
+    return FORMAT_PFM;
+  }
+  return FORMAT_PPM;
+}
+
+int ImageWriter::get_next_row() { return _next_row; }
+image_format ImageWriter::get_format() { return _format; }
+
+void ImageWriter::write_header() {
+  switch (_format) {
+    case FORMAT_PPM:
+      _file << "P6\n" << _width << " " << _height << "\n255\n";
+      break;
+    case FORMAT_PFM:
+      // negative scale marks little endian floats
+      _file << "PF\n" << _width << " " << _height << "\n-1.0\n";
+      _data_offset = _file.tellp();
+      break;
+    case FORMAT_PNG: {
+      const unsigned char signature[8] = {0x89, 'P',  'N',  'G',
+                                          '\r', '\n', 0x1a, '\n'};
+      _file.write(reinterpret_cast<const char *>(signature), 8);
+
+      std::vector<unsigned char> header;
+      append_u32_be(&header, _width);
+      append_u32_be(&header, _height);
+      // 8 bit depth, rgb, deflate, no filter, no interlace
+      header.insert(header.end(), {8, 2, 0, 0, 0});
+      write_png_chunk("IHDR", header.data(), header.size());
+      break;
+    }
+  }
+}
+
+/**
+ * @brief Write the next rows of an 8 bit image (ppm or png).
+ *
+ * @param rgb interleaved rgb bytes of count rows (top row first).
+ * @param count number of rows.
+ */
+void ImageWriter::write_rows(const unsigned char *rgb, int count) {
+  count = begin_rows(false, count);
+  if (count <= 0) {
+    return;
+  }
+
+  if (_format == FORMAT_PNG) {
+    write_png_rows(rgb, count);
+  } else {
+    _file.write(reinterpret_cast<const char *>(rgb),
+                static_cast<size_t>(_width) * count * 3);
+  }
+  _next_row += count;
+}
+
+/**
+ * @brief Write the next rows of a float image (pfm).
+ *
+ * @param rgb interleaved rgb floats of count rows (top row first).
+ * @param count number of rows.
+ */
+void ImageWriter::write_rows(const float *rgb, int count) {
+  count = begin_rows(true, count);
+  if (count <= 0) {
+    return;
+  }
+
+  // pfm stores the bottom row first, so rows are placed at their offset
+  size_t row_bytes = static_cast<size_t>(_width) * 3 * sizeof(float);
+  for (int r = 0; r < count; r++) {
+    int file_row = _height - 1 - (_next_row + r);
+    _file.seekp(_data_offset + static_cast<std::streamoff>(file_row) *
+                                   row_bytes);
+    _file.write(reinterpret_cast<const char *>(rgb) + r * row_bytes,
+                row_bytes);
+  }
+  _next_row += count;
+}
+
+int ImageWriter::begin_rows(bool is_float, int count) {
+  if (!_file.is_open()) {
+    throw std::runtime_error("image file already finished");
+  }
+  if (is_float != (_format == FORMAT_PFM)) {
+    throw std::invalid_argument("pixel type does not match image format");
+  }
+  return std::min(count, _height - _next_row);
+}
+
+void ImageWriter::finish() {
+  if (!_file.is_open()) {
+    return;
+  }
+  if (_next_row < _height) {
+    size_t size = static_cast<size_t>(_width) * (_height - _next_row) * 3;
+    if (_format == FORMAT_PFM) {
+      write_rows(std::vector<float>(size).data(), _height - _next_row);
+    } else {
+      write_rows(std::vector<unsigned char>(size).data(),
+                 _height - _next_row);
+    }
+  }
+  if (_format == FORMAT_PNG) {
+    write_png_chunk("IEND", nullptr, 0);
+  }
+  _file.close();
+}
+
+void ImageWriter::write_png_rows(const unsigned char *rgb, int count) {
+  // filter type 0 byte in front of every row
+  size_t row_size = static_cast<size_t>(_width) * 3 + 1;
+  std::vector<unsigned char> raw(row_size * count);
+  for (int r = 0; r < count; r++) {
+    raw[r * row_size] = 0;
+    std::copy(rgb + r * (row_size - 1), rgb + (r + 1) * (row_size - 1),
+              raw.begin() + r * row_size + 1);
+  }
+  for (unsigned char byte : raw) {
+    _adler_a = (_adler_a + byte) % ADLER_MOD;
+    _adler_b = (_adler_b + _adler_a) % ADLER_MOD;
+  }
+
+  // zlib stream of stored deflate blocks, split over one chunk per call
+  bool last = _next_row + count == _height;
+  _buffer.clear();
+  if (_next_row == 0) {
+    _buffer.insert(_buffer.end(), {0x78, 0x01});
+  }
+  for (size_t offset = 0; offset < raw.size(); offset += DEFLATE_BLOCK_SIZE) {
+    uint16_t size = std::min<size_t>(DEFLATE_BLOCK_SIZE, raw.size() - offset);
+    uint16_t size_complement = ~size;
+    bool final_block = last && offset + size == raw.size();
+    _buffer.push_back(final_block ? 1 : 0);
+    _buffer.push_back(size & 0xff);
+    _buffer.push_back(size >> 8);
+    _buffer.push_back(size_complement & 0xff);
+    _buffer.push_back(size_complement >> 8);
+    _buffer.insert(_buffer.end(), raw.begin() + offset,
+                   raw.begin() + offset + size);
+  }
+  if (last) {
+    append_u32_be(&_buffer, (_adler_b << 16) | _adler_a);
+  }
+  write_png_chunk("IDAT", _buffer.data(), _buffer.size());
+}
+
+void ImageWriter::write_png_chunk(const char *type, const unsigned char *data,
+                                  size_t size) {
+  std::vector<unsigned char> length;
+  append_u32_be(&length, size);
+  _file.write(reinterpret_cast<const char *>(length.data()), 4);
+
+  uint32_t crc = update_crc(0xffffffffu,
+                            reinterpret_cast<const unsigned char *>(type), 4);
+  crc = update_crc(crc, data, size) ^ 0xffffffffu;
+  _file.write(type, 4);
+  _file.write(reinterpret_cast<const char *>(data), size);
+
+  std::vector<unsigned char> checksum;
+  append_u32_be(&checksum, crc);
+  _file.write(reinterpret_cast<const char *>(checksum.data()), 4);
+}
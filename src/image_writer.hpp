@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+enum image_format { FORMAT_PPM, FORMAT_PNG, FORMAT_PFM };
+
+/**
+ * @brief Streams rows of an image to a binary file.
+ *
+ * The format is chosen by the file extension (.ppm binary P6, .png 8 bit rgb,
+ * .pfm 32 bit float rgb). Rows are passed top to bottom and can be written
+ * as soon as they are finished, so only the header needs the full size of the
+ * image up front. Pixels are interleaved rgb, as bytes for ppm and png and
+ * as floats for pfm.
+ */
+class ImageWriter {
+ public:
+  ImageWriter(std::string filename, int width, int height);
+  ~ImageWriter();
+
+  ImageWriter(const ImageWriter&) = delete;
+  ImageWriter& operator=(const ImageWriter&) = delete;
+
+  /// @brief writes count rows starting at the next unwritten row.
+  void write_rows(const unsigned char* rgb, int count);
+  void write_rows(const float* rgb, int count);
+
+  /// @brief writes all missing rows as black and closes the file.
+  void finish();
+
+  int get_next_row();
+  image_format get_format();
+  static image_format get_format(std::string filename);
+
+ private:
+  void write_header();
+  void write_png_chunk(const char* type, const unsigned char* data,
+                       size_t size);
+  /// @brief checks the format and returns the number of rows to write.
+  int begin_rows(bool is_float, int count);
+  void write_png_rows(const unsigned char* rgb, int count);
+
+  std::ofstream _file;
+  image_format _format;
+  int _width;
+  int _height;
+  int _next_row = 0;
+
+  /// @brief position of the first pixel in the file (pfm).
+  std::streamoff _data_offset = 0;
+
+  /// @brief adler32 of the uncompressed png data.
+  uint32_t _adler_a = 1;
+  uint32_t _adler_b = 0;
+
+  std::vector<unsigned char> _buffer;
+};
@@ -4,6 +4,7 @@
 
 #include <glm/glm.hpp>
 #include <memory>
+#include <string>
 
 #include "image.hpp"
 #include "scene.hpp"
@@ -16,18 +17,23 @@ using glm::vec3, glm::vec2;
 
 Image get_image() { return Image(100, 100); }
 
-int main(void) {
-  Scene scene = get_scene();
+int main(int argc, char **argv) {
+  Scene scene = scenes::performance::get_scene();
+
+  // --aov: write cost layers (nodes, triangles, shadow rays, time) as well
+  if (argc > 1 && std::string(argv[1]) == "--aov") {
+    scene.set_aov_output("data/output/out");
+  }
 
 #if !ANIMATION
-  Image out = scene.trace_image();
-  char filename[50];
-  snprintf(filename, sizeof(filename), "data/output/out.ppm");
-  out.write_to_file(filename);
+  vec2 resolution = scene.get_camera()->get_resolution();
+  ImageWriter writer("data/output/out.png", resolution.x, resolution.y);
+  Image out = scene.trace_image(&writer);
+  writer.finish();
 #else
   for (size_t i = 0; i < FRAMES; i++) {
     if (i != 0) {
-      animation_step(&scene);
+      scenes::performance::animation_step(&scene);
     }
     Image out = scene.trace_image();
     char filename[50];
@@ -0,0 +1,460 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "image.hpp"
+#include "objects/box.hpp"
+#include "objects/bvh.hpp"
+#include "objects/camera.hpp"
+#include "objects/morton.hpp"
+#include "objects/texture.hpp"
+#include "objects/triangle.hpp"
+
+/**
+ * Microbenchmarks of the hot kernels, runs every kernel isolated from the
+ * rest of the renderer and prints ns/op and million ops per second.
+ *
+ * Every kernel runs with three input sets:
+ *   synthetic  one input repeated, the pure compute cost of the kernel.
+ *   resident   random inputs that fit into the L1 cache.
+ *   missing    random inputs far larger than the last level cache, visited
+ *              in random order so the prefetcher can not hide the misses.
+ *
+ * usage: microbench [--filter name] [--input synthetic|resident|missing]
+ *                   [--min-time s] [--repetitions n] [--list]
+ *
+ * All kernels run on one thread, only the luminance reduction of
+ * Image::apply_tonemapping (image_average_luminance) and the fused
+ * tonemapping, clamping and quantization pass of Image::write_rows
+ * (image_write_rows) use the parallel algorithms of the image.
+ */
+
+// minimum duration of one repetition in seconds
+#define MICROBENCH_MIN_TIME 0.1
+#define MICROBENCH_REPETITIONS 5
+
+// size of the resident and missing input sets
+#define MICROBENCH_RESIDENT_BYTES (16 << 10)
+#define MICROBENCH_MISSING_BYTES (256ull << 20)
+
+// edge length of the textures and images of the resident and missing sets
+#define MICROBENCH_RESIDENT_TEXTURE 64
+#define MICROBENCH_MISSING_TEXTURE 4096
+#define MICROBENCH_RESIDENT_IMAGE 64
+#define MICROBENCH_MISSING_IMAGE 4096
+
+// the order of the inputs repeats after at least this many operations
+#define MICROBENCH_MIN_ORDER 4096
+
+#define MICROBENCH_TEXTURE_DIR "data/cache/microbench"
+
+enum input_kind { INPUT_SYNTHETIC, INPUT_RESIDENT, INPUT_MISSING };
+
+const std::vector<std::string> input_names = {"synthetic", "resident",
+                                              "missing"};
+
+struct microbench_options {
+  std::string filter = "";
+  std::string input = "";
+  double min_time = MICROBENCH_MIN_TIME;
+  int repetitions = MICROBENCH_REPETITIONS;
+};
+
+/// @brief time per operation of all repetitions in ns.
+struct kernel_result {
+  double median = 0;
+  double min = 0;
+  uint64_t ops = 0;
+};
+
+using kernel_function = std::function<kernel_result(input_kind)>;
+
+struct kernel {
+  std::string name;
+  kernel_function run;
+};
+
+microbench_options options;
+
+// -----------------------------------------------------------------------------
+// timing
+
+/// @brief keeps the compiler from removing the computation of value.
+template <typename T>
+inline void do_not_optimize(const T &value) {
+  asm volatile("" : : "m"(value) : "memory");
+}
+
+/**
+ * @brief Calls pass until options.min_time elapsed, options.repetitions times.
+ *
+ * @param pass runs the kernel and returns the number of operations it did.
+ */
+kernel_result measure(const std::function<uint64_t()> &pass) {
+  // warmup, loads the inputs into the caches they fit into
+  pass();
+
+  std::vector<double> times;
+  kernel_result result;
+  for (int r = 0; r < options.repetitions; r++) {
+    uint64_t ops = 0;
+    double elapsed = 0;
+    std::chrono::steady_clock::time_point begin =
+        std::chrono::steady_clock::now();
+    while (elapsed < options.min_time) {
+      ops += pass();
+      elapsed = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - begin)
+                    .count();
+    }
+    times.push_back(elapsed * 1e9 / ops);
+    result.ops += ops;
+  }
+  std::sort(times.begin(), times.end());
+  result.median = times[times.size() / 2];
+  result.min = times.front();
+  return result;
+}
+
+/// @brief number of inputs of type T in the given input set.
+template <typename T>
+size_t get_input_count(input_kind kind) {
+  switch (kind) {
+    case INPUT_SYNTHETIC:
+      return 1;
+    case INPUT_RESIDENT:
+      return std::max<size_t>(1, MICROBENCH_RESIDENT_BYTES / sizeof(T));
+    case INPUT_MISSING:
+      return MICROBENCH_MISSING_BYTES / sizeof(T);
+  }
+  return 1;
+}
+
+/// @brief inputs of the given set, created by generate(rng).
+template <typename T, typename Generate>
+std::vector<T> make_inputs(input_kind kind, Generate generate) {
+  std::mt19937 rng(42);
+  std::vector<T> inputs;
+  size_t count = get_input_count<T>(kind);
+  inputs.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    inputs.push_back(generate(rng));
+  }
+  return inputs;
+}
+
+/**
+ * @brief Measure kernel(input) over all inputs in a shuffled order.
+ *
+ * The order has at least MICROBENCH_MIN_ORDER entries, so small sets are
+ * visited several times per pass and the loop overhead stays the same.
+ */
+template <typename T, typename Kernel>
+kernel_result measure_inputs(std::vector<T> *inputs, Kernel kernel) {
+  std::vector<uint32_t> order(
+      std::max<size_t>(inputs->size(), MICROBENCH_MIN_ORDER));
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i % inputs->size();
+  }
+  std::shuffle(order.begin(), order.end(), std::mt19937(7));
+
+  T *data = inputs->data();
+  return measure([&]() {
+    for (uint32_t id : order) {
+      auto value = kernel(&data[id]);
+      do_not_optimize(value);
+    }
+    return static_cast<uint64_t>(order.size());
+  });
+}
+
+// -----------------------------------------------------------------------------
+// inputs
+
+float random_float(std::mt19937 &rng, float min, float max) {
+  return std::uniform_real_distribution<float>(min, max)(rng);
+}
+
+vec3 random_vec3(std::mt19937 &rng, float min, float max) {
+  return vec3(random_float(rng, min, max), random_float(rng, min, max),
+              random_float(rng, min, max));
+}
+
+/// @brief ray from around the origin into the unit cube at z = 5.
+Ray random_ray(std::mt19937 &rng) {
+  vec3 origin = random_vec3(rng, -0.1, 0.1);
+  vec3 target = vec3(random_float(rng, -1, 1), random_float(rng, -1, 1), 5);
+  return Ray(origin, target - origin);
+}
+
+/// @brief small rays set the kernels cycle through, stays in L1.
+std::vector<Ray> make_rays() {
+  std::mt19937 rng(3);
+  std::vector<Ray> rays;
+  for (int i = 0; i < 64; i++) {
+    rays.push_back(random_ray(rng));
+  }
+  return rays;
+}
+
+/// @brief triangle in the unit cube at z = 5, about half of the rays hit.
+Triangle random_triangle(std::mt19937 &rng) {
+  vec3 center = vec3(random_float(rng, -0.5, 0.5),
+                     random_float(rng, -0.5, 0.5), random_float(rng, 4.5, 5.5));
+  vec3 points[3] = {center + random_vec3(rng, -0.8, 0.8),
+                    center + random_vec3(rng, -0.8, 0.8),
+                    center + random_vec3(rng, -0.8, 0.8)};
+  return Triangle(points, 0);
+}
+
+bvh_box random_box(std::mt19937 &rng) {
+  vec3 center = vec3(random_float(rng, -1, 1), random_float(rng, -1, 1),
+                     random_float(rng, 4, 6));
+  vec3 extent = random_vec3(rng, 0.05, 0.6);
+  return bvh_box(center - extent, center + extent);
+}
+
+/**
+ * @brief Path of a generated noise texture with the given edge length.
+ *
+ * The file is only written once, so the converted tiles of the texture cache
+ * stay valid between runs.
+ */
+std::string get_texture_path(int size) {
+  std::filesystem::create_directories(MICROBENCH_TEXTURE_DIR);
+  std::string path = std::string(MICROBENCH_TEXTURE_DIR) + "/noise_" +
+                     std::to_string(size) + ".ppm";
+  if (std::filesystem::exists(path)) {
+    return path;
+  }
+
+  std::ofstream file(path, std::ios::binary);
+  if (file.fail()) {
+    throw std::runtime_error("could not write " + path);
+  }
+  file << "P6\n" << size << " " << size << "\n255\n";
+  std::mt19937 rng(size);
+  std::vector<char> row(size * 3);
+  for (int y = 0; y < size; y++) {
+    for (char &c : row) {
+      c = static_cast<char>(rng() & 0xff);
+    }
+    file.write(row.data(), row.size());
+  }
+  return path;
+}
+
+// -----------------------------------------------------------------------------
+// kernels
+
+const std::vector<Ray> rays = make_rays();
+
+kernel_result bench_triangle(input_kind kind) {
+  std::vector<Triangle> triangles =
+      make_inputs<Triangle>(kind, random_triangle);
+  uint ray_id = 0;
+  return measure_inputs(&triangles, [&](Triangle *triangle) {
+    const Ray &ray = rays[ray_id++ & 63];
+    return triangle->intersect_triangle(ray).found;
+  });
+}
+
+kernel_result bench_node(input_kind kind) {
+  std::vector<BVH_node_data> nodes =
+      make_inputs<BVH_node_data>(kind, [](std::mt19937 &rng) {
+        BVH_node_data node;
+        node.bounds = random_box(rng);
+        return node;
+      });
+  BVH bvh;
+  // nothing is hit, so the best intersection stays at infinity
+  bvh_traversal traversal;
+  uint ray_id = 0;
+  return measure_inputs(&nodes, [&](BVH_node_data *node) {
+    return bvh.intersect_node_bool(node, rays[ray_id++ & 63], &traversal);
+  });
+}
+
+kernel_result bench_bounds(input_kind kind) {
+  std::vector<bvh_box> boxes = make_inputs<bvh_box>(kind, random_box);
+  uint ray_id = 0;
+  return measure_inputs(&boxes, [&](bvh_box *box) {
+    return intersect_bounds(*box, rays[ray_id++ & 63]);
+  });
+}
+
+kernel_result bench_split3(input_kind kind) {
+  std::vector<uint32_t> values = make_inputs<uint32_t>(
+      kind, [](std::mt19937 &rng) { return rng() & 0x1fffff; });
+  Morton morton(nullptr, 21);
+  return measure_inputs(&values,
+                        [&](uint32_t *value) { return morton.split3(*value); });
+}
+
+kernel_result bench_morton_value(input_kind kind) {
+  std::vector<vec3> positions = make_inputs<vec3>(
+      kind, [](std::mt19937 &rng) { return random_vec3(rng, 0, 1); });
+  Morton morton(nullptr, 10);
+  return measure_inputs(&positions, [&](vec3 *position) {
+    return morton.get_morton_value(*position);
+  });
+}
+
+kernel_result bench_texture(input_kind kind) {
+  int size = kind == INPUT_MISSING ? MICROBENCH_MISSING_TEXTURE
+                                   : MICROBENCH_RESIDENT_TEXTURE;
+  Texture texture(get_texture_path(size));
+  texture.prepare();
+
+  std::vector<vec2> uvs = make_inputs<vec2>(kind, [](std::mt19937 &rng) {
+    return vec2(random_float(rng, 0, 1), random_float(rng, 0, 1));
+  });
+  return measure_inputs(
+      &uvs, [&](vec2 *uv) { return texture.get_color_uv(*uv); });
+}
+
+kernel_result bench_camera(input_kind kind) {
+  Camera camera(1920, 1080);
+  std::vector<vec2> pixels = make_inputs<vec2>(kind, [](std::mt19937 &rng) {
+    return vec2(static_cast<int>(random_float(rng, 0, 1920)),
+                static_cast<int>(random_float(rng, 0, 1080)));
+  });
+  return measure_inputs(&pixels, [&](vec2 *pixel) {
+    return camera.get_ray(*pixel, vec2(0.25, 0.75), 0.2);
+  });
+}
+
+/// @brief image of the input set with random colors.
+Image make_image(input_kind kind) {
+  int size = kind == INPUT_MISSING ? MICROBENCH_MISSING_IMAGE
+                                   : MICROBENCH_RESIDENT_IMAGE;
+  Image image(size, size);
+  std::mt19937 rng(5);
+  vec3 color = random_vec3(rng, 0, 4);
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      image.set_pixel({x, y},
+                      kind == INPUT_SYNTHETIC ? color : random_vec3(rng, 0, 4));
+    }
+  }
+  return image;
+}
+
+/// @brief one op is one pixel of the image, only the luminance reduction
+/// (the pixels are tonemapped when they are written).
+kernel_result bench_average_luminance(input_kind kind) {
+  Image image = make_image(kind);
+  uint64_t pixels = static_cast<uint64_t>(image.get_width()) *
+                    image.get_height();
+  return measure([&]() {
+    image.apply_tonemapping(0.18);
+    return pixels;
+  });
+}
+
+/// @brief one op is one pixel of the image, tonemapped, clamped and quantized
+/// into a ppm writer that discards the bytes (includes opening the writer).
+kernel_result bench_write_rows(input_kind kind) {
+  Image image = make_image(kind);
+  image.apply_tonemapping(0.18);
+  uint64_t pixels = static_cast<uint64_t>(image.get_width()) *
+                    image.get_height();
+  return measure([&]() {
+    ImageWriter writer("/dev/null", image.get_width(), image.get_height());
+    image.write_rows(&writer, image.get_height());
+    return pixels;
+  });
+}
+
+const std::vector<kernel> kernels = {
+    {"triangle_intersect", bench_triangle},
+    {"bvh_node_intersect", bench_node},
+    {"intersect_bounds", bench_bounds},
+    {"morton_split3", bench_split3},
+    {"morton_value", bench_morton_value},
+    {"texture_color_uv", bench_texture},
+    {"camera_get_ray", bench_camera},
+    {"image_average_luminance", bench_average_luminance},
+    {"image_write_rows", bench_write_rows}};
+
+// -----------------------------------------------------------------------------
+
+void print_usage() {
+  std::cerr << "usage: microbench [--filter name] "
+               "[--input synthetic|resident|missing]\n"
+               "                  [--min-time s] [--repetitions n] "
+               "[--list]\n";
+}
+
+void parse_options(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--list") {
+      for (const kernel &k : kernels) {
+        std::cout << k.name << "\n";
+      }
+      exit(0);
+    }
+    if (arg == "--help" || i + 1 >= argc) {
+      print_usage();
+      exit(arg == "--help" ? 0 : 1);
+    }
+
+    std::string value = argv[++i];
+    if (arg == "--filter") {
+      options.filter = value;
+    } else if (arg == "--input") {
+      if (std::find(input_names.begin(), input_names.end(), value) ==
+          input_names.end()) {
+        print_usage();
+        exit(1);
+      }
+      options.input = value;
+    } else if (arg == "--min-time") {
+      options.min_time = std::stod(value);
+    } else if (arg == "--repetitions") {
+      options.repetitions = std::max(1, std::stoi(value));
+    } else {
+      print_usage();
+      exit(1);
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  parse_options(argc, argv);
+
+  std::cout << std::left << std::setw(25) << "kernel" << std::setw(11)
+            << "input" << std::right << std::setw(12) << "ns/op"
+            << std::setw(12) << "min ns/op" << std::setw(12) << "Mops/s"
+            << "\n";
+  for (const kernel &k : kernels) {
+    if (k.name.find(options.filter) == std::string::npos) {
+      continue;
+    }
+    for (size_t i = 0; i < input_names.size(); i++) {
+      if (!options.input.empty() && options.input != input_names[i]) {
+        continue;
+      }
+      kernel_result result = k.run(static_cast<input_kind>(i));
+      std::cout << std::left << std::setw(25) << k.name << std::setw(11)
+                << input_names[i] << std::right << std::fixed
+                << std::setprecision(3) << std::setw(12) << result.median
+                << std::setw(12) << result.min << std::setw(12)
+                << 1000.0 / result.median << std::defaultfloat << std::endl;
+    }
+  }
+  return 0;
+}
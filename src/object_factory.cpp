@@ -36,3 +36,10 @@ void ObjectFactory::new_xy_square_light(const vec3 &position,
     }
   }
 }
+
+void ObjectFactory::new_xy_area_light(const vec3 &position,
+                                      const float &strength,
+                                      const float &size) {
+  _scene->add_light(
+      AreaLight(position, vec3(size, 0, 0), vec3(0, size, 0), strength));
+}
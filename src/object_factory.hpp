@@ -18,6 +18,10 @@ class ObjectFactory {
                            const uint &amount, const float &space);
   void new_xy_square_light(const vec3 &position, const vec3 &strength,
                            const uint &amount, const float &space);
+  /// @brief square area light of edge length size in the xy plane, starting
+  /// at position (replaces amount x amount point lights).
+  void new_xy_area_light(const vec3 &position, const float &strength,
+                         const float &size);
 
  private:
   Scene *_scene;
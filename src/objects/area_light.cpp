@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+
+#include "area_light.hpp"
+
+#include "hash.hpp"
+
+AreaLight::AreaLight(vec3 corner, vec3 edge_u, vec3 edge_v, vec3 color)
+    : Light(corner + 0.5f * (edge_u + edge_v), color) {
+  _corner = corner;
+  _edge_u = edge_u;
+  _edge_v = edge_v;
+}
+
+AreaLight::AreaLight(vec3 corner, vec3 edge_u, vec3 edge_v, float intensity)
+    : AreaLight(corner, edge_u, edge_v, vec3(intensity)) {}
+
+vec3 AreaLight::get_sample_point(uint sample, uint strata,
+                                 uint32_t seed) const {
+  uint32_t hash_u = hash_pcg(seed ^ hash_pcg(sample));
+  uint32_t hash_v = hash_pcg(hash_u);
+  float u = (sample % strata + static_cast<float>(hash_u) / 4294967296.f) /
+            strata;
+  float v = (sample / strata + static_cast<float>(hash_v) / 4294967296.f) /
+            strata;
+  return _corner + u * _edge_u + v * _edge_v;
+}
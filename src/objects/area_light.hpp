@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "light.hpp"
+
+using glm::vec3;
+
+// samples per side of the stratified grid of every shading point, more
+// samples are only taken where the shadow rays of the first ones disagree
+#define AREA_LIGHT_MIN_STRATA 2
+#define AREA_LIGHT_MAX_STRATA 6
+
+/**
+ * @brief Rectangular light emitting from corner + u * edge_u + v * edge_v
+ * for u, v in [0, 1].
+ *
+ * The color is the light of the whole rectangle (like the one of a Pointlight
+ * at its center). Scene::get_area_light samples it with stratified shadow
+ * rays.
+ */
+class AreaLight : public Light {
+ public:
+  AreaLight(vec3 corner, vec3 edge_u, vec3 edge_v, vec3 color);
+  AreaLight(vec3 corner, vec3 edge_u, vec3 edge_v, float intensity);
+
+  /**
+   * @brief Jittered point in one stratum of a strata x strata grid.
+   *
+   * @param sample id of the stratum (row major).
+   * @param strata strata per side.
+   * @param seed jitter seed (e.g. hashed from the shading point), the same
+   * seed gives the same points.
+   * @return vec3 point on the light.
+   */
+  vec3 get_sample_point(uint sample, uint strata, uint32_t seed) const;
+
+ private:
+  vec3 _corner;
+  vec3 _edge_u;
+  vec3 _edge_v;
+};
@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+#include "autotune.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+
+#include "box.hpp"
+
+namespace {
+
+const std::map<Algorithm, std::string> algorithm_names = {{AGRID, "grid"},
+                                                          {ASAH, "sah"},
+                                                          {ALBVH, "lbvh"},
+                                                          {AHLBVH, "hlbvh"},
+                                                          {AMID, "mid"}};
+
+double get_seconds(std::chrono::steady_clock::time_point begin) {
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin)
+             .count() /
+         1000000000.0;
+}
+
+}  // namespace
+
+AutoTuner::AutoTuner(Mesh *mesh, autotune_settings settings) {
+  _mesh = mesh;
+  _settings = settings;
+}
+
+build_parameters AutoTuner::tune() {
+  generate_rays();
+
+  build_parameters parameters = _mesh->get_build_parameters();
+  calibrate_costs(&parameters);
+
+  // algorithms with their default parameters
+  for (Algorithm algorithm : {ASAH, AHLBVH, ALBVH, AMID, AGRID}) {
+    parameters.algorithm = algorithm;
+    autotune_result result = evaluate(parameters);
+    if (result.time_expected < _best.time_expected) {
+      _best = result;
+    }
+  }
+
+  // refine the parameters of the best one
+  switch (_best.parameters.algorithm) {
+    case ASAH:
+      try_values(&build_parameters::sah_buckets, {8, 12, 16, 24, 32});
+      try_values(&build_parameters::leaf_size, {1, 2, 4, 8});
+      break;
+    case AHLBVH:
+      try_values(&build_parameters::treelet_bits, {16, 19, 22, 25, 28});
+      try_values(&build_parameters::sah_buckets, {8, 12, 16, 24, 32});
+      try_values(&build_parameters::leaf_size, {1, 2, 4, 8});
+      break;
+    case ALBVH:
+    case AMID:
+      try_values(&build_parameters::leaf_size, {1, 2, 4, 8});
+      break;
+    case AGRID:
+      try_values(&build_parameters::grid_size, {25, 50, 100, 150, 200});
+      break;
+  }
+
+  std::cout << "------------------------------------------------\n";
+  std::cout << "Autotune: " << algorithm_names.at(_best.parameters.algorithm)
+            << "\n";
+  std::cout << "\t build (sec): \t" << _best.time_build << "\n";
+  std::cout << "\t ray (usec): \t" << _best.time_ray * 1000000 << "\n";
+  std::cout << "\t expected (sec): " << _best.time_expected << "\n";
+  std::cout << "------------------------------------------------\n";
+  return _best.parameters;
+}
+
+/**
+ * @brief Set the SAH cost constants relative to one triangle test.
+ *
+ * Box and triangle tests run on the bounds and triangles of the mesh with the
+ * sampled rays, so the ratio reflects this CPU and this kind of geometry.
+ */
+void AutoTuner::calibrate_costs(build_parameters *parameters) {
+  if (_rays.empty()) {
+    generate_rays();
+  }
+  uint count = std::min(_mesh->get_size(), 4096);
+  if (count == 0) {
+    return;
+  }
+  std::vector<Triangle> triangles;
+  std::vector<bvh_box> boxes;
+  for (uint i = 0; i < count; i++) {
+    triangles.push_back(_mesh->get_triangle(i));
+    boxes.push_back(bvh_box(triangles.back().get_min_bounding(),
+                            triangles.back().get_max_bounding()));
+  }
+
+  // sum up results, so the tests can not be optimized away
+  volatile float sink = 0;
+  std::chrono::steady_clock::time_point begin =
+      std::chrono::steady_clock::now();
+  for (uint i = 0; i < AUTOTUNE_CALIBRATION_TESTS; i++) {
+    sink = sink + intersect_bounds(boxes[i % count], _rays[i % _rays.size()]);
+  }
+  double time_box = get_seconds(begin);
+
+  begin = std::chrono::steady_clock::now();
+  for (uint i = 0; i < AUTOTUNE_CALIBRATION_TESTS; i++) {
+    sink = sink + triangles[i % count]
+                      .intersect_triangle(_rays[i % _rays.size()])
+                      .found;
+  }
+  double time_triangle = get_seconds(begin);
+
+  parameters->cost_intersect = 1;
+  parameters->cost_traversal =
+      std::clamp(static_cast<float>(time_box / time_triangle), 0.05f, 4.f);
+  std::cout << "calibrated cost traversal: " << parameters->cost_traversal
+            << "\n";
+}
+
+/**
+ * @brief Rays from a sphere around the mesh, half of them aimed at points on
+ * random triangles and half at random points in the bounding box.
+ */
+void AutoTuner::generate_rays() {
+  _rays.clear();
+  int size = _mesh->get_size();
+  if (size == 0) {
+    return;
+  }
+
+  vec3 min = vec3(MAXFLOAT);
+  vec3 max = vec3(-MAXFLOAT);
+  for (int i = 0; i < size; i++) {
+    Triangle triangle = _mesh->get_triangle(i);
+    min = glm::min(min, triangle.get_min_bounding());
+    max = glm::max(max, triangle.get_max_bounding());
+  }
+  vec3 center = (min + max) / 2.f;
+  float radius = glm::length(max - min);
+
+  // fixed seed, every candidate gets the same rays
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> unit(0, 1);
+  std::normal_distribution<float> normal(0, 1);
+  std::uniform_int_distribution<int> triangle_id(0, size - 1);
+
+  for (uint i = 0; i < _settings.sample_rays; i++) {
+    vec3 direction = vec3(normal(random), normal(random), normal(random));
+    if (glm::length(direction) == 0) {
+      direction = vec3(0, 0, 1);
+    }
+    vec3 origin = center + glm::normalize(direction) * radius;
+
+    vec3 target;
+    if (i % 2 == 0) {
+      Triangle triangle = _mesh->get_triangle(triangle_id(random));
+      float u = unit(random);
+      float v = unit(random);
+      if (u + v > 1) {
+        u = 1 - u;
+        v = 1 - v;
+      }
+      target = triangle.get_vertex(0) +
+               u * (triangle.get_vertex(1) - triangle.get_vertex(0)) +
+               v * (triangle.get_vertex(2) - triangle.get_vertex(0));
+    } else {
+      vec3 position = vec3(unit(random), unit(random), unit(random));
+      target = min + position * (max - min);
+    }
+    _rays.push_back(Ray(origin, target - origin));
+  }
+}
+
+autotune_result AutoTuner::evaluate(const build_parameters &parameters) {
+  autotune_result result;
+  result.parameters = parameters;
+
+  _mesh->set_build_parameters(parameters);
+  result.time_build = _mesh->get_stats().time_building;
+
+  volatile bool sink = false;
+  std::chrono::steady_clock::time_point begin =
+      std::chrono::steady_clock::now();
+  for (const Ray &ray : _rays) {
+    sink = sink ^ _mesh->intersect(ray).found;
+  }
+  result.time_ray = get_seconds(begin) / std::max<size_t>(_rays.size(), 1);
+  result.time_expected =
+      result.time_build + result.time_ray * _settings.expected_rays;
+
+  std::cout << "autotune " << algorithm_names.at(parameters.algorithm)
+            << " buckets " << parameters.sah_buckets << " leaf "
+            << parameters.leaf_size << " treelet bits "
+            << parameters.treelet_bits << " grid " << parameters.grid_size
+            << ": " << result.time_expected << " sec\n";
+  return result;
+}
+
+void AutoTuner::try_values(uint build_parameters::*parameter,
+                           const std::vector<uint> &values) {
+  build_parameters best = _best.parameters;
+  for (uint value : values) {
+    if (value == best.*parameter) {
+      continue;  // already measured
+    }
+    build_parameters parameters = best;
+    parameters.*parameter = value;
+    autotune_result result = evaluate(parameters);
+    if (result.time_expected < _best.time_expected) {
+      _best = result;
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+// tuning file
+
+bool AutoTuner::load(std::string path, uint triangle_count,
+                     build_parameters *parameters) {
+  std::ifstream file(path);
+  if (file.fail()) {
+    return false;
+  }
+
+  build_parameters result;
+  uint count = 0;
+  std::string key;
+  while (file >> key) {
+    if (key == "triangles") {
+      file >> count;
+    } else if (key == "algorithm") {
+      std::string name;
+      file >> name;
+      auto entry = std::find_if(
+          algorithm_names.begin(), algorithm_names.end(),
+          [&name](const auto &entry) { return entry.second == name; });
+      if (entry == algorithm_names.end()) {
+        return false;
+      }
+      result.algorithm = entry->first;
+    } else if (key == "leaf_size") {
+      file >> result.leaf_size;
+    } else if (key == "sah_buckets") {
+      file >> result.sah_buckets;
+    } else if (key == "treelet_bits") {
+      file >> result.treelet_bits;
+    } else if (key == "grid_size") {
+      file >> result.grid_size;
+    } else if (key == "cost_traversal") {
+      file >> result.cost_traversal;
+    } else if (key == "cost_intersect") {
+      file >> result.cost_intersect;
+    } else {
+      std::getline(file, key);  // skip unknown lines
+    }
+  }
+  if (count != triangle_count) {
+    std::cout << path << " belongs to another version of the mesh\n";
+    return false;
+  }
+  std::cout << "loaded build parameters from " << path << "\n";
+  *parameters = result;
+  return true;
+}
+
+void AutoTuner::save(std::string path, uint triangle_count,
+                     const build_parameters &parameters) {
+  std::ofstream file(path);
+  if (file.fail()) {
+    std::cout << "could not write " << path << "\n";
+    return;
+  }
+  file << "triangles " << triangle_count << "\n";
+  file << "algorithm " << algorithm_names.at(parameters.algorithm) << "\n";
+  file << "leaf_size " << parameters.leaf_size << "\n";
+  file << "sah_buckets " << parameters.sah_buckets << "\n";
+  file << "treelet_bits " << parameters.treelet_bits << "\n";
+  file << "grid_size " << parameters.grid_size << "\n";
+  file << "cost_traversal " << parameters.cost_traversal << "\n";
+  file << "cost_intersect " << parameters.cost_intersect << "\n";
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "build_parameters.hpp"
+#include "mesh.hpp"
+#include "ray.hpp"
+
+// number of rays traced for every candidate configuration
+#define AUTOTUNE_RAYS 4096
+
+// rays a mesh is expected to get per run (about 1080p with four samples),
+// weights the build time against the time per ray
+#define AUTOTUNE_EXPECTED_RAYS 8000000
+
+// number of box and triangle tests to calibrate the SAH cost constants
+#define AUTOTUNE_CALIBRATION_TESTS 1000000
+
+struct autotune_settings {
+  uint sample_rays = AUTOTUNE_RAYS;
+  double expected_rays = AUTOTUNE_EXPECTED_RAYS;
+};
+
+struct autotune_result {
+  build_parameters parameters;
+  float time_build = 0;
+  /// @brief mean time to intersect one of the sampled rays (sec).
+  double time_ray = 0;
+  /// @brief time_build + time_ray * expected rays.
+  double time_expected = MAXFLOAT;
+};
+
+/**
+ * @brief Searches the build parameters with the lowest expected build plus
+ * render time for one mesh.
+ *
+ * The SAH cost constants get calibrated on the host first. Then every
+ * algorithm is built with its default parameters and timed on a fixed set of
+ * sampled rays, afterwards the parameters of the best algorithm are refined
+ * one after another.
+ */
+class AutoTuner {
+ public:
+  explicit AutoTuner(Mesh *mesh, autotune_settings settings = {});
+
+  /// @brief returns the best parameters, the mesh is left in any state.
+  build_parameters tune();
+
+  /// @brief measures traversal step and triangle test times of this CPU.
+  void calibrate_costs(build_parameters *parameters);
+
+  /// @brief reads a tuning file, false if missing or for another mesh.
+  static bool load(std::string path, uint triangle_count,
+                   build_parameters *parameters);
+  static void save(std::string path, uint triangle_count,
+                   const build_parameters &parameters);
+
+ private:
+  void generate_rays();
+  autotune_result evaluate(const build_parameters &parameters);
+
+  /// @brief tries all values for one parameter of the best configuration.
+  void try_values(uint build_parameters::*parameter,
+                  const std::vector<uint> &values);
+
+  Mesh *_mesh;
+  autotune_settings _settings;
+  std::vector<Ray> _rays;
+  autotune_result _best;
+};
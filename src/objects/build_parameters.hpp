@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+#pragma once
+
+#include <sys/types.h>
+
+#include "bvh_tree.hpp"
+#include "lbvh.hpp"
+#include "sah.hpp"
+#include "uniform_grid.hpp"
+
+enum Algorithm { AGRID, ASAH, ALBVH, AHLBVH, AMID };
+
+/**
+ * @brief Parameters to build the acceleration structure of a mesh.
+ *
+ * Defaults are the compile time values, AutoTuner searches better ones for a
+ * specific mesh.
+ */
+struct build_parameters {
+  Algorithm algorithm = ASAH;
+  /// @brief maximum number of triangles in a leaf (BVH only).
+  uint leaf_size = MAX_TRIANGLES;
+  /// @brief buckets per SAH split (SAH and HLBVH).
+  uint sah_buckets = SAH_NUM_BUCKETS;
+  /// @brief morton code prefix length of a treelet (HLBVH).
+  uint treelet_bits = TREELET_BITS;
+  /// @brief cells per axis of the uniform grid.
+  uint grid_size = UNIFORM_GRID_SIZE;
+  /// @brief SAH cost constants.
+  float cost_traversal = COST_TRAVERSAL;
+  float cost_intersect = COST_INTERSECT;
+};
+
+/**
+ * @brief Acceleration structure a mesh builds when it gets constructed, an
+ * algorithm with its default parameters or the tuned parameters.
+ */
+struct mesh_build {
+  // implicit, an Algorithm can be passed for every mesh_build
+  mesh_build(Algorithm algorithm = ASAH)  // NOLINT(runtime/explicit)
+      : algorithm(algorithm) {}
+
+  Algorithm algorithm;
+  /// @brief build with the tuned parameters of the mesh (see Mesh::autotune),
+  /// algorithm is ignored.
+  bool autotune = false;
+};
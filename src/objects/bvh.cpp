@@ -12,9 +12,11 @@
 
 #include "bvh.hpp"
 #include "lbvh.hpp"
+#include "timeline.hpp"
+#include "traversal_stats.hpp"
 
 void BVH::build_tree_axis(std::vector<Triangle> *triangles,
-                          Algorithm algorithm) {
+                          const build_parameters &parameters) {
   // initialize data structure
   _data.triangles = triangles;
 
@@ -29,28 +31,29 @@ void BVH::build_tree_axis(std::vector<Triangle> *triangles,
 
   _data.tree.calculate_bounds(root);
 
-  SAH sah = SAH(&_data.tree);
-  LBVH lbvh = LBVH(&_data.tree);
+  SAH sah = SAH(&_data.tree, parameters);
+  LBVH lbvh = LBVH(&_data.tree, parameters);
 
-  switch (algorithm) {
-    case AMID:
+  switch (parameters.algorithm) {
+    case AMID: {
       std::cout << "Algorithm: Split middle\n";
+      TIMELINE_ZONE("split middle");
       sah.split_middle(root);
       break;
-    case ASAH:
+    }
+    case ASAH: {
       std::cout << "Algorithm: SAH\n";
+      TIMELINE_ZONE("sah");
       sah.split(root);
       break;
+    }
     case ALBVH:
       std::cout << "Algorithm: LBVH\n";
-      lbvh = LBVH(&_data.tree);
       // lbvh.sort();
       lbvh.build();
       break;
     case AHLBVH:
       std::cout << "Algorithm: HLBVH\n";
-      lbvh = LBVH(&_data.tree);
-
       lbvh.build_treelets();
       sah.built_on_treelets();
       break;
@@ -58,6 +61,10 @@ void BVH::build_tree_axis(std::vector<Triangle> *triangles,
 
 #if FLATTEN_TREE
   _data.tree.flatten_tree();
+#if BVH_REPORT
+  print_bvh_report(get_report(
+      {parameters.cost_traversal, parameters.cost_intersect, false}));
+#endif
 #endif
 }
 
@@ -66,38 +73,93 @@ void BVH::set_triangles(std::vector<Triangle> *triangles) {
   _data.tree.set_triangles(triangles);
 }
 
-TriangleIntersection BVH::intersect(const Ray &ray) {
-  _intersect_count = 0;
-  _stats = bvh_stats();
-  _best_intersection = TriangleIntersection();
+TriangleIntersection BVH::intersect(const Ray &ray, uint entry_node,
+                                    bvh_stats *stats) {
+  bvh_traversal traversal;
+  if (entry_node == BVH_NO_NODE) {
+    if (stats != nullptr) {
+      *stats = traversal.stats;
+    }
+    return traversal.best;
+  }
 
-  std::chrono::steady_clock::time_point begin =
-      std::chrono::steady_clock::now();
+#if GET_STATS
+  // only time a sample of the rays
+  bool timed = TraversalStats::sample_timing();
+  std::chrono::steady_clock::time_point begin;
+  if (timed) {
+    begin = std::chrono::steady_clock::now();
+  }
+#endif
 #if FLATTEN_TREE
-  intersect_node((uint)0, ray);
+  intersect_node(entry_node, ray, &traversal);
 #else
-  intersect_node(_data.tree.get_root(), ray);
+  intersect_node(_data.tree.get_root(), ray, &traversal);
 #endif
-  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
-
-  _stats.intersection_time =
-    (std::chrono::duration_cast<std::chrono::microseconds>(end - begin)
-         .count()) /
-    1000000.0;
-#if VISUALIZE_INTERSECT
-  vec2 input_area = VISUALIZE_RANGE;
-  vec2 output_area = vec2(0, 1);
-
-  float value = (VISUALIZE_STATS - input_area.x) *
-                    (output_area.y - output_area.x) /
-                    (input_area.y - input_area.x) +
-                output_area.x;
-  vec3 color1 = VISUALIZE_COL1;  // vec3(0.04, 0.01, 0.24);
-  vec3 color2 = VISUALIZE_COL2;  // vec3(0.98, 0.94, 0.01);
-  vec3 color = value * color2 + (1 - value) * color1;
-  _stats.intersection_color = color;
+#if GET_STATS
+  if (timed) {
+    std::chrono::steady_clock::time_point end =
+        std::chrono::steady_clock::now();
+    traversal.stats.intersection_time =
+        std::chrono::duration<float>(end - begin).count();
+  }
+#endif
+  if (stats != nullptr) {
+    *stats = traversal.stats;
+  }
+  return traversal.best;
+}
+
+void BVH::intersect_packet(const ray_packet &packet,
+                           TriangleIntersection *hits, uint entry_node,
+                           bvh_stats *stats) {
+  std::array<bvh_stats, RAY_PACKET_SIZE> local_stats;
+  if (stats == nullptr) {
+    stats = local_stats.data();
+  }
+  for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+    hits[lane] = TriangleIntersection();
+    stats[lane] = bvh_stats();
+  }
+  if (entry_node == BVH_NO_NODE) {
+    return;
+  }
+#if FLATTEN_TREE
+  intersect_node_packet(entry_node, packet, packet.active, hits, stats);
+#else
+  for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+    if (packet.active[lane]) {
+      hits[lane] = intersect(packet.get_ray(lane), 0, stats + lane);
+    }
+  }
+#endif
+}
+
+uint BVH::get_entry_node(const frustum &f) {
+#if FLATTEN_TREE
+  uint id_flat = 0;
+  if (!intersect_frustum(f, _data.tree.get_data(id_flat)->bounds)) {
+    return BVH_NO_NODE;
+  }
+  // go down while the frustum sees only one of the children
+  while (!_data.tree.get_node(id_flat)->is_leaf) {
+    uint left = id_flat + 1;
+    uint right = _data.tree.get_right(id_flat);
+    bool visible_left = intersect_frustum(f, _data.tree.get_data(left)->bounds);
+    bool visible_right =
+        intersect_frustum(f, _data.tree.get_data(right)->bounds);
+    if (visible_left && visible_right) {
+      break;
+    }
+    if (!visible_left && !visible_right) {
+      return BVH_NO_NODE;
+    }
+    id_flat = visible_left ? left : right;
+  }
+  return id_flat;
+#else
+  return 0;
 #endif
-  return _best_intersection;
 }
 
 /**
@@ -107,58 +169,331 @@ TriangleIntersection BVH::intersect(const Ray &ray) {
  * @param ray
  * @return Intersection
  */
-void BVH::intersect_node(bvh_node_pointer *node, const Ray &ray) {
-  if (!intersect_node_bool(_data.tree.get_data(node), ray)) {
+void BVH::intersect_node(bvh_node_pointer *node, const Ray &ray,
+                         bvh_traversal *traversal) {
+  if (!intersect_node_bool(_data.tree.get_data(node), ray, traversal)) {
     return;
   }
 
   // check if leaf
   if (_data.tree.is_leaf(node)) {
-    return intersect_leaf(_data.tree.get_data(node), ray);
+    return intersect_leaf(_data.tree.get_data(node), ray, traversal);
   }
 
   if (ray.get_direction()[node->data.axis] > 0) {
-    intersect_node(_data.tree.get_left(node), ray);
-    intersect_node(_data.tree.get_right(node), ray);
+    intersect_node(_data.tree.get_left(node), ray, traversal);
+    intersect_node(_data.tree.get_right(node), ray, traversal);
   } else {
-    intersect_node(_data.tree.get_right(node), ray);
-    intersect_node(_data.tree.get_left(node), ray);
+    intersect_node(_data.tree.get_right(node), ray, traversal);
+    intersect_node(_data.tree.get_left(node), ray, traversal);
   }
 }
 
-void BVH::intersect_node(uint id_flat, const Ray &ray) {
+void BVH::intersect_node(uint id_flat, const Ray &ray,
+                         bvh_traversal *traversal) {
   BVH_node_data *data = _data.tree.get_data(id_flat);
-  if (!intersect_node_bool(data, ray)) {
+  if (!intersect_node_bool(data, ray, traversal)) {
     return;
   }
 
   // check if leaf
   if (_data.tree.get_node(id_flat)->is_leaf) {
-    intersect_leaf(data, ray);
+    intersect_leaf(data, ray, traversal);
     return;
   }
 
   if (ray.get_direction()[data->axis] > 0) {
-    intersect_node(id_flat + 1, ray);
-    intersect_node(_data.tree.get_right(id_flat), ray);
+    intersect_node(id_flat + 1, ray, traversal);
+    intersect_node(_data.tree.get_right(id_flat), ray, traversal);
   } else {
-    intersect_node(_data.tree.get_right(id_flat), ray);
-    intersect_node(id_flat + 1, ray);
+    intersect_node(_data.tree.get_right(id_flat), ray, traversal);
+    intersect_node(id_flat + 1, ray, traversal);
   }
 }
+/**
+ * @brief Packet version of intersect_node, every lane visits the same nodes
+ * in the same order as it would alone.
+ *
+ * @param id_flat
+ * @param packet
+ * @param parent_mask lanes that hit the parent node.
+ * @param hits best intersection of every lane.
+ * @param stats of every lane.
+ */
+void BVH::intersect_node_packet(uint id_flat, const ray_packet &packet,
+                                const uint8_t *parent_mask,
+                                TriangleIntersection *hits, bvh_stats *stats) {
+  BVH_node_data *data = _data.tree.get_data(id_flat);
+  float best[RAY_PACKET_SIZE];
+  for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+    best[lane] = hits[lane].t;
+  }
+  uint8_t mask[RAY_PACKET_SIZE];
+  uint count =
+      intersect_node_bool_packet(data, packet, best, parent_mask, mask, stats);
+  if (count == 0) {
+    return;
+  }
+
+  // check if leaf
+  if (_data.tree.get_node(id_flat)->is_leaf) {
+    for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+      if (mask[lane]) {
+        bvh_traversal traversal = {hits[lane], stats[lane]};
+        intersect_leaf(data, packet.get_ray(lane), &traversal);
+        hits[lane] = traversal.best;
+        stats[lane] = traversal.stats;
+      }
+    }
+    return;
+  }
+
+  // the packet diverges if only a few rays are left or the rays would visit
+  // the children in different orders
+  uint positive = 0;
+  for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+    positive += mask[lane] & (packet.direction[data->axis][lane] > 0);
+  }
+  if (count < RAY_PACKET_MIN_RAYS || (positive != 0 && positive != count)) {
+    intersect_children_single(id_flat, packet, mask, hits, stats);
+    return;
+  }
+
+  uint right = _data.tree.get_right(id_flat);
+  if (positive > 0) {
+    intersect_node_packet(id_flat + 1, packet, mask, hits, stats);
+    intersect_node_packet(right, packet, mask, hits, stats);
+  } else {
+    intersect_node_packet(right, packet, mask, hits, stats);
+    intersect_node_packet(id_flat + 1, packet, mask, hits, stats);
+  }
+}
+
+void BVH::occluded_packet(const ray_packet &packet, const float *t_max,
+                          uint8_t *occluded, bvh_stats *stats) {
+  std::array<bvh_stats, RAY_PACKET_SIZE> local_stats;
+  if (stats == nullptr) {
+    stats = local_stats.data();
+  }
+  for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+    stats[lane] = bvh_stats();
+  }
+#if FLATTEN_TREE
+  occluded_node_packet(0, packet, t_max, packet.active, occluded, stats);
+#else
+  for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+    if (packet.active[lane] && !occluded[lane]) {
+      TriangleIntersection hit =
+          intersect(packet.get_ray(lane), 0, stats + lane);
+      occluded[lane] = hit.found && hit.t < t_max[lane];
+    }
+  }
+#endif
+}
+
+/**
+ * @brief Any hit version of intersect_node_packet, lanes are dropped as soon
+ * as they are occluded.
+ *
+ * @param id_flat
+ * @param packet
+ * @param t_max length of the rays.
+ * @param parent_mask lanes that hit the parent node.
+ * @param occluded lanes that hit a triangle closer than t_max.
+ * @param stats of every lane.
+ */
+void BVH::occluded_node_packet(uint id_flat, const ray_packet &packet,
+                               const float *t_max, const uint8_t *parent_mask,
+                               uint8_t *occluded, bvh_stats *stats) {
+  uint8_t open[RAY_PACKET_SIZE];
+  for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+    open[lane] = parent_mask[lane] & !occluded[lane];
+  }
+  BVH_node_data *data = _data.tree.get_data(id_flat);
+  uint8_t mask[RAY_PACKET_SIZE];
+  uint count =
+      intersect_node_bool_packet(data, packet, t_max, open, mask, stats);
+  if (count == 0) {
+    return;
+  }
+
+  if (_data.tree.get_node(id_flat)->is_leaf) {
+    for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+      if (!mask[lane]) {
+        continue;
+      }
+      Ray ray = packet.get_ray(lane);
+      for (uint i : data->triangle_ids) {
+        TriangleIntersection t_i =
+            _data.triangles->at(i).intersect_triangle(ray);
+#if GET_STATS
+        stats[lane].triangle_intersects += 1;
+#endif
+        if (t_i.found && t_i.t < t_max[lane]) {
+          occluded[lane] = 1;
+          break;
+        }
+      }
+    }
+    return;
+  }
+
+  // the remaining rays are faster alone
+  if (count < RAY_PACKET_MIN_RAYS) {
+    for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+      if (mask[lane]) {
+        bvh_traversal traversal;
+        traversal.best.t = t_max[lane];
+        traversal.stats = stats[lane];
+        Ray ray = packet.get_ray(lane);
+        occluded[lane] =
+            occluded_node(id_flat + 1, ray, t_max[lane], &traversal) ||
+            occluded_node(_data.tree.get_right(id_flat), ray, t_max[lane],
+                          &traversal);
+        stats[lane] = traversal.stats;
+      }
+    }
+    return;
+  }
+
+  // any hit ends the lane, so the order only matters for the speed
+  uint positive = 0;
+  for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+    positive += mask[lane] & (packet.direction[data->axis][lane] > 0);
+  }
+  uint right = _data.tree.get_right(id_flat);
+  if (2 * positive >= count) {
+    occluded_node_packet(id_flat + 1, packet, t_max, mask, occluded, stats);
+    occluded_node_packet(right, packet, t_max, mask, occluded, stats);
+  } else {
+    occluded_node_packet(right, packet, t_max, mask, occluded, stats);
+    occluded_node_packet(id_flat + 1, packet, t_max, mask, occluded, stats);
+  }
+}
+
+/**
+ * @brief Single ray any hit traversal of occluded_node_packet,
+ * traversal->best.t has to be t_max (discards the boxes behind it).
+ */
+bool BVH::occluded_node(uint id_flat, const Ray &ray, float t_max,
+                        bvh_traversal *traversal) {
+  BVH_node_data *data = _data.tree.get_data(id_flat);
+  if (!intersect_node_bool(data, ray, traversal)) {
+    return false;
+  }
+
+  if (_data.tree.get_node(id_flat)->is_leaf) {
+    for (uint i : data->triangle_ids) {
+      TriangleIntersection t_i = _data.triangles->at(i).intersect_triangle(ray);
+#if GET_STATS
+      traversal->stats.triangle_intersects += 1;
+#endif
+      if (t_i.found && t_i.t < t_max) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  uint right = _data.tree.get_right(id_flat);
+  if (ray.get_direction()[data->axis] > 0) {
+    return occluded_node(id_flat + 1, ray, t_max, traversal) ||
+           occluded_node(right, ray, t_max, traversal);
+  }
+  return occluded_node(right, ray, t_max, traversal) ||
+         occluded_node(id_flat + 1, ray, t_max, traversal);
+}
+
+void BVH::intersect_children_single(uint id_flat, const ray_packet &packet,
+                                    const uint8_t *mask,
+                                    TriangleIntersection *hits,
+                                    bvh_stats *stats) {
+  uint axis = _data.tree.get_data(id_flat)->axis;
+  for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+    if (!mask[lane]) {
+      continue;
+    }
+    Ray ray = packet.get_ray(lane);
+    bvh_traversal traversal = {hits[lane], stats[lane]};
+    if (ray.get_direction()[axis] > 0) {
+      intersect_node(id_flat + 1, ray, &traversal);
+      intersect_node(_data.tree.get_right(id_flat), ray, &traversal);
+    } else {
+      intersect_node(_data.tree.get_right(id_flat), ray, &traversal);
+      intersect_node(id_flat + 1, ray, &traversal);
+    }
+    hits[lane] = traversal.best;
+    stats[lane] = traversal.stats;
+  }
+}
+
+/**
+ * @brief Slab test of intersect_node_bool for all lanes at once.
+ *
+ * The test is the same (including the comparisons with NaN), but written
+ * without branches so the loop over the lanes gets vectorized.
+ *
+ * @param node_data
+ * @param packet
+ * @param t_limit per lane, boxes starting at or behind it are discarded (t of
+ * the best intersection or the length of a shadow ray).
+ * @param parent_mask lanes to test.
+ * @param mask lanes that hit the box.
+ * @param stats of every lane.
+ * @return uint number of lanes that hit the box.
+ */
+uint BVH::intersect_node_bool_packet(BVH_node_data *node_data,
+                                     const ray_packet &packet,
+                                     const float *t_limit,
+                                     const uint8_t *parent_mask, uint8_t *mask,
+                                     bvh_stats *stats) {
+#if GET_STATS
+  for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+    stats[lane].node_intersects += parent_mask[lane];
+  }
+#endif
+  vec3 box_min = node_data->bounds.min;
+  vec3 box_max = node_data->bounds.max;
+
+  uint count = 0;
+  for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+    float t_min[3];
+    float t_max[3];
+    for (int a = 0; a < 3; a++) {
+      float t0 = (box_min[a] - packet.origin[a][lane]) /
+                 packet.direction[a][lane];
+      float t1 = (box_max[a] - packet.origin[a][lane]) /
+                 packet.direction[a][lane];
+      t_min[a] = t0 > t1 ? t1 : t0;
+      t_max[a] = t0 > t1 ? t0 : t1;
+    }
+    bool hit = parent_mask[lane];
+    for (int a = 0; a < 3; a++) {
+      hit &= !(t_limit[lane] <= t_min[a]) & !(t_max[a] < 0);
+    }
+    hit &= !(t_min[0] > t_max[1]) & !(t_min[1] > t_max[0]);
+    hit &= !(t_min[0] > t_max[2]) & !(t_min[2] > t_max[0]);
+    hit &= !(t_min[1] > t_max[2]) & !(t_min[2] > t_max[1]);
+    mask[lane] = hit;
+    count += hit;
+  }
+  return count;
+}
+
 /**
  * @brief check if hitbox of node has intersection. that is closer than t of
- * _current_best.
+ * the best intersection of the traversal.
  *
  * @param id
  * @param ray
+ * @param traversal
  * @return true
  * @return false
  */
-bool BVH::intersect_node_bool(BVH_node_data *node_data, const Ray &ray) {
-  _intersect_count += 1;
+bool BVH::intersect_node_bool(BVH_node_data *node_data, const Ray &ray,
+                              bvh_traversal *traversal) {
 #if GET_STATS
-  _stats.node_intersects += 1;
+  traversal->stats.node_intersects += 1;
 #endif
   vec3 d = ray.get_direction();
   vec3 o = ray.get_origin();
@@ -191,9 +526,9 @@ bool BVH::intersect_node_bool(BVH_node_data *node_data, const Ray &ray) {
     tz.max = t;
   }
 
-  // discard if _best_intersection is closer than bounding box
-  if (_best_intersection.t <= tx.min || _best_intersection.t <= ty.min ||
-      _best_intersection.t <= tz.min) {
+  // discard if the best intersection is closer than bounding box
+  float best = traversal->best.t;
+  if (best <= tx.min || best <= ty.min || best <= tz.min) {
     return false;
   }
   // discard intersection that are behind the ray
@@ -218,7 +553,8 @@ bool BVH::intersect_node_bool(BVH_node_data *node_data, const Ray &ray) {
   return true;
 }
 
-void BVH::intersect_leaf(BVH_node_data *node_data, const Ray &ray) {
+void BVH::intersect_leaf(BVH_node_data *node_data, const Ray &ray,
+                         bvh_traversal *traversal) {
   // find best intersection in triangle set
   uint best_triangle_id = 0;
   float t_min = MAXFLOAT;
@@ -226,7 +562,7 @@ void BVH::intersect_leaf(BVH_node_data *node_data, const Ray &ray) {
   for (uint i : node_data->triangle_ids) {
     TriangleIntersection t_i = _data.triangles->at(i).intersect_triangle(ray);
 #if GET_STATS
-    _stats.triangle_intersects += 1;
+    traversal->stats.triangle_intersects += 1;
 #endif
 
     if (t_i.found && t_i.t < t_min) {
@@ -238,7 +574,7 @@ void BVH::intersect_leaf(BVH_node_data *node_data, const Ray &ray) {
   TriangleIntersection res =
       (_data.triangles->data() + best_triangle_id)->intersect_triangle(ray);
 
-  update_intersection(&_best_intersection, res);
+  update_intersection(&traversal->best, res);
 }
 
 bool BVH::update_intersection(TriangleIntersection *intersect,
@@ -279,4 +615,10 @@ void BVH::print_node_triangles(bvh_node_pointer *node) {
   std::cout << "----------------------\n";
 }
 
-bvh_stats BVH::get_stats() { return _stats; }
+bvh_report BVH::get_report(bvh_report_settings settings) {
+#if FLATTEN_TREE
+  return create_bvh_report(&_data.tree, settings);
+#else
+  throw std::runtime_error("BVH report needs a flattened tree!");
+#endif
+}
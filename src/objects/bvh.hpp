@@ -3,32 +3,43 @@
  */
 #pragma once
 
+#include <array>
+#include <climits>
 #include <glm/glm.hpp>
 #include <vector>
 
+#include "build_parameters.hpp"
+#include "bvh_report.hpp"
 #include "bvh_tree.hpp"
+#include "frustum.hpp"
 #include "ray.hpp"
+#include "ray_packet.hpp"
 #include "sah.hpp"
 #include "triangle.hpp"
 
-#define VISUALIZE_INTERSECT true
-#define VISUALIZE_RANGE vec2(0, 300)
-#define VISUALIZE_STATS _stats.node_intersects
-#define VISUALIZE_COL1 vec3(0.04, 0.01, 0.18)
-#define VISUALIZE_COL2 vec3(0.03, 1, 0.05)
-
 #define FLATTEN_TREE true
 
+// entry node of rays that can't hit the mesh (see get_entry_node)
+#define BVH_NO_NODE UINT_MAX
+
+// count visited nodes and triangles and time sampled rays (TraversalStats)
 #define GET_STATS true
 
 using glm::vec3;
 
-enum Algorithm { AGRID, ASAH, ALBVH, AHLBVH, AMID };
-
 struct bvh_stats {
   uint node_intersects = 0;
   uint triangle_intersects = 0;
-  vec3 intersection_color = VISUALIZE_COL1;
+  /// @brief traversal time in seconds, negative if the ray was not timed.
+  float intersection_time = -1;
+};
+
+/// @brief state of one single ray traversal, kept on the stack of the caller
+/// so concurrent traversals of the same BVH don't share anything.
+struct bvh_traversal {
+  /// @brief best intersection so far (its t discards the boxes behind it).
+  TriangleIntersection best;
+  bvh_stats stats;
 };
 
 struct Triangle_set {
@@ -43,10 +54,10 @@ struct Interval {
 
 /// @brief struct for BVH arrays data.
 struct BVH_data {
-  std::vector<Triangle> *triangles;
+  std::vector<Triangle> *triangles = nullptr;
   std::vector<uint> triangle_ids;
   BVH_tree tree;
-  uint size;
+  uint size = 0;
 };
 
 class BVH {
@@ -55,12 +66,32 @@ class BVH {
 
   /***** Funcitons *****/
 
-  /// @brief store the currently best intersection.
-  TriangleIntersection _best_intersection;
-  bool intersect_node_bool(BVH_node_data *node_data, const Ray &ray);
-  void intersect_node(bvh_node_pointer *node, const Ray &ray);
-  void intersect_node(uint id_flat, const Ray &ray);
-  void intersect_leaf(BVH_node_data *node_data, const Ray &ray);
+  // the traversal functions only read the tree, the state of a query is
+  // passed along (traversal, or hits and stats with one entry per lane)
+  void intersect_node(bvh_node_pointer *node, const Ray &ray,
+                      bvh_traversal *traversal);
+  void intersect_node(uint id_flat, const Ray &ray, bvh_traversal *traversal);
+  void intersect_leaf(BVH_node_data *node_data, const Ray &ray,
+                      bvh_traversal *traversal);
+
+  void intersect_node_packet(uint id_flat, const ray_packet &packet,
+                             const uint8_t *parent_mask,
+                             TriangleIntersection *hits, bvh_stats *stats);
+  void occluded_node_packet(uint id_flat, const ray_packet &packet,
+                            const float *t_max, const uint8_t *parent_mask,
+                            uint8_t *occluded, bvh_stats *stats);
+  bool occluded_node(uint id_flat, const Ray &ray, float t_max,
+                     bvh_traversal *traversal);
+  /// @brief slab test of all lanes in parent_mask, returns the hit count.
+  uint intersect_node_bool_packet(BVH_node_data *node_data,
+                                  const ray_packet &packet,
+                                  const float *t_limit,
+                                  const uint8_t *parent_mask, uint8_t *mask,
+                                  bvh_stats *stats);
+  /// @brief continue the lanes of mask as single rays at the children.
+  void intersect_children_single(uint id_flat, const ray_packet &packet,
+                                 const uint8_t *mask,
+                                 TriangleIntersection *hits, bvh_stats *stats);
 
   bool update_intersection(TriangleIntersection *intersect,
                            const TriangleIntersection &new_intersect);
@@ -73,22 +104,72 @@ class BVH {
   /// @brief calculate costs of given split
   float get_cost();
 
-  uint _intersect_count = 0;
-  bvh_stats _stats;
-
  public:
   BVH() {}
 
-  void build_tree_axis(std::vector<Triangle> *triangles, Algorithm algorithm);
+  /// @brief slab test of the node bounds against the best intersection of
+  /// the traversal (public for the microbenchmarks).
+  bool intersect_node_bool(BVH_node_data *node_data, const Ray &ray,
+                           bvh_traversal *traversal);
+
+  void build_tree_axis(std::vector<Triangle> *triangles,
+                       const build_parameters &parameters);
   void set_triangles(std::vector<Triangle> *triangles);
 
   /**
    * @brief Return best triangle intersection if found.
    *
+   * All queries (also the packet ones) are reentrant, so threads can trace
+   * through the same BVH at once.
+   *
    * @param ray
+   * @param entry_node node to start at, see get_entry_node.
+   * @param stats optional visited nodes and triangles of the ray (timed for
+   * a sample of the rays).
    * @return Intersection
    */
-  TriangleIntersection intersect(const Ray &ray);
+  TriangleIntersection intersect(const Ray &ray, uint entry_node = 0,
+                                 bvh_stats *stats = nullptr);
+
+  /**
+   * @brief Best triangle intersection of every active lane of the packet.
+   *
+   * The lanes share the node tests while they agree on the order of the
+   * children, the hits are the same as the ones of intersect.
+   *
+   * @param packet coherent rays (e.g. Camera::get_ray_packet).
+   * @param hits RAY_PACKET_SIZE intersections, one per lane.
+   * @param entry_node node to start at, see get_entry_node.
+   * @param stats optional RAY_PACKET_SIZE stats, one per lane (not timed).
+   */
+  void intersect_packet(const ray_packet &packet, TriangleIntersection *hits,
+                        uint entry_node = 0, bvh_stats *stats = nullptr);
+
+  /**
+   * @brief Shadow test of a packet (e.g. the rays from one point to all
+   * lights), the lanes leave the traversal once they are occluded.
+   *
+   * @param packet
+   * @param t_max length of every lane.
+   * @param occluded set for the active lanes with a hit closer than t_max,
+   * lanes that are already set are not traced.
+   * @param stats optional RAY_PACKET_SIZE stats, one per lane (not timed).
+   */
+  void occluded_packet(const ray_packet &packet, const float *t_max,
+                       uint8_t *occluded, bvh_stats *stats = nullptr);
+
+  /**
+   * @brief Deepest node that contains every node the frustum sees.
+   *
+   * Rays inside of the frustum can start their traversal at this node, the
+   * culled subtrees can't be hit by them. Without a flattened tree this is
+   * always the root.
+   *
+   * @param f frustum of the rays (e.g. Camera::get_tile_frustum).
+   * @return uint id of the node or BVH_NO_NODE if the frustum misses the
+   * mesh.
+   */
+  uint get_entry_node(const frustum &f);
 
   /***** DEBUG *****/
   void print_node(bvh_node_pointer *node);
@@ -96,8 +177,8 @@ class BVH {
 
   void update_boxes() { _data.tree.update_box(0); }
 
-  /// @brief returns stats of the last intersect call.
-  bvh_stats get_stats();
+  /// @brief quality report of the built tree (needs FLATTEN_TREE).
+  bvh_report get_report(bvh_report_settings settings);
 
   /***** Transformation *****/
 
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+#include "bvh_report.hpp"
+
+#include <algorithm>
+#include <execution>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+namespace {
+
+float get_surface_area(const bvh_box &box) {
+  vec3 d = glm::max(box.max - box.min, vec3(0));
+  return 2 * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+bool overlaps(const bvh_box &a, const bvh_box &b) {
+  for (int i = 0; i < 3; i++) {
+    if (a.max[i] < b.min[i] || b.max[i] < a.min[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+float get_polygon_area(const std::vector<vec3> &polygon) {
+  vec3 sum = vec3(0);
+  for (size_t i = 1; i + 1 < polygon.size(); i++) {
+    sum += glm::cross(polygon[i] - polygon[0], polygon[i + 1] - polygon[0]);
+  }
+  return glm::length(sum) / 2;
+}
+
+/// @brief area of the part of the triangle inside the box (Sutherland-Hodgman)
+float get_clipped_area(Triangle *triangle, const bvh_box &box) {
+  std::vector<vec3> polygon = {triangle->get_vertex(0),
+                               triangle->get_vertex(1),
+                               triangle->get_vertex(2)};
+  std::vector<vec3> clipped;
+  for (int axis = 0; axis < 3; axis++) {
+    for (int side = 0; side < 2; side++) {
+      float plane = side == 0 ? box.min[axis] : box.max[axis];
+      auto inside = [&](const vec3 &p) {
+        return side == 0 ? p[axis] >= plane : p[axis] <= plane;
+      };
+
+      clipped.clear();
+      for (size_t i = 0; i < polygon.size(); i++) {
+        const vec3 &a = polygon[i];
+        const vec3 &b = polygon[(i + 1) % polygon.size()];
+        if (inside(a)) {
+          clipped.push_back(a);
+        }
+        if (inside(a) != inside(b)) {
+          float t = (plane - a[axis]) / (b[axis] - a[axis]);
+          clipped.push_back(a + t * (b - a));
+        }
+      }
+      polygon.swap(clipped);
+      if (polygon.size() < 3) {
+        return 0;
+      }
+    }
+  }
+  return get_polygon_area(polygon);
+}
+
+}  // namespace
+
+/**
+ * @brief Create a quality report of the flattened tree.
+ *
+ * @param tree tree after flatten_tree().
+ * @param settings cost constants and whether to compute the EPO.
+ * @return bvh_report
+ */
+bvh_report create_bvh_report(BVH_tree *tree, bvh_report_settings settings) {
+  bvh_report report;
+  report.settings = settings;
+  report.node_count = tree->get_size_flat();
+  if (report.node_count == 0) {
+    return report;
+  }
+
+  // depth first order: children follow their parent
+  std::vector<uint> depth(report.node_count, 0);
+  for (uint i = 0; i < report.node_count; i++) {
+    if (!tree->get_node(i)->is_leaf) {
+      depth[tree->get_left(i)] = depth[i] + 1;
+      depth[tree->get_right(i)] = depth[i] + 1;
+    }
+  }
+
+  float root_area = get_surface_area(tree->get_data(0u)->bounds);
+  double cost = 0;
+  uint64_t depth_sum = 0;
+  for (uint i = 0; i < report.node_count; i++) {
+    bvh_node_flat *node = tree->get_node(i);
+    report.bytes += sizeof(bvh_node_flat) +
+                    node->data.triangle_ids.capacity() * sizeof(uint);
+    float area = get_surface_area(node->data.bounds);
+
+    if (!node->is_leaf) {
+      cost += settings.cost_traversal * area;
+      continue;
+    }
+    uint size = node->data.triangle_ids.size();
+    cost += settings.cost_intersect * area * size;
+
+    report.leaf_count++;
+    report.triangle_count += size;
+    report.max_depth = std::max(report.max_depth, depth[i]);
+    depth_sum += depth[i];
+    report.leaf_depths[depth[i]]++;
+    report.leaf_sizes[size]++;
+  }
+  report.sah_cost = root_area > 0 ? cost / root_area : 0;
+  report.avg_leaf_depth = static_cast<double>(depth_sum) / report.leaf_count;
+
+  if (!settings.compute_epo) {
+    return report;
+  }
+
+  // EPO: area of triangles outside a subtree that lie inside its box
+  std::vector<Triangle> *triangles = tree->get_triangle_vec();
+  double triangle_area = 0;
+  for (Triangle &t : *triangles) {
+    triangle_area += get_polygon_area(
+        {t.get_vertex(0), t.get_vertex(1), t.get_vertex(2)});
+  }
+
+  std::vector<uint> ids(report.node_count);
+  std::iota(ids.begin(), ids.end(), 0);
+  double overlap = std::transform_reduce(
+      std::execution::par, ids.begin(), ids.end(), 0.0, std::plus<double>(),
+      [&](uint id) {
+        const bvh_box &box = tree->get_data(id)->bounds;
+        double area = 0;
+
+        std::vector<uint> stack = {0};
+        while (!stack.empty()) {
+          uint current = stack.back();
+          stack.pop_back();
+          bvh_node_flat *node = tree->get_node(current);
+          // the subtree of the node itself does not count
+          if (current == id || !overlaps(node->data.bounds, box)) {
+            continue;
+          }
+          if (node->is_leaf) {
+            for (uint t : node->data.triangle_ids) {
+              area += get_clipped_area(&triangles->at(t), box);
+            }
+          } else {
+            stack.push_back(tree->get_left(current));
+            stack.push_back(tree->get_right(current));
+          }
+        }
+        // weight with the cost of visiting the node
+        bool leaf = tree->get_node(id)->is_leaf;
+        return area *
+               (leaf ? settings.cost_intersect : settings.cost_traversal);
+      });
+  report.epo = triangle_area > 0 ? overlap / triangle_area : 0;
+
+  return report;
+}
+
+void print_bvh_report(const bvh_report &report) {
+  std::cout << "------------------------------------------------\n";
+  std::cout << "BVH report: \n";
+  std::cout << "\t nodes: \t" << report.node_count << "\n";
+  std::cout << "\t leaves: \t" << report.leaf_count << "\n";
+  std::cout << "\t triangles: \t" << report.triangle_count << "\n";
+  std::cout << "\t bytes: \t" << report.bytes << "\n";
+  std::cout << "\t SAH cost: \t" << report.sah_cost << "\n";
+  if (report.epo >= 0) {
+    std::cout << "\t EPO: \t\t" << report.epo << "\n";
+  }
+  std::cout << "\t max depth: \t" << report.max_depth << "\n";
+  std::cout << "\t avg leaf depth: " << report.avg_leaf_depth << "\n";
+  std::cout << "\t leaf sizes: \n";
+  for (auto [size, count] : report.leaf_sizes) {
+    std::cout << "\t\t" << size << ": \t" << count << "\n";
+  }
+  std::cout << "------------------------------------------------\n";
+}
+
+namespace {
+
+void write_map(std::ostream *out, const std::map<uint, uint> &values) {
+  *out << "{";
+  bool first = true;
+  for (auto [key, count] : values) {
+    *out << (first ? "" : ", ") << "\"" << key << "\": " << count;
+    first = false;
+  }
+  *out << "}";
+}
+
+}  // namespace
+
+void write_bvh_report_json(std::ostream *out, const bvh_report &report,
+                           std::string indent) {
+  *out << indent << "{\n";
+  *out << indent << "  \"cost_traversal\": " << report.settings.cost_traversal
+       << ",\n";
+  *out << indent << "  \"cost_intersect\": " << report.settings.cost_intersect
+       << ",\n";
+  *out << indent << "  \"nodes\": " << report.node_count << ",\n";
+  *out << indent << "  \"leaves\": " << report.leaf_count << ",\n";
+  *out << indent << "  \"triangles\": " << report.triangle_count << ",\n";
+  *out << indent << "  \"bytes\": " << report.bytes << ",\n";
+  *out << indent << "  \"sah_cost\": " << report.sah_cost << ",\n";
+  if (report.epo >= 0) {
+    *out << indent << "  \"epo\": " << report.epo << ",\n";
+  } else {
+    *out << indent << "  \"epo\": null,\n";
+  }
+  *out << indent << "  \"max_depth\": " << report.max_depth << ",\n";
+  *out << indent << "  \"avg_leaf_depth\": " << report.avg_leaf_depth
+       << ",\n";
+  *out << indent << "  \"leaf_depths\": ";
+  write_map(out, report.leaf_depths);
+  *out << ",\n";
+  *out << indent << "  \"leaf_sizes\": ";
+  write_map(out, report.leaf_sizes);
+  *out << "\n" << indent << "}";
+}
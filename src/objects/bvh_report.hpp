@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+
+#include "bvh_tree.hpp"
+#include "sah.hpp"
+
+// print a report (without EPO) after every BVH build
+#define BVH_REPORT false
+
+struct bvh_report_settings {
+  float cost_traversal = COST_TRAVERSAL;
+  float cost_intersect = COST_INTERSECT;
+  /// @brief end-point overlap needs a traversal per node (slow).
+  bool compute_epo = true;
+};
+
+/**
+ * @brief Quality measures of a flattened BVH which do not need rendering.
+ */
+struct bvh_report {
+  bvh_report_settings settings;
+
+  uint node_count = 0;
+  uint leaf_count = 0;
+  uint triangle_count = 0;
+  /// @brief memory of nodes and triangle id lists.
+  size_t bytes = 0;
+
+  /// @brief SAH cost relative to the surface area of the root.
+  double sah_cost = 0;
+  /// @brief end-point overlap (Aila et al. 2013), negative if not computed.
+  double epo = -1;
+
+  uint max_depth = 0;
+  double avg_leaf_depth = 0;
+  /// @brief number of leaves per depth.
+  std::map<uint, uint> leaf_depths;
+  /// @brief number of leaves per triangle count.
+  std::map<uint, uint> leaf_sizes;
+};
+
+/// @brief analyse the flattened tree (FLATTEN_TREE has to be enabled).
+bvh_report create_bvh_report(BVH_tree* tree, bvh_report_settings settings);
+
+void print_bvh_report(const bvh_report& report);
+void write_bvh_report_json(std::ostream* out, const bvh_report& report,
+                           std::string indent = "");
@@ -5,6 +5,8 @@
 
 #include <stdexcept>
 
+#include "timeline.hpp"
+
 BVH_tree::BVH_tree(BVH_node_data root_data, std::vector<Triangle>* triangles) {
   root = new bvh_node_pointer;
   root->data = root_data;
@@ -14,6 +16,7 @@ BVH_tree::BVH_tree(BVH_node_data root_data, std::vector<Triangle>* triangles) {
 /// @brif copy_constructor to initialize new tree
 BVH_tree::BVH_tree(const BVH_tree& old_tree) {
   _triangles_flat = old_tree._triangles_flat;
+  _flat_memory = old_tree._flat_memory;
   _triangles = old_tree._triangles;
   destroy_tree();
   root = copy_node(old_tree.root);
@@ -21,6 +24,7 @@ BVH_tree::BVH_tree(const BVH_tree& old_tree) {
 
 BVH_tree& BVH_tree::operator=(const BVH_tree& old_tree) {
   _triangles_flat = old_tree._triangles_flat;
+  _flat_memory = old_tree._flat_memory;
   _triangles = old_tree._triangles;
   destroy_tree();
   root = copy_node(old_tree.root);
@@ -31,6 +35,29 @@ BVH_tree& BVH_tree::operator=(const BVH_tree& old_tree) {
   return *this;
 }
 
+/// @brief takes over the nodes of the old tree without copying them
+BVH_tree::BVH_tree(BVH_tree&& old_tree) noexcept {
+  *this = std::move(old_tree);
+}
+
+BVH_tree& BVH_tree::operator=(BVH_tree&& old_tree) noexcept {
+  if (this == &old_tree) {
+    return *this;
+  }
+  destroy_tree();
+  destroy_treelets();
+
+  _triangles_flat = std::move(old_tree._triangles_flat);
+  _flat_memory = std::move(old_tree._flat_memory);
+  _triangles = old_tree._triangles;
+  root = old_tree.root;
+  _treelets = std::move(old_tree._treelets);
+
+  old_tree.root = nullptr;
+  old_tree._treelets.clear();
+  return *this;
+}
+
 bvh_node_pointer* BVH_tree::copy_node(bvh_node_pointer* old_node) {
   bvh_node_pointer* new_node = nullptr;
   if (old_node != nullptr) {
@@ -212,6 +239,8 @@ bvh_node_flat* BVH_tree::get_node(uint id_flat) {
   return _triangles_flat.data() + id_flat;
 }
 
+uint BVH_tree::get_size_flat() { return _triangles_flat.size(); }
+
 BVH_node_data* BVH_tree::get_data(uint id_flat) {
   return &(_triangles_flat.data() + id_flat)->data;
 }
@@ -227,8 +256,15 @@ void BVH_tree::free_triangles(bvh_node_pointer* node) {
 }
 
 void BVH_tree::flatten_tree() {
+  TIMELINE_ZONE("flatten bvh");
+  // the pointer tree and the flat copy exist at the same time while
+  // flattening, which is the peak of the build
+  MemoryAccount build_memory(MEM_BVH_BUILD);
+  build_memory.set(get_subtree_bytes(get_root()));
+
   // traverse in depth first search order and append items to array.
   flatten_node(get_root());
+  _flat_memory.set(get_flat_bytes());
   destroy_tree();
 }
 
@@ -248,6 +284,22 @@ uint BVH_tree::flatten_node(bvh_node_pointer* node) {
 }
 // private
 
+uint64_t BVH_tree::get_subtree_bytes(bvh_node_pointer* node) {
+  if (node == nullptr) {
+    return 0;
+  }
+  return sizeof(bvh_node_pointer) + get_vector_bytes(node->data.triangle_ids) +
+         get_subtree_bytes(node->left) + get_subtree_bytes(node->right);
+}
+
+uint64_t BVH_tree::get_flat_bytes() {
+  uint64_t bytes = get_vector_bytes(_triangles_flat);
+  for (const bvh_node_flat& node : _triangles_flat) {
+    bytes += get_vector_bytes(node.data.triangle_ids);
+  }
+  return bytes;
+}
+
 void BVH_tree::destroy_node(bvh_node_pointer* node) {
   if (node == nullptr) {
     return;
@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "box.hpp"
+#include "memory_stats.hpp"
 #include "triangle.hpp"
 
 #define MAX_TRIANGLES 1
@@ -38,6 +39,8 @@ class BVH_tree {
   explicit BVH_tree(BVH_node_data root_data, std::vector<Triangle>* triangles);
   BVH_tree(const BVH_tree& old_tree);
   BVH_tree& operator=(const BVH_tree& old_tree);
+  BVH_tree(BVH_tree&& old_tree) noexcept;
+  BVH_tree& operator=(BVH_tree&& old_tree) noexcept;
   bvh_node_pointer* copy_node(bvh_node_pointer* old_node);
   ~BVH_tree();
 
@@ -92,6 +95,8 @@ class BVH_tree {
 
   BVH_node_data* get_data(uint id_flat);
   bvh_node_flat* get_node(uint id_flat);
+  /// @brief number of nodes in the flattened tree.
+  uint get_size_flat();
 
   bool is_leaf(bvh_node_pointer* node);
   void free_triangles(bvh_node_pointer* node);
@@ -110,9 +115,13 @@ class BVH_tree {
   void destroy_treelets();
 
   uint flatten_node(bvh_node_pointer* node);
+  /// @brief bytes of the node, its triangle ids and its subtree.
+  uint64_t get_subtree_bytes(bvh_node_pointer* node);
+  uint64_t get_flat_bytes();
 
   std::vector<bvh_node_flat> _triangles_flat;
+  MemoryAccount _flat_memory{MEM_BVH_NODES};
   bvh_node_pointer* root = nullptr;
-  std::vector<Triangle>* _triangles;
+  std::vector<Triangle>* _triangles = nullptr;
   std::vector<bvh_node_pointer*> _treelets;
 };
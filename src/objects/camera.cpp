@@ -4,10 +4,13 @@
 
 #include "camera.hpp"
 
+#include <cstdint>
 #include <glm/gtx/string_cast.hpp>
 #include <iostream>
 #include <stdexcept>
 
+#include "hash.hpp"
+
 /**
  * @brief Construct a new Camera:: Camera object
  *
@@ -65,6 +68,7 @@ void Camera::set_sensor_size(float x, float y) {
 /***** Geters *****/
 
 vec2 Camera::get_resolution() { return _resolution; }
+vec2 Camera::get_sensor_size() { return _sensor_size; }
 
 /***** Camera Functions *****/
 
@@ -83,8 +87,14 @@ Ray Camera::get_ray(vec2 pixel) {
 }
 
 Ray Camera::get_ray(vec2 pixel, vec2 relative_position, float random_range) {
-  // random value between -1 and 1
-  double rand = (static_cast<double>(std::rand()) / RAND_MAX * 2) - 1;
+  // random value between -1 and 1, hashed from the sample position so every
+  // render gives the same image independent of the order of the pixels
+  glm::uvec2 sample = glm::uvec2(relative_position * 1024.f);
+  uint32_t hash = hash_pcg(hash_position(static_cast<uint32_t>(pixel.x),
+                                         static_cast<uint32_t>(pixel.y),
+                                         sample.x) ^
+                           sample.y);
+  double rand = static_cast<double>(hash) / UINT32_MAX * 2 - 1;
   vec2 range = vec2(rand * random_range * _pixel_size.x,
                     rand * random_range * _pixel_size.y);
   vec2 pos_image = pixel_to_image_pos(pixel, relative_position + range);
@@ -94,6 +104,42 @@ Ray Camera::get_ray(vec2 pixel, vec2 relative_position, float random_range) {
   return res;
 }
 
+/**
+ * @brief Generate the rays of a block of pixels, every ray is the same as the
+ * one of get_ray for its pixel.
+ *
+ * @param pixel {x, y} first pixel of the block.
+ * @param size {width, height} of the block, clipped to RAY_PACKET_WIDTH.
+ * @param relative_position sample position inside of the pixels.
+ * @param random_range see get_ray.
+ * @param packet packet to fill.
+ */
+void Camera::get_ray_packet(vec2 pixel, vec2 size, vec2 relative_position,
+                            float random_range, ray_packet *packet) {
+  for (int y = 0; y < RAY_PACKET_WIDTH; y++) {
+    for (int x = 0; x < RAY_PACKET_WIDTH; x++) {
+      uint lane = y * RAY_PACKET_WIDTH + x;
+      if (x >= size.x || y >= size.y) {
+        packet->active[lane] = 0;
+        continue;
+      }
+      packet->set(lane, get_ray(pixel + vec2(x, y), relative_position,
+                                random_range));
+    }
+  }
+}
+
+frustum Camera::get_tile_frustum(vec2 start, vec2 end) {
+  // one pixel more on every side covers the sample positions and the random
+  // offsets
+  vec2 min = (start - vec2(1)) * _pixel_size;
+  vec2 max = (end + vec2(1)) * _pixel_size;
+  return create_frustum(_origin, {image_to_world(min),
+                                  image_to_world(vec2(max.x, min.y)),
+                                  image_to_world(max),
+                                  image_to_world(vec2(min.x, max.y))});
+}
+
 /***** Transform Coordinates *****/
 
 /**
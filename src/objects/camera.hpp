@@ -5,7 +5,9 @@
 
 #include <glm/glm.hpp>
 
+#include "frustum.hpp"
 #include "ray.hpp"
+#include "ray_packet.hpp"
 #include "transform.hpp"
 
 using glm::vec2;
@@ -18,9 +20,17 @@ class Camera {
 
   // getters
   vec2 get_resolution();
+  vec2 get_sensor_size();
 
   Ray get_ray(vec2 pixel);
   Ray get_ray(vec2 pixel, vec2 relative_position, float random_range);
+  /// @brief rays of the block of size pixels starting at pixel (at most
+  /// RAY_PACKET_WIDTH per side), the other lanes are inactive.
+  void get_ray_packet(vec2 pixel, vec2 size, vec2 relative_position,
+                      float random_range, ray_packet *packet);
+  /// @brief frustum that contains all rays of the pixels [start, end) (for
+  /// every sample position and random offset of get_ray).
+  frustum get_tile_frustum(vec2 start, vec2 end);
 
   // setters
   void set_sensor_size(float x, float y);
@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+#include "frustum.hpp"
+
+#include <cmath>
+
+frustum create_frustum(vec3 origin, const std::array<vec3, 4> &corners) {
+  frustum f;
+  f.origin = origin;
+  vec3 center = corners[0] + corners[1] + corners[2] + corners[3];
+  for (int i = 0; i < 4; i++) {
+    vec3 n = glm::normalize(glm::cross(corners[i], corners[(i + 1) % 4]));
+    // the corners can be clockwise or counter clockwise
+    f.normals[i] = glm::dot(n, center) < 0 ? -n : n;
+  }
+  return f;
+}
+
+bool intersect_frustum(const frustum &f, const bvh_box &box) {
+  for (const vec3 &n : f.normals) {
+    // corner of the box furthest inside of the plane
+    vec3 p = vec3(n.x > 0 ? box.max.x : box.min.x,
+                  n.y > 0 ? box.max.y : box.min.y,
+                  n.z > 0 ? box.max.z : box.min.z);
+    vec3 d = p - f.origin;
+    // tolerance for the rounding of the box and the plane
+    float epsilon = 1e-5f * (std::abs(d.x) + std::abs(d.y) + std::abs(d.z));
+    if (glm::dot(n, d) < -epsilon) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+#pragma once
+
+#include <array>
+#include <glm/glm.hpp>
+
+#include "box.hpp"
+
+using glm::vec3;
+
+/// @brief pyramid of rays starting at origin (e.g. the camera rays of a tile).
+struct frustum {
+  vec3 origin;
+  /// @brief inward normals of the four side planes through origin.
+  std::array<vec3, 4> normals;
+};
+
+/**
+ * @brief Frustum of all rays from origin through the quad of the corner
+ * directions.
+ *
+ * @param origin start of the rays.
+ * @param corners directions of the corner rays in order around the quad.
+ * @return frustum
+ */
+frustum create_frustum(vec3 origin, const std::array<vec3, 4> &corners);
+
+/// @brief false only if the box is completely outside of the frustum.
+bool intersect_frustum(const frustum &f, const bvh_box &box);
@@ -0,0 +1,19 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+#pragma once
+
+#include <cstdint>
+
+/// @brief pcg output permutation, spreads the bits of value.
+inline uint32_t hash_pcg(uint32_t value) {
+  uint32_t state = value * 747796405u + 2891336453u;
+  uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+  return (word >> 22u) ^ word;
+}
+
+/// @brief spatial hash of integer (or bit cast float) coordinates, has to be
+/// spread with hash_pcg before the bits are used as random numbers.
+inline uint32_t hash_position(uint32_t x, uint32_t y, uint32_t z) {
+  return x * 73856093u ^ y * 19349663u ^ z * 83492791u;
+}
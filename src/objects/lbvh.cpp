@@ -3,16 +3,23 @@
  */
 #include "lbvh.hpp"
 
+#include <algorithm>
 #include <boost/lambda/bind.hpp>
 #include <cstdint>
 #include <execution>
 #include <glm/gtx/string_cast.hpp>
 
+#include "build_parameters.hpp"
 #include "bvh_tree.hpp"
+#include "perf_counters.hpp"
+#include "timeline.hpp"
 
-LBVH::LBVH(BVH_tree *tree) {
+LBVH::LBVH(BVH_tree *tree, const build_parameters &parameters) {
   _tree = tree;
   _morton = Morton(tree->get_triangle_vec(), GRID_SIZE);
+  _max_triangles = std::max(parameters.leaf_size, 1u);
+  // the treelet prefix can not be longer than the morton code
+  _treelet_bits = std::min(parameters.treelet_bits, _morton.get_morton_size());
 }
 
 void LBVH::split(bvh_node_pointer *node, uint split_id) {
@@ -55,7 +62,7 @@ void LBVH::split_first_bit(bvh_node_pointer *node, uint current_bit) {
   uint first_id = _tree->get_data(node)->triangle_ids.at(0);
   size_t size = _tree->get_data(node)->triangle_ids.size();
 
-  if (size <= MAX_TRIANGLES) {
+  if (size <= _max_triangles) {
     return;
   }
   for (size_t i = current_bit; i > 0; i--) {
@@ -88,7 +95,7 @@ void LBVH::add_treelets(bvh_node_pointer *node) {
   for (uint id : data->triangle_ids) {
     uint64_t morton_code = _morton.get_code(id);
     uint64_t top_bits =
-        (morton_code >> (_morton.get_morton_size() - TREELET_BITS));
+        (morton_code >> (_morton.get_morton_size() - _treelet_bits));
 
     if (new_treelet) {
       current_top_bits = top_bits;
@@ -114,6 +121,7 @@ void LBVH::add_treelets(bvh_node_pointer *node) {
 }
 
 void LBVH::build_treelets() {
+  TIMELINE_ZONE("hlbvh treelets");
   BVH_node_data *data_root = _tree->get_data(_tree->get_root());
   _morton.build(&data_root->triangle_ids, data_root->bounds);
 
@@ -121,7 +129,7 @@ void LBVH::build_treelets() {
   std::cout << "number of treelets: " << _tree->get_treelets().size();
 
   // for (bvh_node_pointer *treelet : _tree->get_treelets()) {
-  //   split_first_bit(treelet, _morton.get_morton_size() - TREELET_BITS);
+  //   split_first_bit(treelet, _morton.get_morton_size() - _treelet_bits);
   // }
   std::chrono::steady_clock::time_point begin =
       std::chrono::steady_clock::now();
@@ -129,8 +137,10 @@ void LBVH::build_treelets() {
   std::vector<bvh_node_pointer *> treelets = _tree->get_treelets();
   std::for_each(std::execution::par_unseq, treelets.begin(), treelets.end(),
                 [this](bvh_node_pointer *treelet) {
+                  // counts the workers too, the phase is per thread
+                  PERF_SCOPE(PERF_BUILD);
                   split_first_bit(treelet,
-                                  _morton.get_morton_size() - TREELET_BITS);
+                                  _morton.get_morton_size() - _treelet_bits);
                 });
 
   std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
@@ -147,6 +157,7 @@ void LBVH::build_treelets() {
 }
 
 void LBVH::build() {
+  TIMELINE_ZONE("lbvh");
   BVH_node_data *data_root = _tree->get_data(_tree->get_root());
   _morton.build(&data_root->triangle_ids, data_root->bounds);
   split_first_bit(_tree->get_root(),
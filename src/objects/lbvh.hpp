@@ -24,6 +24,8 @@ using glm::vec3;
 // 0 = only use lbvh since just one treelet get's added
 #define TREELET_BITS 22
 
+struct build_parameters;
+
 struct morton_data {
   uint triangle_id;
   uint32_t morton_code;
@@ -31,7 +33,7 @@ struct morton_data {
 
 class LBVH {
  public:
-  explicit LBVH(BVH_tree *tree);
+  LBVH(BVH_tree *tree, const build_parameters &parameters);
 
   /**
    * @brief Build tree from sorted triangles in root node.
@@ -77,6 +79,8 @@ class LBVH {
   void split_first_bit(bvh_node_pointer *node, uint current_bit);
 
   BVH_tree *_tree;
+  uint _max_triangles = MAX_TRIANGLES;
+  uint _treelet_bits = TREELET_BITS;
   // Saves morton code for triangle with id i at index i
   Morton _morton = Morton(nullptr, GRID_SIZE);
 };
@@ -14,6 +14,8 @@ Light::Light(vec3 position, float intensity) {
   _color = vec3(intensity);
 }
 
+vec3 Light::get_position() const { return _origin; }
+
 vec3 Light::get_light_direction(vec3 point) const {
   return glm::normalize(_origin - point);
 }
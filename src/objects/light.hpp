@@ -14,6 +14,7 @@ class Light : public Object {
   Light(vec3 position, vec3 color);
   Light(vec3 position, float intensity);
 
+  vec3 get_position() const;
   vec3 get_light_direction(vec3 point) const;
   float get_distance(vec3 point) const;
   vec3 get_color() const;
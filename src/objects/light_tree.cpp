@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+
+#include "light_tree.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+float get_power(vec3 color) { return color.x + color.y + color.z; }
+
+}  // namespace
+
+LightTree::LightTree(const std::vector<Pointlight> &lights) {
+  if (lights.empty()) {
+    return;
+  }
+  std::vector<uint> ids(lights.size());
+  std::iota(ids.begin(), ids.end(), 0);
+  _nodes.reserve(2 * lights.size() - 1);
+  build(lights, ids.data(), ids.size());
+}
+
+/// @brief add the node of the lights ids[0, count) and its children.
+uint LightTree::build(const std::vector<Pointlight> &lights, uint *ids,
+                      uint count) {
+  uint id = _nodes.size();
+  _nodes.push_back({});
+
+  light_node node = {};
+  node.min = lights[ids[0]].get_position();
+  node.max = node.min;
+  node.count = count;
+  node.representative = ids[0];
+  for (uint i = 0; i < count; i++) {
+    node.min = glm::min(node.min, lights[ids[i]].get_position());
+    node.max = glm::max(node.max, lights[ids[i]].get_position());
+    node.color += lights[ids[i]].get_color();
+  }
+  if (count == 1) {
+    _nodes[id] = node;
+    return id;
+  }
+
+  // split the power on the longest axis in half
+  vec3 extent = node.max - node.min;
+  int axis = extent.x > extent.y ? 0 : 1;
+  axis = extent.z > extent[axis] ? 2 : axis;
+  std::sort(ids, ids + count, [&lights, axis](uint a, uint b) {
+    return lights[a].get_position()[axis] < lights[b].get_position()[axis];
+  });
+  float half = get_power(node.color) / 2;
+  float power = 0;
+  uint split = 1;
+  for (; split < count - 1; split++) {
+    power += get_power(lights[ids[split - 1]].get_color());
+    if (power >= half) {
+      break;
+    }
+  }
+
+  node.left = build(lights, ids, split);
+  node.right = build(lights, ids + split, count - split);
+  const light_node &left = _nodes[node.left];
+  const light_node &right = _nodes[node.right];
+  node.representative = get_power(left.color) >= get_power(right.color)
+                            ? left.representative
+                            : right.representative;
+  _nodes[id] = node;
+  return id;
+}
+
+bool LightTree::empty() const { return _nodes.empty(); }
+
+const light_node &LightTree::get_node(uint id) const { return _nodes[id]; }
+
+float LightTree::get_cos_bound(uint id, vec3 point, vec3 normal) const {
+  const light_node &node = _nodes[id];
+  // largest dot(normal, light - point) of the corners of the bounds
+  float max_dot = 0;
+  for (int a = 0; a < 3; a++) {
+    max_dot += normal[a] * ((normal[a] > 0 ? node.max[a] : node.min[a]) -
+                            point[a]);
+  }
+  if (max_dot <= 0) {
+    return 0;
+  }
+  // every light is at least this far away
+  float distance = glm::length(
+      glm::max(node.min - point, glm::max(vec3(0), point - node.max)));
+  if (distance <= 0) {
+    return 1;
+  }
+  return std::min(1.0f, max_dot / distance);
+}
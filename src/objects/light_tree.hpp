@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "pointlight.hpp"
+
+using glm::vec3;
+
+/// @brief cluster of point lights (a single light if count is 1).
+struct light_node {
+  /// @brief bounds of the light positions.
+  vec3 min;
+  vec3 max;
+  /// @brief summed color of all lights of the cluster.
+  vec3 color;
+  /// @brief light that stands in for the whole cluster.
+  uint representative;
+  uint count;
+  /// @brief child nodes (only if count > 1).
+  uint left;
+  uint right;
+};
+
+/**
+ * @brief Binary tree of clusters of point lights for light cuts.
+ *
+ * Clusters are split on the longest axis of their bounds where half of their
+ * power is on either side. The representative of a cluster is the one of its
+ * brighter child, so every cluster can be shaded like a single light with the
+ * summed color.
+ */
+class LightTree {
+ public:
+  LightTree() = default;
+  explicit LightTree(const std::vector<Pointlight> &lights);
+
+  bool empty() const;
+  /// @brief root is node 0.
+  const light_node &get_node(uint id) const;
+
+  /**
+   * @brief Upper bound of dot(normal, direction to a light) of all lights of
+   * the node, 0 if the whole cluster is behind the surface.
+   *
+   * @param id node.
+   * @param point shading point.
+   * @param normal normalized surface normal.
+   */
+  float get_cos_bound(uint id, vec3 point, vec3 normal) const;
+
+ private:
+  std::vector<light_node> _nodes;
+
+  uint build(const std::vector<Pointlight> &lights, uint *ids, uint count);
+};
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+#include "memory_stats.hpp"
+
+#include <iomanip>
+#include <iostream>
+
+// ----------------------------------------------------------------------------
+// MemoryStats
+
+MemoryStats &MemoryStats::get_instance() {
+  static MemoryStats instance;
+  return instance;
+}
+
+void MemoryStats::add(MemoryTag tag, uint64_t bytes) {
+  if (bytes == 0) {
+    return;
+  }
+  update_peak(&_peak[tag], _current[tag].fetch_add(bytes) + bytes);
+  update_peak(&_total_peak, _total.fetch_add(bytes) + bytes);
+}
+
+void MemoryStats::remove(MemoryTag tag, uint64_t bytes) {
+  _current[tag].fetch_sub(bytes);
+  _total.fetch_sub(bytes);
+}
+
+memory_report MemoryStats::get_report() {
+  memory_report report;
+  for (uint t = 0; t < MEMORY_TAG_COUNT; t++) {
+    report.tags[t] = {_current[t].load(), _peak[t].load()};
+  }
+  report.total = {_total.load(), _total_peak.load()};
+  return report;
+}
+
+void MemoryStats::print(std::string stage) {
+  memory_report report = get_report();
+  std::cout << "memory after " << stage << " (current / peak MiB):\n"
+            << std::fixed << std::setprecision(1);
+  for (uint t = 0; t < MEMORY_TAG_COUNT; t++) {
+    std::cout << "  " << std::left << std::setw(12)
+              << get_name(static_cast<MemoryTag>(t)) << std::right
+              << std::setw(10) << report.tags[t].current / 1048576.0 << " / "
+              << report.tags[t].peak / 1048576.0 << "\n";
+  }
+  std::cout << "  " << std::left << std::setw(12) << "total" << std::right
+            << std::setw(10) << report.total.current / 1048576.0 << " / "
+            << report.total.peak / 1048576.0 << "\n"
+            << std::defaultfloat;
+}
+
+std::string MemoryStats::get_name(MemoryTag tag) {
+  switch (tag) {
+    case MEM_TRIANGLES:
+      return "triangles";
+    case MEM_BVH_BUILD:
+      return "bvh_build";
+    case MEM_BVH_NODES:
+      return "bvh_nodes";
+    case MEM_GRID:
+      return "grid";
+    case MEM_TEXTURES:
+      return "textures";
+    case MEM_IMAGES:
+      return "images";
+  }
+  return "unknown";
+}
+
+void MemoryStats::update_peak(std::atomic<uint64_t> *peak, uint64_t value) {
+  uint64_t old_peak = peak->load(std::memory_order_relaxed);
+  while (value > old_peak &&
+         !peak->compare_exchange_weak(old_peak, value,
+                                      std::memory_order_relaxed)) {
+  }
+}
+
+// ----------------------------------------------------------------------------
+// MemoryAccount
+
+MemoryAccount::MemoryAccount(const MemoryAccount &old_account) {
+  _tag = old_account._tag;
+  set(old_account._bytes);
+}
+
+MemoryAccount &MemoryAccount::operator=(const MemoryAccount &old_account) {
+  if (this != &old_account) {
+    set(0);
+    _tag = old_account._tag;
+    set(old_account._bytes);
+  }
+  return *this;
+}
+
+MemoryAccount::MemoryAccount(MemoryAccount &&old_account) noexcept {
+  _tag = old_account._tag;
+  _bytes = old_account._bytes;
+  old_account._bytes = 0;
+}
+
+MemoryAccount &MemoryAccount::operator=(MemoryAccount &&old_account) noexcept {
+  if (this != &old_account) {
+    set(0);
+    _tag = old_account._tag;
+    _bytes = old_account._bytes;
+    old_account._bytes = 0;
+  }
+  return *this;
+}
+
+MemoryAccount::~MemoryAccount() { set(0); }
+
+void MemoryAccount::set(uint64_t bytes) {
+  MemoryStats &stats = MemoryStats::get_instance();
+  if (bytes > _bytes) {
+    stats.add(_tag, bytes - _bytes);
+  } else {
+    stats.remove(_tag, _bytes - bytes);
+  }
+  _bytes = bytes;
+}
+
+uint64_t MemoryAccount::get_bytes() const { return _bytes; }
+
+// ----------------------------------------------------------------------------
+
+void write_memory_json(std::ostream *out, const memory_report &report,
+                       std::string indent) {
+  *out << "{";
+  for (uint t = 0; t < MEMORY_TAG_COUNT; t++) {
+    *out << "\n"
+         << indent << "  \"" << MemoryStats::get_name(static_cast<MemoryTag>(t))
+         << "\": {\"current\": " << report.tags[t].current
+         << ", \"peak\": " << report.tags[t].peak << "},";
+  }
+  *out << "\n"
+       << indent << "  \"total\": {\"current\": " << report.total.current
+       << ", \"peak\": " << report.total.peak << "}\n"
+       << indent << "}";
+}
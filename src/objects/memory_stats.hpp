@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// print the memory of every subsystem after loading and building a mesh
+#define PRINT_MEMORY true
+
+enum MemoryTag {
+  MEM_TRIANGLES,
+  /// @brief pointer tree, treelets and morton codes, freed after the build.
+  MEM_BVH_BUILD,
+  /// @brief flattened nodes including their triangle ids.
+  MEM_BVH_NODES,
+  MEM_GRID,
+  /// @brief decode buffers, resident textures and cached tiles.
+  MEM_TEXTURES,
+  MEM_IMAGES
+};
+
+#define MEMORY_TAG_COUNT 6
+
+struct memory_usage {
+  uint64_t current = 0;
+  uint64_t peak = 0;
+};
+
+struct memory_report {
+  std::array<memory_usage, MEMORY_TAG_COUNT> tags;
+  /// @brief all tags together (the peak is not the sum of the tag peaks).
+  memory_usage total;
+};
+
+/**
+ * @brief Current and peak bytes of the large allocations, per subsystem.
+ *
+ * The owners of the data report their size through a MemoryAccount, so only
+ * what is accounted shows up (not the allocator overhead or small objects,
+ * compare with the peak rss of the process).
+ */
+class MemoryStats {
+ public:
+  static MemoryStats& get_instance();
+
+  void add(MemoryTag tag, uint64_t bytes);
+  void remove(MemoryTag tag, uint64_t bytes);
+
+  memory_report get_report();
+  /// @brief prints current and peak MiB of every tag.
+  void print(std::string stage);
+
+  static std::string get_name(MemoryTag tag);
+
+ private:
+  MemoryStats() {}
+
+  static void update_peak(std::atomic<uint64_t>* peak, uint64_t value);
+
+  std::array<std::atomic<uint64_t>, MEMORY_TAG_COUNT> _current{};
+  std::array<std::atomic<uint64_t>, MEMORY_TAG_COUNT> _peak{};
+  std::atomic<uint64_t> _total{0};
+  std::atomic<uint64_t> _total_peak{0};
+};
+
+/**
+ * @brief Bytes of one owner (e.g. the triangles of a mesh) in MemoryStats.
+ *
+ * Copies account the bytes again and moves take them over, like the
+ * containers the account belongs to. The bytes are removed on destruction.
+ */
+class MemoryAccount {
+ public:
+  explicit MemoryAccount(MemoryTag tag) : _tag(tag) {}
+  MemoryAccount(const MemoryAccount& old_account);
+  MemoryAccount& operator=(const MemoryAccount& old_account);
+  MemoryAccount(MemoryAccount&& old_account) noexcept;
+  MemoryAccount& operator=(MemoryAccount&& old_account) noexcept;
+  ~MemoryAccount();
+
+  /// @brief replaces the accounted bytes.
+  void set(uint64_t bytes);
+  uint64_t get_bytes() const;
+
+ private:
+  MemoryTag _tag;
+  uint64_t _bytes = 0;
+};
+
+/// @brief allocated bytes of the elements of a vector.
+template <typename T>
+uint64_t get_vector_bytes(const std::vector<T>& vector) {
+  return vector.capacity() * sizeof(T);
+}
+
+/// @brief writes the report as json object (for the bench output).
+void write_memory_json(std::ostream* out, const memory_report& report,
+                       std::string indent);
@@ -10,9 +10,14 @@
 #include <glm/gtx/string_cast.hpp>
 #include <iostream>
 #include <mutex>
+#include <stdexcept>
+#include <unordered_map>
 
+#include "autotune.hpp"
 #include "bvh.hpp"
 #include "lib/objloader.hpp"
+#include "perf_counters.hpp"
+#include "timeline.hpp"
 
 /**
  * @brief Construct a new Mesh:: Mesh object
@@ -36,44 +41,84 @@ Mesh::Mesh(std::string folder, std::string file, vec3 origin) {
  * @param material set material of mesh.
  */
 Mesh::Mesh(std::string folder, std::string file, vec3 origin, Material material,
-           Algorithm algorithm) {
+           mesh_build build) {
   _origin = origin;
   _path_folder = folder;
   _material_default = material;
   _materials.push_back(material);
   read_from_obj(folder, file);  // read file with origin as offset
-  _used_algorithm = algorithm;
 
-  build_datastructure();
+  build_datastructure(build);
 }
 
 Mesh::Mesh(std::string folder, std::string file, vec3 origin, Material material,
-           std::string texture_path, Algorithm algorithm) {
+           std::string texture_path, mesh_build build) {
   _origin = origin;
   _path_folder = folder;
   _material_default = material;
   _materials.push_back(material);
   read_from_obj(folder, file);  // read file with origin as offset
-  _used_algorithm = algorithm;
 
   // load and enable texture
   _enable_texture = true;
   _texture.load_image(texture_path);
 
-  build_datastructure();
+  build_datastructure(build);
+}
+
+/**
+ * @brief Construct a Mesh from triangles that were not read from a file.
+ *
+ * @param triangles triangles in world space, their material ids get reset.
+ * @param material material of all triangles.
+ * @param build acceleration structure to build.
+ *
+ * Without an obj file there is no tuning file, with AUTOTUNE (or
+ * build.autotune) the mesh gets tuned on every construction.
+ */
+Mesh::Mesh(std::vector<Triangle> triangles, Material material,
+           mesh_build build) {
+  _material_default = material;
+  _materials.push_back(material);
+  _triangles = std::move(triangles);
+
+  for (Triangle &t : _triangles) {
+    t.set_material(0);
+    update_bounding_box(&t);
+  }
+  _origin = _bounding_box.get_middle();
+  _transform.add_translation(_origin);
+
+  build_datastructure(build);
+}
+
+void Mesh::build_datastructure(const mesh_build &build) {
+  _build_parameters.algorithm = build.algorithm;
+#if AUTOTUNE
+  autotune();
+#else
+  if (build.autotune) {
+    autotune();
+  } else {
+    build_datastructure();
+  }
+#endif
 }
 
 void Mesh::build_datastructure() {
+  TIMELINE_ZONE("build acceleration structure");
+  PERF_SCOPE(PERF_BUILD);
+  _triangle_memory.set(get_vector_bytes(_triangles));
   // stop time needed to build bvh
   std::chrono::steady_clock::time_point begin =
       std::chrono::steady_clock::now();
-  switch (_used_algorithm) {
+  switch (_build_parameters.algorithm) {
     case AGRID:
       std::cout << "Algorithm: Uniform Grid\n";
-      _grid.build(&_triangles);
+      _grid.build(&_triangles, _build_parameters.grid_size);
       break;
     default:
-      _bvh.build_tree_axis(&_triangles, _used_algorithm);
+      _bvh.build_tree_axis(&_triangles, _build_parameters);
       break;
   }
   std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
@@ -86,46 +131,155 @@ void Mesh::build_datastructure() {
   std::cout << "Time for building bvh (sec) = ";
   std::cout << _stats.time_building << "\n";
   std::cout << "------------------------------------------------\n";
+#if PRINT_MEMORY
+  MemoryStats::get_instance().print("build");
+#endif
+}
+
+/**
+ * @brief Replace the acceleration structure by one built with algorithm.
+ *
+ * @param algorithm algorithm to build the new structure with.
+ */
+void Mesh::set_algorithm(Algorithm algorithm) {
+  build_parameters parameters = _build_parameters;
+  parameters.algorithm = algorithm;
+  set_build_parameters(parameters);
+}
+
+void Mesh::set_build_parameters(const build_parameters &parameters) {
+  _build_parameters = parameters;
+  _bvh = BVH();
+  _grid = UniformGrid();
+  build_datastructure();
 }
 
-Mesh::Mesh(const Mesh &old_mesh) {
+build_parameters Mesh::get_build_parameters() { return _build_parameters; }
+
+/**
+ * @brief Build with the tuned parameters stored next to the obj file. If
+ * there are none (or they belong to another version of the file) the mesh
+ * gets tuned and the result is stored for the next run.
+ */
+void Mesh::autotune() {
+  build_parameters parameters;
+  if (_path_file.empty()) {
+    // generated mesh, nothing to store the result next to
+    AutoTuner tuner = AutoTuner(this);
+    set_build_parameters(tuner.tune());
+    return;
+  }
+
+  std::string path = get_tuning_path();
+  if (!AutoTuner::load(path, _triangles.size(), &parameters)) {
+    AutoTuner tuner = AutoTuner(this);
+    parameters = tuner.tune();
+    AutoTuner::save(path, _triangles.size(), parameters);
+  }
+  set_build_parameters(parameters);
+}
+
+std::string Mesh::get_tuning_path() {
+  return _path_folder + "/" + _path_file + ".tune";
+}
+
+bvh_report Mesh::get_bvh_report(bvh_report_settings settings) {
+  if (_build_parameters.algorithm == AGRID) {
+    throw std::runtime_error("Mesh uses no BVH!");
+  }
+  return _bvh.get_report(settings);
+}
+
+Mesh::Mesh(const Mesh &old_mesh) : Object(old_mesh) { *this = old_mesh; }
+
+Mesh &Mesh::operator=(const Mesh &old_mesh) {
+  Object::operator=(old_mesh);
   _triangles = old_mesh._triangles;
+  _triangle_memory = old_mesh._triangle_memory;
   _triangle_exists = old_mesh._triangle_exists;
   _size = old_mesh._size;
   _origin = old_mesh._origin;
   _bounding_box = old_mesh._bounding_box;
   _enable_smooth_shading = old_mesh._enable_smooth_shading;
+  _material_default = old_mesh._material_default;
   _materials = old_mesh._materials;
   _bvh = old_mesh._bvh;
   _texture = old_mesh._texture;
   _enable_texture = old_mesh._enable_texture;
   _grid = old_mesh._grid;
-  _used_algorithm = old_mesh._used_algorithm;
+  _build_parameters = old_mesh._build_parameters;
   _stats = old_mesh._stats;
   _textures_diffuse = old_mesh._textures_diffuse;
   _textures_specular = old_mesh._textures_specular;
+  _textures_normal = old_mesh._textures_normal;
+  _path_folder = old_mesh._path_folder;
+  _path_file = old_mesh._path_file;
 
   // set new triangle reference
   _bvh.set_triangles(&_triangles);
   _grid.set_triangles(&_triangles);
+
+  return *this;
 }
 
-Mesh &Mesh::operator=(const Mesh &old_mesh) {
-  _triangles = old_mesh._triangles;
+/**
+ * @brief Take over triangles, acceleration structure and textures.
+ *
+ * Only the triangle references of the acceleration structures get updated,
+ * nothing is copied.
+ */
+Mesh::Mesh(Mesh &&old_mesh) noexcept
+    : Object(std::move(old_mesh)),
+      _triangles(std::move(old_mesh._triangles)),
+      _triangle_memory(std::move(old_mesh._triangle_memory)),
+      _triangle_exists(old_mesh._triangle_exists),
+      _size(old_mesh._size),
+      _origin(old_mesh._origin),
+      _bounding_box(old_mesh._bounding_box),
+      _bvh(std::move(old_mesh._bvh)),
+      _grid(std::move(old_mesh._grid)),
+      _enable_smooth_shading(old_mesh._enable_smooth_shading),
+      _material_default(std::move(old_mesh._material_default)),
+      _materials(std::move(old_mesh._materials)),
+      _textures_diffuse(std::move(old_mesh._textures_diffuse)),
+      _textures_specular(std::move(old_mesh._textures_specular)),
+      _textures_normal(std::move(old_mesh._textures_normal)),
+      _path_folder(std::move(old_mesh._path_folder)),
+      _path_file(std::move(old_mesh._path_file)),
+      _texture(std::move(old_mesh._texture)),
+      _enable_texture(old_mesh._enable_texture),
+      _stats(old_mesh._stats),
+      // keeps the counters of the old mesh, no new slot is added
+      _stats_id(old_mesh._stats_id),
+      _build_parameters(old_mesh._build_parameters) {
+  // set new triangle reference
+  _bvh.set_triangles(&_triangles);
+  _grid.set_triangles(&_triangles);
+}
+
+Mesh &Mesh::operator=(Mesh &&old_mesh) noexcept {
+  Object::operator=(std::move(old_mesh));
+  _triangles = std::move(old_mesh._triangles);
+  _triangle_memory = std::move(old_mesh._triangle_memory);
   _triangle_exists = old_mesh._triangle_exists;
   _size = old_mesh._size;
   _origin = old_mesh._origin;
   _bounding_box = old_mesh._bounding_box;
   _enable_smooth_shading = old_mesh._enable_smooth_shading;
-  _materials = old_mesh._materials;
-  _bvh = old_mesh._bvh;
-  _texture = old_mesh._texture;
+  _material_default = std::move(old_mesh._material_default);
+  _materials = std::move(old_mesh._materials);
+  _bvh = std::move(old_mesh._bvh);
+  _texture = std::move(old_mesh._texture);
   _enable_texture = old_mesh._enable_texture;
-  _grid = old_mesh._grid;
-  _used_algorithm = old_mesh._used_algorithm;
+  _grid = std::move(old_mesh._grid);
+  _build_parameters = old_mesh._build_parameters;
   _stats = old_mesh._stats;
-  _textures_diffuse = old_mesh._textures_diffuse;
-  _textures_specular = old_mesh._textures_specular;
+  _stats_id = old_mesh._stats_id;
+  _textures_diffuse = std::move(old_mesh._textures_diffuse);
+  _textures_specular = std::move(old_mesh._textures_specular);
+  _textures_normal = std::move(old_mesh._textures_normal);
+  _path_folder = std::move(old_mesh._path_folder);
+  _path_file = std::move(old_mesh._path_file);
 
   // set new triangle reference
   _bvh.set_triangles(&_triangles);
@@ -146,7 +300,26 @@ void Mesh::print(void) {
   print_bounding_box();
 }
 
-mesh_stats Mesh::get_stats(void) { return _stats; }
+/**
+ * @brief Returns the build time and the traversal stats of all threads.
+ *
+ * Should only be called while no rays are traced.
+ */
+mesh_stats Mesh::get_stats(void) {
+  traversal_counters counters =
+      TraversalStats::get_instance().merge(_stats_id);
+
+  mesh_stats stats = _stats;
+  stats.intersects = counters.rays;
+  stats.node_intersects = counters.nodes;
+  stats.min_node_intersects = counters.min_nodes;
+  stats.max_node_intersects = counters.max_nodes;
+  stats.triangle_intersects = counters.triangles;
+  stats.min_triangle_intersects = counters.min_triangles;
+  stats.max_triangle_intersects = counters.max_triangles;
+  stats.intersection_time_all = counters.get_estimated_time();
+  return stats;
+}
 
 /**
  * @brief Print all triangles of the mesh.
@@ -171,7 +344,7 @@ void Mesh::print_bounding_box(void) { _bounding_box.print(); }
  *
  * @return int
  */
-int Mesh::get_size(void) { return _size; }
+int Mesh::get_size(void) { return _triangles.size(); }
 
 /**
  * @brief Get a specific Triangle from the mesh.
@@ -215,20 +388,96 @@ void Mesh::update_bounding_box(Triangle *t) {
 /***** Functions *****/
 
 Intersection Mesh::intersect(const Ray &ray) {
+  return get_intersect(intersect_triangles(ray));
+}
+
+TriangleIntersection Mesh::intersect_triangles(const Ray &ray,
+                                               uint entry_node) {
   TriangleIntersection intersect_triangle;
-  switch (_used_algorithm) {
+  switch (_build_parameters.algorithm) {
     case AGRID:
       intersect_triangle = _grid.intersect(ray);
       break;
-    default:
-      intersect_triangle = _bvh.intersect(ray);
+    default: {
+      bvh_stats stats;
+      intersect_triangle = _bvh.intersect(ray, entry_node, &stats);
 #if GET_STATS
-      update_stats(_bvh.get_stats());
+      TraversalStats::get_instance().record(
+          _stats_id, stats.node_intersects, stats.triangle_intersects,
+          stats.intersection_time);
 #endif
       break;
+    }
   }
+  return intersect_triangle;
+}
 
-  return get_intersect(intersect_triangle);
+void Mesh::intersect_packet(const ray_packet &packet,
+                            TriangleIntersection *hits, uint entry_node) {
+  switch (_build_parameters.algorithm) {
+    case AGRID:
+      for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+        hits[lane] = packet.active[lane]
+                         ? intersect_triangles(packet.get_ray(lane))
+                         : TriangleIntersection();
+      }
+      break;
+    default: {
+      bvh_stats stats[RAY_PACKET_SIZE];
+      _bvh.intersect_packet(packet, hits, entry_node, stats);
+#if GET_STATS
+      // the lanes are not timed
+      for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+        if (packet.active[lane]) {
+          TraversalStats::get_instance().record(
+              _stats_id, stats[lane].node_intersects,
+              stats[lane].triangle_intersects, stats[lane].intersection_time);
+        }
+      }
+#endif
+      break;
+    }
+  }
+}
+
+void Mesh::occluded_packet(const ray_packet &packet, const float *t_max,
+                           uint8_t *occluded) {
+  switch (_build_parameters.algorithm) {
+    case AGRID:
+      for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+        if (packet.active[lane] && !occluded[lane]) {
+          occluded[lane] = intersect_bool(packet.get_ray(lane), t_max[lane]);
+        }
+      }
+      break;
+    default: {
+#if GET_STATS
+      uint8_t traced[RAY_PACKET_SIZE];
+      for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+        traced[lane] = packet.active[lane] && !occluded[lane];
+      }
+#endif
+      bvh_stats stats[RAY_PACKET_SIZE];
+      _bvh.occluded_packet(packet, t_max, occluded, stats);
+#if GET_STATS
+      for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+        if (traced[lane]) {
+          TraversalStats::get_instance().record(
+              _stats_id, stats[lane].node_intersects,
+              stats[lane].triangle_intersects, stats[lane].intersection_time);
+        }
+      }
+#endif
+      break;
+    }
+  }
+}
+
+uint Mesh::get_entry_node(const frustum &f) {
+  if (_build_parameters.algorithm == AGRID) {
+    return 0;
+  }
+  return _bvh.get_entry_node(f);
 }
 
 Intersection Mesh::get_intersect(const TriangleIntersection t_intersect) {
@@ -256,9 +505,6 @@ Intersection Mesh::get_intersect(const TriangleIntersection t_intersect) {
   // calculate normals if
   // res.normal =
   // _textures_normal.at(res.material.texture_id_normal).get_normal_uv(t_intersect.normal_uv);
-#if VISUALIZE_BVH
-  res.material.color = _bvh.get_stats().intersection_color;
-#endif
   return res;
 }
 
@@ -270,6 +516,8 @@ Intersection Mesh::get_intersect(const TriangleIntersection t_intersect) {
  * @param inputfile path to obj file.
  */
 void Mesh::read_from_obj(std::string folder, std::string file) {
+  TIMELINE_ZONE("load obj");
+  _path_file = file;
   tinyobj::attrib_t attrib;
   std::vector<tinyobj::shape_t> shapes;
   std::vector<tinyobj::material_t> materials;
@@ -285,7 +533,7 @@ void Mesh::read_from_obj(std::string folder, std::string file) {
     std::cerr << err << std::endl;
   }
   if (!ret) {
-    exit(1);
+    throw std::runtime_error("could not load " + inputfile);
   }
 
   // shapes.size() number of objects
@@ -315,26 +563,30 @@ void Mesh::read_from_obj(std::string folder, std::string file) {
   // read materials
   if (materials.size() > 1) {
     _materials.clear();
+
+    // materials sharing an image file also share the texture id
+    std::unordered_map<std::string, int> ids_diffuse;
+    std::unordered_map<std::string, int> ids_specular;
+
     std::for_each(
         std::execution::seq, materials.begin(), materials.end(),
-        [this](tinyobj::material_t material) {
-          Texture t_diffuse = Texture();
+        [&](const tinyobj::material_t &material) {
+          int texture_id_diffuse = -1;
+          int texture_id_specular = -1;
 
 #if LOAD_TEXTURES
           if (material.diffuse_texname.length() > 0) {
-            Texture t_diffuse =
-                Texture(_path_folder + "/" + material.diffuse_texname);
+            texture_id_diffuse =
+                add_texture(&_textures_diffuse, &ids_diffuse,
+                            _path_folder + "/" + material.diffuse_texname);
             _enable_texture = true;
-            _textures_diffuse.push_back(t_diffuse);
           }
           if (material.specular_texname.length() > 0) {
-            Texture t_specular =
-                Texture(_path_folder + "/" + material.specular_texname);
-            _textures_specular.push_back(t_specular);
+            texture_id_specular =
+                add_texture(&_textures_specular, &ids_specular,
+                            _path_folder + "/" + material.specular_texname);
           }
 #endif
-          int texture_id_diffuse = _textures_diffuse.size() - 1;
-          int texture_id_specular = _textures_specular.size() - 1;
           _materials.push_back(
               {.color = vec3(material.diffuse[0], material.diffuse[1],
                              material.diffuse[2]),
@@ -346,6 +598,14 @@ void Mesh::read_from_obj(std::string folder, std::string file) {
                .texture_id_diffuse = texture_id_diffuse,
                .texture_id_specular = texture_id_specular});
         });
+
+    // decode all distinct images in parallel
+    std::vector<Texture> textures = _textures_diffuse;
+    textures.insert(textures.end(), _textures_specular.begin(),
+                    _textures_specular.end());
+    std::for_each(std::execution::par, textures.begin(), textures.end(),
+                  [](Texture &texture) { texture.prepare(); });
+    std::cout << "textures loaded: " << textures.size() << "\n";
   }
 
   for (size_t s = 0; s < shapes.size(); s++) {
@@ -429,57 +689,97 @@ void Mesh::read_from_obj(std::string folder, std::string file) {
 
   _origin = _bounding_box.get_middle();
   _transform.add_translation(_origin);
-}
 
-void Mesh::update_stats(bvh_stats bvh_stats) {
-  _stats.intersects += 1;
-  _stats.node_intersects += bvh_stats.node_intersects;
-  _stats.triangle_intersects += bvh_stats.triangle_intersects;
-  _stats.intersection_time_all += bvh_stats.intersection_time;
+  _triangle_memory.set(get_vector_bytes(_triangles));
+#if PRINT_MEMORY
+  MemoryStats::get_instance().print("load");
+#endif
+}
 
-  // update min max values
-  if (bvh_stats.node_intersects < _stats.min_node_intersects) {
-    _stats.min_node_intersects = bvh_stats.node_intersects;
-  }
-  if (bvh_stats.node_intersects > _stats.max_node_intersects) {
-    _stats.max_node_intersects = bvh_stats.node_intersects;
-  }
-  if (bvh_stats.triangle_intersects < _stats.min_triangle_intersects) {
-    _stats.min_triangle_intersects = bvh_stats.triangle_intersects;
-  }
-  if (bvh_stats.triangle_intersects > _stats.max_triangle_intersects) {
-    _stats.max_triangle_intersects = bvh_stats.triangle_intersects;
+/**
+ * @brief Add a texture unless the same file was already added.
+ *
+ * @param textures textures of the mesh.
+ * @param ids maps file path to index in textures.
+ * @param path path to the image file.
+ * @return int id of the texture.
+ */
+int Mesh::add_texture(std::vector<Texture> *textures,
+                      std::unordered_map<std::string, int> *ids,
+                      std::string path) {
+  auto it = ids->find(path);
+  if (it != ids->end()) {
+    return it->second;
   }
+  textures->push_back(Texture(path));
+  (*ids)[path] = textures->size() - 1;
+  return textures->size() - 1;
 }
 
 void Mesh::print_stats() {
+  mesh_stats stats = get_stats();
+  traversal_counters counters =
+      TraversalStats::get_instance().merge(_stats_id);
+
   std::cout << "------------------------------------------------\n";
   std::cout << "Mesh stats: \n";
   std::cout << "BVH Nodes intersected: \n";
-  std::cout << "\t all: \t" << _stats.node_intersects << "\n";
-  std::cout << "\t min: \t" << _stats.min_node_intersects << "\n";
-  std::cout << "\t max: \t" << _stats.max_node_intersects << "\n";
-  if (_stats.intersects != 0) {
+  std::cout << "\t all: \t" << stats.node_intersects << "\n";
+  std::cout << "\t min: \t" << stats.min_node_intersects << "\n";
+  std::cout << "\t max: \t" << stats.max_node_intersects << "\n";
+  if (stats.intersects != 0) {
     std::cout << "\t avg: \t"
-              << static_cast<float>(_stats.node_intersects) / _stats.intersects
+              << static_cast<float>(stats.node_intersects) / stats.intersects
               << "\n";
   }
+  print_histogram(counters.histogram_nodes);
   std::cout << "BVH triangles intersected: \n";
-  std::cout << "\t all: \t" << _stats.triangle_intersects << "\n";
-  std::cout << "\t min: \t" << _stats.min_triangle_intersects << "\n";
-  std::cout << "\t max: \t" << _stats.max_triangle_intersects << "\n";
-  if (_stats.intersects != 0) {
+  std::cout << "\t all: \t" << stats.triangle_intersects << "\n";
+  std::cout << "\t min: \t" << stats.min_triangle_intersects << "\n";
+  std::cout << "\t max: \t" << stats.max_triangle_intersects << "\n";
+  if (stats.intersects != 0) {
     std::cout << "\t avg: \t"
-              << static_cast<float>(_stats.triangle_intersects) /
-                     _stats.intersects
+              << static_cast<float>(stats.triangle_intersects) /
+                     stats.intersects
               << "\n";
   }
-  std::cout << "Intersection time: \n";
-  std::cout << "\t all: \t" << _stats.intersection_time_all << "\n";
-  std::cout << "\t avg: \t" << _stats.intersection_time_all / _stats.intersects
-            << "\n";
+  print_histogram(counters.histogram_triangles);
+  std::cout << "Intersection time (estimated from " << counters.timed_rays
+            << " timed rays): \n";
+  std::cout << "\t all: \t" << stats.intersection_time_all << "\n";
+  if (stats.intersects != 0) {
+    std::cout << "\t avg: \t"
+              << stats.intersection_time_all / stats.intersects << "\n";
+  }
   std::cout << "------------------------------------------------\n";
 }
+
+/**
+ * @brief Print the non empty bins of a log2 histogram as percentage.
+ *
+ * @param histogram bin i counts values in [2^(i-1), 2^i).
+ */
+void Mesh::print_histogram(
+    const std::array<uint64_t, STATS_HISTOGRAM_BINS> &histogram) {
+  uint64_t sum = 0;
+  for (uint64_t count : histogram) {
+    sum += count;
+  }
+  if (sum == 0) {
+    return;
+  }
+  std::cout << "\t histogram: \n";
+  for (uint i = 0; i < STATS_HISTOGRAM_BINS; i++) {
+    if (histogram[i] == 0) {
+      continue;
+    }
+    uint64_t low = i == 0 ? 0 : 1ull << (i - 1);
+    uint64_t high = i == 0 ? 0 : (1ull << i) - 1;
+    std::cout << "\t\t" << low << "-" << high << ": \t"
+              << 100.0 * histogram[i] / sum << "%\n";
+  }
+}
+
 void Mesh::print_triangle_stats() {
   vec3 combined_lenght = vec3(0);
   for (Triangle t : _triangles) {
@@ -4,28 +4,39 @@
 
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <iostream>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "box.hpp"
 #include "bvh.hpp"
+#include "memory_stats.hpp"
 #include "object.hpp"
+#include "ray_packet.hpp"
 #include "texture.hpp"
+#include "traversal_stats.hpp"
 #include "triangle.hpp"
 #include "uniform_grid.hpp"
 
-#define VISUALIZE_BVH false
 #define LOAD_TEXTURES true
 
+// load the tuned build parameters stored next to the obj file (or tune and
+// store them) instead of using the algorithm passed to the constructor
+#define AUTOTUNE false
+
 struct mesh_stats {
-  uint intersects = 0;
+  uint64_t intersects = 0;
   uint max_node_intersects = 0;
   uint min_node_intersects = UINT_MAX;
-  uint node_intersects = 0;
+  uint64_t node_intersects = 0;
   uint max_triangle_intersects = 0;
   uint min_triangle_intersects = UINT_MAX;
-  uint triangle_intersects = 0;
+  uint64_t triangle_intersects = 0;
   float time_building = 0;
+  /// @brief estimated from the sampled traversal times.
   float intersection_time_all = 0;
 };
 
@@ -33,12 +44,17 @@ class Mesh : public Object {
  public:
   Mesh(std::string folder, std::string file, vec3 origin);
   Mesh(std::string folder, std::string file, vec3 origin, Material material,
-       Algorithm algorithm = ASAH);
+       mesh_build build = ASAH);
   Mesh(std::string folder, std::string file, vec3 origin, Material material,
-       std::string texture_path, Algorithm algorithm = ASAH);
+       std::string texture_path, mesh_build build = ASAH);
+  /// @brief mesh of generated triangles (all using material).
+  Mesh(std::vector<Triangle> triangles, Material material,
+       mesh_build build = ASAH);
 
   Mesh(const Mesh& old_mesh);
   Mesh& operator=(const Mesh& old_mesh);
+  Mesh(Mesh&& old_mesh) noexcept;
+  Mesh& operator=(Mesh&& old_mesh) noexcept;
 
   /***** Print Debug information *****/
   void print_triangles(void);
@@ -50,19 +66,51 @@ class Mesh : public Object {
 
   void apply_transform(mat4 transformation) override;
 
+  /***** Acceleration structure *****/
+
+  /// @brief rebuild the acceleration structure with another algorithm.
+  void set_algorithm(Algorithm algorithm);
+  void set_build_parameters(const build_parameters& parameters);
+  build_parameters get_build_parameters();
+
+  /// @brief build with the parameters from the tuning file of the obj file.
+  void autotune();
+  std::string get_tuning_path();
+
+  /// @brief quality report of the BVH (throws for the uniform grid).
+  bvh_report get_bvh_report(bvh_report_settings settings);
+
   /***** getters *****/
   int get_size(void);
   Triangle get_triangle(int i);
 
   /***** Functions *****/
   Intersection intersect(const Ray& ray) override;
+  /// @brief closest triangle hit of the acceleration structure (no material),
+  /// entry_node is the result of get_entry_node for rays inside its frustum.
+  TriangleIntersection intersect_triangles(const Ray& ray,
+                                           uint entry_node = 0);
+  /// @brief intersect_triangles of every active lane (BVH packet traversal,
+  /// single rays for the grid).
+  void intersect_packet(const ray_packet& packet, TriangleIntersection* hits,
+                        uint entry_node = 0);
+  /// @brief shadow test of the active lanes that are not occluded yet (any
+  /// hit closer than t_max, see BVH::occluded_packet).
+  void occluded_packet(const ray_packet& packet, const float* t_max,
+                       uint8_t* occluded);
+  /// @brief BVH node to start the rays inside of the frustum at (the root
+  /// for the grid).
+  uint get_entry_node(const frustum& f);
   Intersection get_intersect(const TriangleIntersection triangle_intersect);
 
   void print_stats();
+  void print_histogram(
+      const std::array<uint64_t, STATS_HISTOGRAM_BINS>& histogram);
   void print_triangle_stats();
 
  private:
   std::vector<Triangle> _triangles;
+  MemoryAccount _triangle_memory{MEM_TRIANGLES};
   bool _triangle_exists;
   int _size;
   vec3 _origin;
@@ -79,20 +127,24 @@ class Mesh : public Object {
   std::vector<Texture> _textures_normal;
 
   std::string _path_folder;
+  std::string _path_file;
 
   Texture _texture;
   bool _enable_texture = false;
 
   mesh_stats _stats;
-
-  /// @brief updates the intersection stats
-  void update_stats(bvh_stats bvh_stats);
+  /// @brief id of the traversal counters of this mesh in TraversalStats.
+  uint _stats_id = TraversalStats::get_instance().add_counters();
 
   void build_datastructure();
+  /// @brief first build of the constructors.
+  void build_datastructure(const mesh_build &build);
 
   // define data structure to use
-  Algorithm _used_algorithm = ASAH;
+  build_parameters _build_parameters;
 
   void update_bounding_box(Triangle* t);
   void read_from_obj(std::string folder, std::string file);
+  int add_texture(std::vector<Texture>* textures,
+                  std::unordered_map<std::string, int>* ids, std::string path);
 };
@@ -8,6 +8,8 @@
 #include <cstdint>
 #include <execution>
 
+#include "timeline.hpp"
+
 Morton::Morton(std::vector<Triangle> *triangles, uint grid_bits) {
   _triangles = triangles;
   _grid_bits = grid_bits;
@@ -34,6 +36,7 @@ bool comp(std::vector<uint64_t> *morton_codes, uint id1, uint id2) {
 }
 
 void Morton::sort(std::vector<uint> *triangle_ids) {
+  TIMELINE_ZONE("morton sort");
   namespace boo = boost::lambda;
 
   // BVH_node_data *data = _tree->get_data(_tree->get_root());
@@ -47,6 +50,7 @@ void Morton::sort(std::vector<uint> *triangle_ids) {
 
 void Morton::generate_morton_codes(std::vector<uint> *triangle_ids,
                                    const bvh_box &bounds) {
+  TIMELINE_ZONE("morton codes");
   for (size_t i = 0; i < triangle_ids->size(); i++) {
     Triangle *t = _triangles->data() + i;
     // get normalized triangle position dependent on bounding box
@@ -57,6 +61,7 @@ void Morton::generate_morton_codes(std::vector<uint> *triangle_ids,
     // save respective morten code trianlge with id i -> morton code at index i
     _morton_codes.push_back(get_morton_value(pos_normalized));
   }
+  _morton_memory.set(get_vector_bytes(_morton_codes));
 }
 void Morton::build(std::vector<uint> *triangle_ids, const bvh_box &bounds) {
   std::chrono::steady_clock::time_point begin =
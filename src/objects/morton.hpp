@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "bvh_tree.hpp"
+#include "memory_stats.hpp"
 #include "triangle.hpp"
 
 using glm::vec3;
@@ -31,6 +32,22 @@ class Morton {
   /// @param index should only contain integer values
   uint64_t get_value(vec3 index);
 
+  /**
+   * @brief return morton value for a given vector.
+   *
+   * @param v input vector. with values between 0,1
+   */
+  uint64_t get_morton_value(vec3 v);
+
+  /**
+   * @brief seperate bits such that there are 2 zeros between every data bit.
+   *
+   * @param i Input value: can have at maximum 21 data bits such that the result
+   * does not overflow. If input has more bits they are not taken into account.
+   * @return
+   */
+  uint64_t split3(uint32_t i);
+
  private:
   /**
    * @brief Sort the triangles according to their position (morton codes)
@@ -43,13 +60,6 @@ class Morton {
   void generate_morton_codes(std::vector<uint> *triangle_ids,
                              const bvh_box &bounds);
 
-  /**
-   * @brief return morton value for a given vector.
-   *
-   * @param v input vector. with values between 0,1
-   */
-  uint64_t get_morton_value(vec3 v);
-
   /**
    * @brief Convert float to an integer number considering decimal places.
    *
@@ -57,16 +67,8 @@ class Morton {
    */
   uint32_t float_to_int(float f);
 
-  /**
-   * @brief seperate bits such that there are 2 zeros between every data bit.
-   *
-   * @param i Input value: can have at maximum 21 data bits such that the result
-   * does not overflow. If input has more bits they are not taken into account.
-   * @return
-   */
-  uint64_t split3(uint32_t i);
-
   std::vector<uint64_t> _morton_codes;
+  MemoryAccount _morton_memory{MEM_BVH_BUILD};
   std::vector<Triangle> *_triangles;
 
   // GRID_SIZE|#grid cells
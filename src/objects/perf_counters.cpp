@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+#include "perf_counters.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef __linux__
+struct perf_event_config {
+  uint32_t type;
+  uint64_t config;
+};
+
+// same order as PerfEvent
+const perf_event_config perf_event_configs[PERF_EVENT_COUNT] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                             (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL |
+                             (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}};
+
+int open_event(PerfEvent event, int group) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = perf_event_configs[event].type;
+  attr.config = perf_event_configs[event].config;
+  attr.read_format = PERF_FORMAT_GROUP;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  // calling thread on any cpu
+  return syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+#endif
+
+}  // namespace
+
+// ----------------------------------------------------------------------------
+// perf_values
+
+void perf_values::merge(const perf_values &other) {
+  for (uint e = 0; e < PERF_EVENT_COUNT; e++) {
+    counts[e] += other.counts[e];
+    available[e] = available[e] || other.available[e];
+  }
+  calls += other.calls;
+}
+
+double perf_values::get_ipc() const {
+  if (!available[PERF_CYCLES] || !available[PERF_INSTRUCTIONS] ||
+      counts[PERF_CYCLES] == 0) {
+    return 0;
+  }
+  return static_cast<double>(counts[PERF_INSTRUCTIONS]) / counts[PERF_CYCLES];
+}
+
+// ----------------------------------------------------------------------------
+// PerfCounters
+
+PerfCounters &PerfCounters::get_instance() {
+  static PerfCounters instance;
+  return instance;
+}
+
+void PerfCounters::enable() { _enabled.store(true, std::memory_order_relaxed); }
+
+void PerfCounters::disable() {
+  _enabled.store(false, std::memory_order_relaxed);
+}
+
+bool PerfCounters::is_enabled() {
+  return _enabled.load(std::memory_order_relaxed);
+}
+
+void PerfCounters::begin(PerfPhase phase) {
+  thread_block *block = get_thread_block();
+  update(block);
+  block->stack.push_back(phase);
+  block->phases[phase].calls++;
+}
+
+void PerfCounters::end() {
+  thread_block *block = get_thread_block();
+  if (block->stack.empty()) {
+    return;
+  }
+  update(block);
+  block->stack.pop_back();
+}
+
+perf_report PerfCounters::get_report() {
+  perf_report report;
+  _blocks.for_each([&report](const thread_block &block, uint thread_id) {
+    if (block.open_events == 0) {
+      return;
+    }
+    report.available = true;
+    report.threads.insert(report.threads.begin(), {thread_id, block.phases});
+    for (uint p = 0; p < PERF_PHASE_COUNT; p++) {
+      report.phases[p].merge(block.phases[p]);
+    }
+  });
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  report.error = _error;
+  return report;
+}
+
+void PerfCounters::clear() {
+  _blocks.for_each([](thread_block &block, uint) {
+    for (perf_values &values : block.phases) {
+      values.counts = {};
+      values.calls = 0;
+    }
+  });
+}
+
+std::string PerfCounters::get_name(PerfPhase phase) {
+  switch (phase) {
+    case PERF_BUILD:
+      return "build";
+    case PERF_PRIMARY:
+      return "primary_rays";
+    case PERF_SHADOW:
+      return "shadow_rays";
+    case PERF_SHADING:
+      return "shading";
+  }
+  return "unknown";
+}
+
+std::string PerfCounters::get_name(PerfEvent event) {
+  switch (event) {
+    case PERF_CYCLES:
+      return "cycles";
+    case PERF_INSTRUCTIONS:
+      return "instructions";
+    case PERF_L1D_MISSES:
+      return "l1d_misses";
+    case PERF_LLC_MISSES:
+      return "llc_misses";
+    case PERF_BRANCH_MISSES:
+      return "branch_misses";
+  }
+  return "unknown";
+}
+
+PerfCounters::thread_block *PerfCounters::get_thread_block() {
+  // the counters stay open as long as the block lives
+  return _blocks.get_local(
+      [this](thread_block *block) { open_events(block); });
+}
+
+/**
+ * @brief Open the events as one group, so they are read at once and
+ * scheduled together. Events which fail to open are left out of the group.
+ */
+void PerfCounters::open_events(thread_block *block) {
+  block->fds.fill(-1);
+  block->slots.fill(-1);
+  std::string error = "";
+
+#ifdef __linux__
+  for (uint e = 0; e < PERF_EVENT_COUNT; e++) {
+    PerfEvent event = static_cast<PerfEvent>(e);
+    int fd = open_event(event, block->leader);
+    if (fd < 0) {
+      error += (error.empty() ? "" : ", ") + get_name(event) + ": " +
+               std::strerror(errno);
+      continue;
+    }
+    if (block->leader < 0) {
+      block->leader = fd;
+    }
+    block->fds[e] = fd;
+    block->slots[e] = block->open_events++;
+    for (perf_values &values : block->phases) {
+      values.available[e] = true;
+    }
+  }
+  if (block->open_events > 0) {
+    read_events(block, &block->last);
+  }
+#else
+  error = "perf_event_open is only available on linux";
+#endif
+
+  if (!error.empty()) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_error.empty()) {
+      _error = error;
+      std::cout << "perf counters not available (" << error << ")\n";
+    }
+  }
+}
+
+bool PerfCounters::read_events(thread_block *block,
+                               std::array<uint64_t, PERF_EVENT_COUNT> *values) {
+#ifdef __linux__
+  // PERF_FORMAT_GROUP: number of events followed by the values
+  uint64_t buffer[PERF_EVENT_COUNT + 1];
+  ssize_t size = read(block->leader, buffer, sizeof(buffer));
+  if (size < static_cast<ssize_t>(sizeof(uint64_t)) ||
+      buffer[0] != block->open_events) {
+    return false;
+  }
+  for (uint e = 0; e < PERF_EVENT_COUNT; e++) {
+    (*values)[e] = block->slots[e] < 0 ? 0 : buffer[block->slots[e] + 1];
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+void PerfCounters::update(thread_block *block) {
+  std::array<uint64_t, PERF_EVENT_COUNT> current;
+  if (block->open_events == 0 || !read_events(block, &current)) {
+    return;
+  }
+  if (!block->stack.empty()) {
+    perf_values &values = block->phases[block->stack.back()];
+    for (uint e = 0; e < PERF_EVENT_COUNT; e++) {
+      values.counts[e] += current[e] - block->last[e];
+    }
+  }
+  block->last = current;
+}
+
+// ----------------------------------------------------------------------------
+// PerfScope
+
+PerfScope::PerfScope(PerfPhase phase) {
+  PerfCounters &counters = PerfCounters::get_instance();
+  _active = counters.is_enabled();
+  if (_active) {
+    counters.begin(phase);
+  }
+}
+
+PerfScope::~PerfScope() {
+  if (_active) {
+    PerfCounters::get_instance().end();
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+namespace {
+
+void write_phases_json(
+    std::ostream *out,
+    const std::array<perf_values, PERF_PHASE_COUNT> &phases,
+    std::string indent) {
+  *out << "{\n";
+  for (uint p = 0; p < PERF_PHASE_COUNT; p++) {
+    const perf_values &values = phases[p];
+    *out << indent << "  \""
+         << PerfCounters::get_name(static_cast<PerfPhase>(p))
+         << "\": {\"calls\": " << values.calls;
+    for (uint e = 0; e < PERF_EVENT_COUNT; e++) {
+      *out << ", \"" << PerfCounters::get_name(static_cast<PerfEvent>(e))
+           << "\": ";
+      if (values.available[e]) {
+        *out << values.counts[e];
+      } else {
+        *out << "null";
+      }
+    }
+    *out << ", \"ipc\": " << values.get_ipc() << "}"
+         << (p + 1 < PERF_PHASE_COUNT ? "," : "") << "\n";
+  }
+  *out << indent << "}";
+}
+
+}  // namespace
+
+void write_perf_json(std::ostream *out, const perf_report &report,
+                     std::string indent) {
+  *out << "{\n"
+       << indent << "  \"available\": "
+       << (report.available ? "true" : "false") << ",\n"
+       << indent << "  \"error\": \"" << report.error << "\"";
+  if (!report.available) {
+    *out << "\n" << indent << "}";
+    return;
+  }
+
+  // phases are counted per thread, only the tasks which open the phase
+  // themselves count on the worker threads
+  *out << ",\n"
+       << indent
+       << "  \"build_coverage\": \"building thread and hlbvh treelet tasks, "
+          "not the workers of the parallel morton sort\"";
+  *out << ",\n" << indent << "  \"phases\": ";
+  write_phases_json(out, report.phases, indent + "  ");
+  *out << ",\n" << indent << "  \"threads\": [";
+  for (size_t t = 0; t < report.threads.size(); t++) {
+    *out << (t == 0 ? "\n" : ",\n") << indent << "    {\"thread\": "
+         << report.threads[t].thread_id << ", \"phases\": ";
+    write_phases_json(out, report.threads[t].phases, indent + "    ");
+    *out << "}";
+  }
+  *out << "\n" << indent << "  ]\n" << indent << "}";
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "thread_block_list.hpp"
+
+// compile the phase scopes in, counters are only read after enable()
+#define PERF_COUNTERS true
+
+enum PerfPhase {
+  PERF_BUILD,
+  /// @brief closest hit traversal of camera and reflection rays.
+  PERF_PRIMARY,
+  PERF_SHADOW,
+  /// @brief light calculation without the rays it traces.
+  PERF_SHADING
+};
+
+#define PERF_PHASE_COUNT 4
+
+enum PerfEvent {
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_L1D_MISSES,
+  PERF_LLC_MISSES,
+  PERF_BRANCH_MISSES
+};
+
+#define PERF_EVENT_COUNT 5
+
+/// @brief counter values of one phase (per thread or merged).
+struct perf_values {
+  std::array<uint64_t, PERF_EVENT_COUNT> counts{};
+  /// @brief false for events the cpu or kernel does not provide.
+  std::array<bool, PERF_EVENT_COUNT> available{};
+  /// @brief number of times the phase was entered.
+  uint64_t calls = 0;
+
+  void merge(const perf_values& other);
+  double get_ipc() const;
+};
+
+struct perf_thread {
+  uint thread_id;
+  std::array<perf_values, PERF_PHASE_COUNT> phases;
+};
+
+struct perf_report {
+  bool available = false;
+  /// @brief why the counters are not (or only partly) available.
+  std::string error = "";
+  std::array<perf_values, PERF_PHASE_COUNT> phases;
+  /// @brief threads which entered a phase, in the order they did.
+  std::vector<perf_thread> threads;
+};
+
+/**
+ * @brief Hardware counters (perf_event_open) per pipeline phase and thread.
+ *
+ * Every thread opens its own counter group on the first phase it enters and
+ * keeps a stack of the open phases, so nested phases are counted exclusively
+ * (shading does not contain the shadow rays it traces). The blocks are kept
+ * in a thread_block_list like the ones of TraversalStats.
+ *
+ * A phase only counts on threads which entered it, so parallel work has to
+ * open the phase inside its tasks (e.g. the hlbvh treelets). Work of the
+ * parallel standard algorithms (the morton sort) is not counted.
+ *
+ * Counters are read with one syscall at every phase change, which costs
+ * about a microsecond. Only user space is counted, so the syscalls
+ * themselves are left out. If the kernel does not allow perf events
+ * (perf_event_paranoid, containers, non linux) or an event is not supported,
+ * the report marks it as unavailable instead of failing.
+ */
+class PerfCounters {
+ public:
+  static PerfCounters& get_instance();
+
+  void enable();
+  void disable();
+  bool is_enabled();
+
+  /// @brief enter phase on the calling thread.
+  void begin(PerfPhase phase);
+  /// @brief leave the phase entered last on the calling thread.
+  void end();
+
+  /// @brief sums up the phases of all threads (call while no phase is open).
+  perf_report get_report();
+  /// @brief zeroes the counters of all threads.
+  void clear();
+
+  static std::string get_name(PerfPhase phase);
+  static std::string get_name(PerfEvent event);
+
+ private:
+  PerfCounters() {}
+
+  struct thread_block {
+    /// @brief group leader and the file descriptor of every event (or -1).
+    int leader = -1;
+    std::array<int, PERF_EVENT_COUNT> fds;
+    /// @brief position of the event in the group read (or -1).
+    std::array<int, PERF_EVENT_COUNT> slots;
+    uint open_events = 0;
+
+    std::vector<PerfPhase> stack;
+    std::array<uint64_t, PERF_EVENT_COUNT> last{};
+    std::array<perf_values, PERF_PHASE_COUNT> phases;
+  };
+
+  thread_block* get_thread_block();
+  void open_events(thread_block* block);
+  bool read_events(thread_block* block,
+                   std::array<uint64_t, PERF_EVENT_COUNT>* values);
+  /// @brief add the counts since the last read to the phase on top.
+  void update(thread_block* block);
+
+  std::atomic<bool> _enabled{false};
+  thread_block_list<thread_block> _blocks;
+  /// @brief guards _error, which is set by the first thread failing to open.
+  std::mutex _mutex;
+  std::string _error = "";
+};
+
+/// @brief counts the enclosing scope as phase.
+class PerfScope {
+ public:
+  explicit PerfScope(PerfPhase phase);
+  ~PerfScope();
+
+  PerfScope(const PerfScope&) = delete;
+  PerfScope& operator=(const PerfScope&) = delete;
+
+ private:
+  bool _active;
+};
+
+/// @brief writes the report as json object (for the bench output).
+void write_perf_json(std::ostream* out, const perf_report& report,
+                     std::string indent);
+
+#if PERF_COUNTERS
+#define PERF_SCOPE(phase) PerfScope SCOPE_CONCAT(perf_scope_, __LINE__)(phase)
+#else
+#define PERF_SCOPE(phase)
+#endif
@@ -13,6 +13,13 @@ Ray::Ray(vec3 origin, vec3 direction) {
   Ray::_direction = glm::normalize(direction);
 }
 
+Ray Ray::from_normalized(vec3 origin, vec3 direction) {
+  Ray ray;
+  ray._origin = origin;
+  ray._direction = direction;
+  return ray;
+}
+
 // getter
 vec3 Ray::get_origin() const { return _origin; }
 vec3 Ray::get_direction() const { return _direction; }
@@ -12,6 +12,9 @@ using glm::vec3;
 class Ray {
  public:
   Ray(vec3 origin, vec3 direction);
+  /// @brief ray with an already normalized direction (kept bit exact, e.g.
+  /// for rays stored in batches).
+  static Ray from_normalized(vec3 origin, vec3 direction);
   // getter
   vec3 get_origin() const;
   vec3 get_direction() const;
@@ -22,6 +25,8 @@ class Ray {
   void print(void);
 
  private:
+  Ray() {}
+
   vec3 _origin;
   vec3 _direction;
 };
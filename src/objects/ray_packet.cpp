@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+#include "ray_packet.hpp"
+
+void ray_packet::set(uint lane, const Ray &ray) {
+  vec3 o = ray.get_origin();
+  vec3 d = ray.get_direction();
+  for (int a = 0; a < 3; a++) {
+    origin[a][lane] = o[a];
+    direction[a][lane] = d[a];
+  }
+  active[lane] = 1;
+}
+
+Ray ray_packet::get_ray(uint lane) const {
+  return Ray::from_normalized(
+      vec3(origin[0][lane], origin[1][lane], origin[2][lane]),
+      vec3(direction[0][lane], direction[1][lane], direction[2][lane]));
+}
+
+uint ray_packet::get_active_count() const {
+  uint count = 0;
+  for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+    count += active[lane];
+  }
+  return count;
+}
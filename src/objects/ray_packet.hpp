@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "ray.hpp"
+
+using glm::vec3;
+
+// pixels per side of the block of camera rays in one packet
+#define RAY_PACKET_WIDTH 4
+#define RAY_PACKET_SIZE (RAY_PACKET_WIDTH * RAY_PACKET_WIDTH)
+
+// a packet that hits less nodes than this continues as single rays
+#define RAY_PACKET_MIN_RAYS 4
+
+/**
+ * @brief Coherent rays (e.g. the camera rays of a block of pixels) in
+ * structure of arrays layout, so a node test runs over all lanes at once.
+ *
+ * Lane (x, y) of the block is at y * RAY_PACKET_WIDTH + x. Lanes outside of
+ * the image are inactive.
+ */
+struct ray_packet {
+  alignas(64) float origin[3][RAY_PACKET_SIZE];
+  alignas(64) float direction[3][RAY_PACKET_SIZE];
+  uint8_t active[RAY_PACKET_SIZE] = {};
+
+  void set(uint lane, const Ray &ray);
+  Ray get_ray(uint lane) const;
+  uint get_active_count() const;
+};
@@ -9,10 +9,19 @@
 #include <chrono>
 #include <cmath>
 
+#include "build_parameters.hpp"
 #include "bvh_tree.hpp"
 #include "lbvh.hpp"
-
-SAH::SAH(BVH_tree *tree) { _tree = tree; }
+#include "timeline.hpp"
+
+SAH::SAH(BVH_tree *tree, const build_parameters &parameters) {
+  _tree = tree;
+  _max_triangles = std::max(parameters.leaf_size, 1u);
+  _num_buckets = std::clamp(parameters.sah_buckets, 2u,
+                            static_cast<uint>(SAH_MAX_BUCKETS));
+  _cost_traversal = parameters.cost_traversal;
+  _cost_intersect = parameters.cost_intersect;
+}
 
 // ---------------------------------------------------------------------------------
 // ----- sorting -----
@@ -50,10 +59,10 @@ void SAH::sort_treelets(std::vector<uint>::iterator begin, const uint &count,
 
 // -----------------------------------------------------------------------------
 
-vec3 calc_bucket_step(vec3 min, vec3 max) {
+vec3 calc_bucket_step(vec3 min, vec3 max, uint num_buckets) {
   vec3 res;
   for (size_t a = 0; a < 3; a++) {
-    res[a] = (max[a] - min[a]) / SAH_NUM_BUCKETS;
+    res[a] = (max[a] - min[a]) / num_buckets;
   }
   return res;
 }
@@ -116,7 +125,7 @@ void SAH::triangles_into_buckets(bvh_node_pointer *node, SAH_buckets *buckets) {
     for (size_t a = 0; a < 3; a++) {
       uint b_id = 0;
       if (len[a] > 0.00001) {  // values smaller are equal to zero
-        b_id = length_to_pos[a] / len[a] * (SAH_NUM_BUCKETS - 1);
+        b_id = length_to_pos[a] / len[a] * (_num_buckets - 1);
       }
       buckets->buckets[a][b_id].ids.emplace_back(i);
       // update bounds
@@ -143,7 +152,7 @@ uint SAH::triangles_into_buckets_axis(bvh_node_pointer *node,
 
     uint b_id = 0;
     if (len[a] > 0.00001) {  // values smaller are equal to zero
-      b_id = length_to_pos[a] / len[a] * (SAH_NUM_BUCKETS - 1);
+      b_id = length_to_pos[a] / len[a] * (_num_buckets - 1);
     }
     buckets->buckets[0][b_id].ids.emplace_back(i);
     buckets->buckets[0][b_id].box = union_box(
@@ -170,7 +179,7 @@ void SAH::treelets_into_buckets(bvh_node_pointer *node, SAH_buckets *buckets) {
     for (size_t a = 0; a < 3; a++) {
       uint b_id = 0;
       if (len[a] > 0.00001) {
-        b_id = (length_to_pos[a] / len[a]) * (SAH_NUM_BUCKETS - 1);
+        b_id = (length_to_pos[a] / len[a]) * (_num_buckets - 1);
       }
       buckets->buckets[a][b_id].ids.emplace_back(id);
       // update bounds
@@ -196,7 +205,7 @@ uint SAH::treelets_into_buckets_axis(bvh_node_pointer *node,
 
     uint b_id = 0;
     if (len[a] > 0.00001) {
-      b_id = (length_to_pos[a] / len[a]) * (SAH_NUM_BUCKETS - 1);
+      b_id = (length_to_pos[a] / len[a]) * (_num_buckets - 1);
     }
     buckets->buckets[0][b_id].ids.emplace_back(id);
     // update bounds
@@ -258,7 +267,7 @@ split_point SAH::calc_min_split(bvh_node_pointer *node, SAH_buckets *buckets) {
   //                       _tree->get_data(node)->bounds.max);
   // float surface_box = get_surface_area(box);
   //
-  float cost[3][SAH_NUM_BUCKETS - 1] = {};
+  float cost[3][SAH_MAX_BUCKETS - 1] = {};
   bool block_axis[3] = {false};
 
   for (size_t a = 0; a < 3; a++) {  // for every axis
@@ -269,7 +278,7 @@ split_point SAH::calc_min_split(bvh_node_pointer *node, SAH_buckets *buckets) {
     uint right_amount = 0;
     uint max_amount = 0;
 
-    for (size_t i = 0; i < SAH_NUM_BUCKETS - 1; i++) {
+    for (size_t i = 0; i < _num_buckets - 1; i++) {
       if (buckets->buckets[0][i].ids.size() > max_amount) {
         max_amount = buckets->buckets[0][i].ids.size();
       }
@@ -277,15 +286,15 @@ split_point SAH::calc_min_split(bvh_node_pointer *node, SAH_buckets *buckets) {
       left_amount += buckets->buckets[a][i].ids.size();
       // partially initialize costs
       cost[a][i] +=
-          get_surface_area(left_bounds) * left_amount * COST_INTERSECT;
+          get_surface_area(left_bounds) * left_amount * _cost_intersect;
     }
 
-    for (uint i = SAH_NUM_BUCKETS - 1; i > 0; i--) {
+    for (uint i = _num_buckets - 1; i > 0; i--) {
       right_bounds = union_box(right_bounds, buckets->buckets[a][i].box);
       right_amount += buckets->buckets[a][i].ids.size();
       // add costs of right child
       cost[a][i - 1] +=
-          get_surface_area(right_bounds) * right_amount * COST_INTERSECT;
+          get_surface_area(right_bounds) * right_amount * _cost_intersect;
     }
     // all triangles are in the same bucket
     if (max_amount == left_amount) {
@@ -297,7 +306,7 @@ split_point SAH::calc_min_split(bvh_node_pointer *node, SAH_buckets *buckets) {
   split_point split;
 
   for (size_t a = 0; a < 3; a++) {
-    for (size_t split_id = 0; split_id < SAH_NUM_BUCKETS - 1; split_id++) {
+    for (size_t split_id = 0; split_id < _num_buckets - 1; split_id++) {
       float cost_split = cost[a][split_id];
       if (cost_split < min_cost) {
         min_cost = cost_split;
@@ -311,8 +320,8 @@ split_point SAH::calc_min_split(bvh_node_pointer *node, SAH_buckets *buckets) {
     return split;
   }
   // check if leave is less costly
-  float cost_leave = node->data.triangle_ids.size() * COST_INTERSECT;
-  min_cost = COST_TRAVERSAL + min_cost / get_surface_area(node->data.bounds);
+  float cost_leave = node->data.triangle_ids.size() * _cost_intersect;
+  min_cost = _cost_traversal + min_cost / get_surface_area(node->data.bounds);
   if (cost_leave < min_cost) {
     split.axis = 4;  // Do not further split
   }
@@ -323,7 +332,7 @@ split_point SAH::calc_min_split(bvh_node_pointer *node, SAH_buckets *buckets) {
 split_point SAH::calc_min_split(bvh_node_pointer *node, SAH_buckets *buckets,
                                 uint axis) {
   // go trough all buckets and generate split
-  float cost[SAH_NUM_BUCKETS - 1] = {};
+  float cost[SAH_MAX_BUCKETS - 1] = {};
 
   bvh_box left_bounds;
   bvh_box right_bounds;
@@ -334,22 +343,22 @@ split_point SAH::calc_min_split(bvh_node_pointer *node, SAH_buckets *buckets,
 
   uint max_amount = 0;
 
-  for (size_t i = 0; i < SAH_NUM_BUCKETS - 1; i++) {
+  for (size_t i = 0; i < _num_buckets - 1; i++) {
     left_bounds = union_box(left_bounds, buckets->buckets[0][i].box);
     left_amount += buckets->buckets[0][i].ids.size();
     if (buckets->buckets[0][i].ids.size() > max_amount) {
       max_amount = buckets->buckets[0][i].ids.size();
     }
     // partially initialize costs
-    cost[i] += get_surface_area(left_bounds) * left_amount * COST_INTERSECT;
+    cost[i] += get_surface_area(left_bounds) * left_amount * _cost_intersect;
   }
 
-  for (uint i = SAH_NUM_BUCKETS - 1; i > 0; i--) {
+  for (uint i = _num_buckets - 1; i > 0; i--) {
     right_bounds = union_box(right_bounds, buckets->buckets[0][i].box);
     right_amount += buckets->buckets[0][i].ids.size();
     // add costs of right child
     cost[i - 1] +=
-        get_surface_area(right_bounds) * right_amount * COST_INTERSECT;
+        get_surface_area(right_bounds) * right_amount * _cost_intersect;
   }
   split_point split;
   if (max_amount == left_amount) {  // all triagnles in one bucket
@@ -359,7 +368,7 @@ split_point SAH::calc_min_split(bvh_node_pointer *node, SAH_buckets *buckets,
   // calculate minimum split
   float min_cost = MAXFLOAT;
 
-  for (size_t split_id = 0; split_id < SAH_NUM_BUCKETS - 1; split_id++) {
+  for (size_t split_id = 0; split_id < _num_buckets - 1; split_id++) {
     float cost_split = cost[split_id];
     if (cost_split < min_cost) {
       min_cost = cost_split;
@@ -367,8 +376,8 @@ split_point SAH::calc_min_split(bvh_node_pointer *node, SAH_buckets *buckets,
       split.axis = axis;
     }
   }
-  float cost_leave = node->data.triangle_ids.size() * COST_INTERSECT;
-  min_cost = COST_TRAVERSAL + min_cost / get_surface_area(node->data.bounds);
+  float cost_leave = node->data.triangle_ids.size() * _cost_intersect;
+  min_cost = _cost_traversal + min_cost / get_surface_area(node->data.bounds);
   if (cost_leave < min_cost) {
     split.axis = 4;  // Do not further split
   }
@@ -379,7 +388,7 @@ split_point SAH::calc_min_split_treelets(bvh_node_pointer *node,
                                          SAH_buckets *buckets) {
   // go trough all buckets and generate split
 
-  float cost[3][SAH_NUM_BUCKETS - 1] = {};
+  float cost[3][SAH_MAX_BUCKETS - 1] = {};
   // sort treelets respective to axis
 
   for (size_t a = 0; a < 3; a++) {  // for every axis
@@ -390,22 +399,22 @@ split_point SAH::calc_min_split_treelets(bvh_node_pointer *node,
     uint left_amount = 0;
     uint right_amount = 0;
 
-    for (size_t i = 0; i < SAH_NUM_BUCKETS - 1; i++) {
+    for (size_t i = 0; i < _num_buckets - 1; i++) {
       left_bounds = union_box(left_bounds, buckets->buckets[a][i].box);
       for (uint id : buckets->buckets[a][i].ids) {
         left_amount += _tree->get_treelet(id)->data.triangle_ids.size();
       }
       cost[a][i] +=
-          get_surface_area(left_bounds) * left_amount * COST_INTERSECT;
+          get_surface_area(left_bounds) * left_amount * _cost_intersect;
     }
 
-    for (uint i = SAH_NUM_BUCKETS - 1; i > 0; i--) {
+    for (uint i = _num_buckets - 1; i > 0; i--) {
       right_bounds = union_box(right_bounds, buckets->buckets[a][i].box);
       for (uint id : buckets->buckets[a][i].ids) {
         right_amount += _tree->get_treelet(id)->data.triangle_ids.size();
       }
       cost[a][i - 1] +=
-          get_surface_area(right_bounds) * right_amount * COST_INTERSECT;
+          get_surface_area(right_bounds) * right_amount * _cost_intersect;
     }
   }
 
@@ -416,8 +425,8 @@ split_point SAH::calc_min_split_treelets(bvh_node_pointer *node,
   bool run_trough = true;
 
   for (size_t a = 0; a < 3; a++) {
-    for (size_t split_id = 0; split_id < SAH_NUM_BUCKETS - 1; split_id++) {
-      float cost_split = COST_TRAVERSAL + cost[a][split_id];
+    for (size_t split_id = 0; split_id < _num_buckets - 1; split_id++) {
+      float cost_split = _cost_traversal + cost[a][split_id];
       if (cost_split < min_cost) {
         min_cost = cost_split;
         split.id = split_id;
@@ -445,7 +454,7 @@ split_point SAH::calc_min_split_treelets(bvh_node_pointer *node,
 
   // sort treelets respective to axis
   bool run_trough = true;
-  for (size_t split_id = 0; split_id < SAH_NUM_BUCKETS - 1;
+  for (size_t split_id = 0; split_id < _num_buckets - 1;
        split_id++) {  // for every bucket
     bvh_box left;
     bvh_box right;
@@ -460,7 +469,7 @@ split_point SAH::calc_min_split_treelets(bvh_node_pointer *node,
     }
 
     uint right_amount = 0;
-    for (size_t i = split_id + 1; i < SAH_NUM_BUCKETS; i++) {
+    for (size_t i = split_id + 1; i < _num_buckets; i++) {
       right = union_box(right, buckets->buckets[0][i].box);
       for (uint id : buckets->buckets[0][i].ids) {
         right_amount += _tree->get_treelet(id)->data.triangle_ids.size();
@@ -472,8 +481,8 @@ split_point SAH::calc_min_split_treelets(bvh_node_pointer *node,
     float prob_right = get_surface_area(right);
 
     // calculate costs
-    float cost = COST_TRAVERSAL + prob_left * left_amount * COST_INTERSECT +
-                 prob_right * right_amount * COST_INTERSECT;
+    float cost = _cost_traversal + prob_left * left_amount * _cost_intersect +
+                 prob_right * right_amount * _cost_intersect;
 
     // update min cost
     // gets ignored for costs with -nan
@@ -562,17 +571,17 @@ void SAH::split(bvh_node_pointer *node, const SAH_buckets &buckets,
 #ifdef SPLIT_LONGEST_AXIS
   combine_ids(&data_left.triangle_ids, buckets, 0, 0, splitp.id);
   combine_ids(&data_right.triangle_ids, buckets, 0, splitp.id + 1,
-              SAH_NUM_BUCKETS - 1);
+              _num_buckets - 1);
   data_left.bounds = combine_box(buckets, 0, 0, splitp.id);
   data_right.bounds =
-      combine_box(buckets, 0, splitp.id + 1, SAH_NUM_BUCKETS - 1);
+      combine_box(buckets, 0, splitp.id + 1, _num_buckets - 1);
 #else
   combine_ids(&data_left.triangle_ids, buckets, splitp.axis, 0, splitp.id);
   combine_ids(&data_right.triangle_ids, buckets, splitp.axis, splitp.id + 1,
-              SAH_NUM_BUCKETS - 1);
+              _num_buckets - 1);
   data_left.bounds = combine_box(buckets, splitp.axis, 0, splitp.id);
   data_right.bounds =
-      combine_box(buckets, splitp.axis, splitp.id + 1, SAH_NUM_BUCKETS - 1);
+      combine_box(buckets, splitp.axis, splitp.id + 1, _num_buckets - 1);
 #endif
 
   // TODO(tobi) insert child withou BVH_node_data parameter
@@ -616,6 +625,7 @@ void SAH::split(bvh_node_pointer *node) {
 }
 
 void SAH::built_on_treelets() {
+  TIMELINE_ZONE("sah top level");
   std::chrono::steady_clock::time_point begin =
       std::chrono::steady_clock::now();
   // define new root node
@@ -726,11 +736,11 @@ void SAH::split_treelets(bvh_node_pointer *node) {
 #ifdef SPLIT_LONGEST_AXIS
   combine_ids(&data_left.triangle_ids, buckets, 0, 0, split.id);
   combine_ids(&data_right.triangle_ids, buckets, 0, split.id + 1,
-              SAH_NUM_BUCKETS - 1);
+              _num_buckets - 1);
 #else
   combine_ids(&data_left.triangle_ids, buckets, split.axis, 0, split.id);
   combine_ids(&data_right.triangle_ids, buckets, split.axis, split.id + 1,
-              SAH_NUM_BUCKETS - 1);
+              _num_buckets - 1);
 #endif
 
   bvh_node_pointer *left = _tree->insert_child(data_left, node);
@@ -1,10 +1,13 @@
 /*
  * Copyright (c) 2023 Tobias Vonier. All rights reserved.
  */
+#pragma once
 
 #include "bvh_tree.hpp"
 
+// default number of buckets, at most SAH_MAX_BUCKETS
 #define SAH_NUM_BUCKETS 12
+#define SAH_MAX_BUCKETS 32
 
 // number of triangles at which array gets split in the middle
 #define MIN_SAH_SPLIT 2
@@ -27,12 +30,14 @@ struct SAH_bucket {
 /// @brief Struct containing two-dimensional array of all buckets
 struct SAH_buckets {
 #ifdef SPLIT_LONGEST_AXIS
-  SAH_bucket buckets[1][SAH_NUM_BUCKETS];
+  SAH_bucket buckets[1][SAH_MAX_BUCKETS];
 #else
-  SAH_bucket buckets[3][SAH_NUM_BUCKETS];
+  SAH_bucket buckets[3][SAH_MAX_BUCKETS];
 #endif
 };
 
+struct build_parameters;
+
 struct split_point {
   size_t axis = 3;  // axis > 2 --> no valid split
   size_t id = 0;
@@ -40,7 +45,7 @@ struct split_point {
 
 class SAH {
  public:
-  explicit SAH(BVH_tree *tree);
+  SAH(BVH_tree *tree, const build_parameters &parameters);
 
   void split_middle(bvh_node_pointer *node);
   void split(bvh_node_pointer *node);
@@ -98,5 +103,8 @@ class SAH {
   float get_surface_area(const bvh_box &box);
 
   BVH_tree *_tree;
-  uint _max_triangles = 1;
+  uint _max_triangles = MAX_TRIANGLES;
+  uint _num_buckets = SAH_NUM_BUCKETS;
+  float _cost_traversal = COST_TRAVERSAL;
+  float _cost_intersect = COST_INTERSECT;
 };
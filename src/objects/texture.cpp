@@ -3,35 +3,37 @@
  */
 #include "texture.hpp"
 
+#include <CImg.h>
+
 #include <iostream>
 
+using cimg_library::CImg, cimg_library::CImgDisplay;
+
 Texture::Texture() {}
 
-Texture::Texture(std::string path_to_image) {
-  _texture = CImg<unsigned char>(path_to_image.c_str());
-}
+Texture::Texture(std::string path_to_image) { load_image(path_to_image); }
 
 void Texture::show_image(void) {
-  CImgDisplay main_display(_texture, "Ich bin ein Bild");
+  CImg<unsigned char> image = CImg<unsigned char>(_image->get_path().c_str());
+  CImgDisplay main_display(image, "Ich bin ein Bild");
   while (!main_display.is_closed()) {
     main_display.wait();
   }
 }
 
 void Texture::load_image(std::string path_to_image) {
-  _texture = CImg<unsigned char>(path_to_image.c_str());
+  // decoding is deferred until the first texel is requested
+  _image = TextureRegistry::get_instance().get_image(path_to_image);
 }
 
+void Texture::prepare(void) { _image->prepare(); }
+
 vec3 Texture::get_color_absolute(vec2 position_xy) {
-  vec3 colors =
-      vec3(static_cast<int>(_texture(position_xy.x, position_xy.y, 0, 0)),
-           static_cast<int>(_texture(position_xy.x, position_xy.y, 0, 1)),
-           static_cast<int>(_texture(position_xy.x, position_xy.y, 0, 2)));
-  return colors;
+  return _image->get_texel(0, position_xy.x, position_xy.y);
 }
 
 // only acepts values between 0-1
-vec3 Texture::get_color_uv(vec2 position_uv) {
+vec3 Texture::get_color_uv(vec2 position_uv, float lod) {
   position_uv = glm::abs(position_uv - vec2(static_cast<int>(position_uv.x),
                                             static_cast<int>(position_uv.y)));
 
@@ -39,12 +41,41 @@ vec3 Texture::get_color_uv(vec2 position_uv) {
 #ifdef FLIP_HORIZONTAL
   position_uv.y = 1 - position_uv.y;
 #endif
-  position_uv.x = static_cast<int>(position_uv.x * _texture.width());
-  position_uv.y = static_cast<int>(position_uv.y * _texture.height());
-  vec3 colors = get_color_absolute(position_uv);
+  lod = glm::clamp(lod, 0.f, static_cast<float>(_image->get_num_levels() - 1));
+  uint level = lod;
+  float blend = lod - level;
+
+  vec3 colors = get_color_level(position_uv, level);
+  if (blend > 0) {
+    colors = glm::mix(colors, get_color_level(position_uv, level + 1), blend);
+  }
   colors *= 1.f / 255;
   return colors;
 }
+
+vec3 Texture::get_color_level(vec2 position_uv, uint level) {
+  vec2 size = _image->get_dimensions(level);
+  int width = size.x;
+  int height = size.y;
+
+  // texel centers are at (i + 0.5) / size
+  vec2 pos = position_uv * size - vec2(0.5);
+  vec2 pos_floor = glm::floor(pos);
+  vec2 weight = pos - pos_floor;
+
+  // wrap around the borders
+  int x0 = (static_cast<int>(pos_floor.x) % width + width) % width;
+  int y0 = (static_cast<int>(pos_floor.y) % height + height) % height;
+  int x1 = (x0 + 1) % width;
+  int y1 = (y0 + 1) % height;
+
+  vec3 top = glm::mix(_image->get_texel(level, x0, y0),
+                      _image->get_texel(level, x1, y0), weight.x);
+  vec3 bottom = glm::mix(_image->get_texel(level, x0, y1),
+                         _image->get_texel(level, x1, y1), weight.x);
+  return glm::mix(top, bottom, weight.y);
+}
+
 vec3 Texture::get_normal_uv(vec2 position_uv) {
   if (position_uv.x > 1) {
     position_uv.x = 0.99;
@@ -62,17 +93,13 @@ vec3 Texture::get_normal_uv(vec2 position_uv) {
 #ifdef FLIP_HORIZONTAL
   position_uv.y = 1 - position_uv.y;
 #endif
-  position_uv.x = static_cast<int>(position_uv.x * _texture.width());
-  position_uv.y = static_cast<int>(position_uv.y * _texture.height());
-  vec3 colors =
-      vec3(static_cast<int>(_texture(position_uv.x, position_uv.y, 0, 0)),
-           static_cast<int>(_texture(position_uv.x, position_uv.y, 0, 1)),
-           static_cast<int>(_texture(position_uv.x, position_uv.y, 0, 2)));
+  vec2 size = get_dimensions();
+  position_uv.x = static_cast<int>(position_uv.x * (size.x - 1));
+  position_uv.y = static_cast<int>(position_uv.y * (size.y - 1));
+  vec3 colors = get_color_absolute(position_uv);
   colors *= 1.f / 255;
   vec3 normal = colors * vec3(2) - vec3(1);
   return normal;
 }
 
-vec2 Texture::get_dimensions() {
-  return vec2(_texture.width(), _texture.height());
-}
+vec2 Texture::get_dimensions() { return _image->get_dimensions(0); }
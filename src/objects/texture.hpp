@@ -5,17 +5,23 @@
 #pragma once
 
 #define GLM_ENABLE_EXPERIMENTAL
-#include <CImg.h>
 
+#include <memory>
 #include <string>
 
+#include "texture_cache.hpp"
+
 #define FLIP_HORIZONTAL
 #include "glm/glm.hpp"
 
 using glm::vec2, glm::vec3;
 
-using cimg_library::CImg, cimg_library::CImgDisplay;
-
+/**
+ * @brief Texture sampled from tiled, mip-mapped storage.
+ *
+ * The image file is only decoded once a texel is requested. All textures
+ * using the same file share the image data.
+ */
 class Texture {
  public:
   Texture();
@@ -25,7 +31,17 @@ class Texture {
 
   void load_image(std::string path_to_image);
 
-  vec3 get_color_uv(vec2 position_uv);
+  /// @brief decode the image now instead of on the first texel access.
+  void prepare(void);
+
+  /**
+   * @brief Bilinear filtered color at the given texture coordinates.
+   *
+   * @param position_uv coordinates get wrapped into [0, 1].
+   * @param lod mip level to sample, fractions blend between two levels.
+   * @return vec3 color with values between 0-1.
+   */
+  vec3 get_color_uv(vec2 position_uv, float lod = 0);
   vec3 get_color_absolute(vec2 position);
 
   vec3 get_normal_uv(vec2 position_uv);
@@ -33,5 +49,7 @@ class Texture {
   vec2 get_dimensions();
 
  private:
-  CImg<unsigned char> _texture;
+  vec3 get_color_level(vec2 position_uv, uint level);
+
+  std::shared_ptr<TiledImage> _image;
 };
@@ -0,0 +1,437 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+#include "texture_cache.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <CImg.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+
+#include "texture_compression.hpp"
+#include "timeline.hpp"
+
+using cimg_library::CImg;
+
+#define TEXTURE_FILE_MAGIC 0x58545452  // "RTTX"
+#define TEXTURE_FILE_VERSION 2
+
+#define TILE_BYTES (TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE * 3)
+
+// number of BC1 blocks per tile and axis
+#define TILE_BLOCKS (TEXTURE_TILE_SIZE / 4)
+
+struct tiled_file_header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t num_levels;
+  uint32_t tile_size;
+  uint32_t format;
+};
+
+static std::atomic<uint32_t> next_image_id = 0;
+
+// ----------------------------------------------------------------------------
+// TiledImage
+
+TiledImage::TiledImage(std::string path_to_image) {
+  _path = path_to_image;
+  _id = next_image_id++;
+}
+
+TiledImage::~TiledImage() {
+  TextureCache::get_instance().release(_id);
+  if (_file >= 0) {
+    close(_file);
+  }
+}
+
+std::string TiledImage::get_path() { return _path; }
+uint32_t TiledImage::get_id() { return _id; }
+
+void TiledImage::prepare() {
+  std::call_once(_initialized, &TiledImage::initialize, this);
+}
+
+uint TiledImage::get_num_levels() {
+  std::call_once(_initialized, &TiledImage::initialize, this);
+  return _levels.size();
+}
+
+vec2 TiledImage::get_dimensions(uint level) {
+  std::call_once(_initialized, &TiledImage::initialize, this);
+  return vec2(_levels.at(level).width, _levels.at(level).height);
+}
+
+vec3 TiledImage::get_texel(uint level, int x, int y) {
+  std::call_once(_initialized, &TiledImage::initialize, this);
+
+  std::shared_ptr<const texture_tile> tile =
+      TextureCache::get_instance().get_tile(
+          this, level, x / TEXTURE_TILE_SIZE, y / TEXTURE_TILE_SIZE);
+
+  x %= TEXTURE_TILE_SIZE;
+  y %= TEXTURE_TILE_SIZE;
+
+  if (_format == TEXTURE_BC1) {
+    const unsigned char *block =
+        tile->texels.data() +
+        ((y / 4) * TILE_BLOCKS + (x / 4)) * BC1_BLOCK_BYTES;
+    return decode_bc1_texel(block, x % 4, y % 4);
+  }
+
+  const unsigned char *texel =
+      tile->texels.data() + (y * TEXTURE_TILE_SIZE + x) * 3;
+  return vec3(texel[0], texel[1], texel[2]);
+}
+
+uint TiledImage::get_tile_bytes() {
+  if (_format == TEXTURE_BC1) {
+    return TILE_BLOCKS * TILE_BLOCKS * BC1_BLOCK_BYTES;
+  }
+  return TILE_BYTES;
+}
+
+std::shared_ptr<const texture_tile> TiledImage::load_tile(uint level,
+                                                          uint tile_x,
+                                                          uint tile_y) {
+  const mip_level &l = _levels.at(level);
+  uint tile_bytes = get_tile_bytes();
+  uint64_t offset =
+      l.offset + (static_cast<uint64_t>(tile_y) * l.tiles_x + tile_x) *
+                     tile_bytes;
+
+  std::shared_ptr<texture_tile> tile = std::make_shared<texture_tile>();
+  tile->texels.resize(tile_bytes);
+
+  if (_file < 0) {
+    std::memcpy(tile->texels.data(), _resident.data() + offset, tile_bytes);
+  } else if (pread(_file, tile->texels.data(), tile_bytes, offset) !=
+             tile_bytes) {
+    throw std::runtime_error("could not read texture tile of " + _path);
+  }
+  return tile;
+}
+
+std::string TiledImage::get_cache_path() {
+  // the converted file depends on the image and it's last modification
+  std::filesystem::path path = std::filesystem::canonical(_path);
+  auto time = std::filesystem::last_write_time(path).time_since_epoch().count();
+
+  std::stringstream name;
+  name << std::hex << std::hash<std::string>{}(path.string()) << "_" << time
+       << (_format == TEXTURE_BC1 ? ".bc1" : "") << ".tiles";
+  return (std::filesystem::path(TEXTURE_CACHE_DIR) / name.str()).string();
+}
+
+void TiledImage::initialize() {
+  std::string cache_path = get_cache_path();
+
+  if (!read_header(cache_path)) {
+    convert(cache_path);
+  }
+}
+
+bool TiledImage::read_header(std::string path) {
+  int file = open(path.c_str(), O_RDONLY);
+  if (file < 0) {
+    return false;
+  }
+
+  tiled_file_header header;
+  if (pread(file, &header, sizeof(header), 0) != sizeof(header) ||
+      header.magic != TEXTURE_FILE_MAGIC ||
+      header.version != TEXTURE_FILE_VERSION ||
+      header.tile_size != TEXTURE_TILE_SIZE || header.format != _format) {
+    close(file);
+    return false;
+  }
+
+  _levels.resize(header.num_levels);
+  size_t levels_size = header.num_levels * sizeof(mip_level);
+  if (pread(file, _levels.data(), levels_size, sizeof(header)) !=
+      static_cast<ssize_t>(levels_size)) {
+    _levels.clear();
+    close(file);
+    return false;
+  }
+
+  _file = file;
+  return true;
+}
+
+/**
+ * @brief Decode the image, build all mip levels and write them tiled.
+ *
+ * @param cache_path path of the tiled file.
+ */
+void TiledImage::convert(std::string cache_path) {
+  TIMELINE_ZONE("decode texture");
+  CImg<unsigned char> image = CImg<unsigned char>(_path.c_str());
+  // decoded image, first level and tiles until the tiled file is written
+  MemoryAccount decode_memory(MEM_TEXTURES);
+  decode_memory.set(image.size());
+
+  // interleave channels of the first level (gray images get replicated)
+  uint32_t width = image.width();
+  uint32_t height = image.height();
+  std::vector<unsigned char> level(width * height * 3);
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) {
+      for (int c = 0; c < 3; c++) {
+        int channel = image.spectrum() >= 3 ? c : 0;
+        level[(y * width + x) * 3 + c] = image(x, y, 0, channel);
+      }
+    }
+  }
+  decode_memory.set(image.size() + get_vector_bytes(level));
+  image.assign();
+
+  tiled_file_header header = {TEXTURE_FILE_MAGIC, TEXTURE_FILE_VERSION, 0,
+                              TEXTURE_TILE_SIZE, _format};
+  uint tile_bytes = get_tile_bytes();
+  std::vector<unsigned char> tiles;
+
+  while (true) {
+    mip_level l;
+    l.width = width;
+    l.height = height;
+    l.tiles_x = (width + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+    l.tiles_y = (height + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+    l.offset = tiles.size();
+    _levels.push_back(l);
+
+    // copy texels into tiles, borders of the last tiles repeat the edge
+    tiles.resize(tiles.size() + l.tiles_x * l.tiles_y * tile_bytes, 0);
+    std::vector<unsigned char> tile_rgb(TILE_BYTES);
+    for (uint32_t tile_y = 0; tile_y < l.tiles_y; tile_y++) {
+      for (uint32_t tile_x = 0; tile_x < l.tiles_x; tile_x++) {
+        for (uint32_t y = 0; y < TEXTURE_TILE_SIZE; y++) {
+          uint32_t image_y =
+              std::min(tile_y * TEXTURE_TILE_SIZE + y, height - 1);
+          for (uint32_t x = 0; x < TEXTURE_TILE_SIZE; x++) {
+            uint32_t image_x =
+                std::min(tile_x * TEXTURE_TILE_SIZE + x, width - 1);
+            std::memcpy(tile_rgb.data() + (y * TEXTURE_TILE_SIZE + x) * 3,
+                        level.data() + (image_y * width + image_x) * 3, 3);
+          }
+        }
+
+        unsigned char *dst = tiles.data() + l.offset +
+                             (tile_y * l.tiles_x + tile_x) * tile_bytes;
+        if (_format == TEXTURE_BC1) {
+          compress_tile(tile_rgb.data(), dst);
+        } else {
+          std::memcpy(dst, tile_rgb.data(), TILE_BYTES);
+        }
+      }
+    }
+
+    if (width == 1 && height == 1) {
+      break;
+    }
+
+    // box filter the next level
+    uint32_t next_width = std::max(width / 2, 1u);
+    uint32_t next_height = std::max(height / 2, 1u);
+    std::vector<unsigned char> next(next_width * next_height * 3);
+    decode_memory.set(get_vector_bytes(level) + get_vector_bytes(next) +
+                      get_vector_bytes(tiles));
+    for (uint32_t y = 0; y < next_height; y++) {
+      for (uint32_t x = 0; x < next_width; x++) {
+        uint32_t x0 = std::min(2 * x, width - 1);
+        uint32_t x1 = std::min(2 * x + 1, width - 1);
+        uint32_t y0 = std::min(2 * y, height - 1);
+        uint32_t y1 = std::min(2 * y + 1, height - 1);
+        for (int c = 0; c < 3; c++) {
+          uint sum = level[(y0 * width + x0) * 3 + c] +
+                     level[(y0 * width + x1) * 3 + c] +
+                     level[(y1 * width + x0) * 3 + c] +
+                     level[(y1 * width + x1) * 3 + c];
+          next[(y * next_width + x) * 3 + c] = (sum + 2) / 4;
+        }
+      }
+    }
+    level.swap(next);
+    width = next_width;
+    height = next_height;
+  }
+  header.num_levels = _levels.size();
+
+  // tile offsets are relative to the end of the header
+  uint64_t data_offset = sizeof(header) + _levels.size() * sizeof(mip_level);
+  for (mip_level &l : _levels) {
+    l.offset += data_offset;
+  }
+
+  std::error_code error;
+  std::filesystem::create_directories(TEXTURE_CACHE_DIR, error);
+  // unique per process, runs sharing the cache must not truncate each
+  // other's file before the rename
+  std::string tmp_path = cache_path + ".tmp." + std::to_string(getpid());
+  std::ofstream file(tmp_path, std::ios::binary);
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(_levels.data()),
+             _levels.size() * sizeof(mip_level));
+  file.write(reinterpret_cast<const char *>(tiles.data()), tiles.size());
+  file.close();
+
+  if (!file.fail()) {
+    std::filesystem::rename(tmp_path, cache_path, error);
+    if (!error) {
+      _file = open(cache_path.c_str(), O_RDONLY);
+    }
+  }
+  if (_file < 0) {
+    // keep the texture in memory if it can't be paged from disk
+    std::cout << "could not write texture cache for " << _path << "\n";
+    std::filesystem::remove(tmp_path, error);
+    _resident.resize(data_offset);
+    _resident.insert(_resident.end(), tiles.begin(), tiles.end());
+    _resident_memory.set(get_vector_bytes(_resident));
+  }
+}
+
+void TiledImage::compress_tile(const unsigned char *rgb, unsigned char *dst) {
+  unsigned char block_rgb[16 * 3];
+  for (uint block_y = 0; block_y < TILE_BLOCKS; block_y++) {
+    for (uint block_x = 0; block_x < TILE_BLOCKS; block_x++) {
+      // gather the 4x4 texels of the block
+      for (uint y = 0; y < 4; y++) {
+        std::memcpy(block_rgb + y * 4 * 3,
+                    rgb + ((block_y * 4 + y) * TEXTURE_TILE_SIZE +
+                           block_x * 4) *
+                              3,
+                    4 * 3);
+      }
+      compress_bc1_block(block_rgb,
+                         dst + (block_y * TILE_BLOCKS + block_x) *
+                                   BC1_BLOCK_BYTES);
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+// TextureCache
+
+TextureCache &TextureCache::get_instance() {
+  static TextureCache cache;
+  return cache;
+}
+
+uint64_t TextureCache::get_key(uint32_t image_id, uint level, uint tile_x,
+                               uint tile_y) {
+  // 20 bit image, 4 bit level, 20 bit per tile index
+  return (static_cast<uint64_t>(image_id & 0xfffff) << 44) |
+         (static_cast<uint64_t>(level & 0xf) << 40) |
+         (static_cast<uint64_t>(tile_x & 0xfffff) << 20) | (tile_y & 0xfffff);
+}
+
+std::shared_ptr<const texture_tile> TextureCache::get_tile(TiledImage *image,
+                                                           uint level,
+                                                           uint tile_x,
+                                                           uint tile_y) {
+  uint64_t key = get_key(image->get_id(), level, tile_x, tile_y);
+
+  // neighbouring lookups mostly hit the same tile
+  thread_local uint64_t last_key = UINT64_MAX;
+  thread_local std::shared_ptr<const texture_tile> last_tile;
+  if (key == last_key) {
+    return last_tile;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto entry = _entries.find(key);
+    if (entry != _entries.end()) {
+      // mark as most recently used
+      _lru.splice(_lru.begin(), _lru, entry->second);
+      last_key = key;
+      last_tile = entry->second->tile;
+      return last_tile;
+    }
+  }
+
+  // load outside of the lock, other threads can still read cached tiles
+  std::shared_ptr<const texture_tile> tile =
+      image->load_tile(level, tile_x, tile_y);
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto entry = _entries.find(key);
+  if (entry != _entries.end()) {
+    // another thread loaded the tile in the meantime
+    tile = entry->second->tile;
+  } else {
+    _lru.push_front({key, tile});
+    _entries[key] = _lru.begin();
+    _memory_usage += tile->texels.size();
+    evict();
+  }
+  last_key = key;
+  last_tile = tile;
+  return tile;
+}
+
+void TextureCache::evict() {
+  // always keep the tile that was just inserted
+  while (_memory_usage > _memory_limit && _lru.size() > 1) {
+    cache_entry &oldest = _lru.back();
+    _memory_usage -= oldest.tile->texels.size();
+    _entries.erase(oldest.key);
+    _lru.pop_back();
+  }
+  _tile_memory.set(_memory_usage);
+}
+
+void TextureCache::release(uint32_t image_id) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (auto it = _lru.begin(); it != _lru.end();) {
+    if ((it->key >> 44) == (image_id & 0xfffff)) {
+      _memory_usage -= it->tile->texels.size();
+      _entries.erase(it->key);
+      it = _lru.erase(it);
+    } else {
+      it++;
+    }
+  }
+  _tile_memory.set(_memory_usage);
+}
+
+void TextureCache::set_memory_limit(size_t bytes) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _memory_limit = bytes;
+  evict();
+}
+
+size_t TextureCache::get_memory_usage() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _memory_usage;
+}
+
+// ----------------------------------------------------------------------------
+// TextureRegistry
+
+TextureRegistry &TextureRegistry::get_instance() {
+  static TextureRegistry registry;
+  return registry;
+}
+
+std::shared_ptr<TiledImage> TextureRegistry::get_image(
+    std::string path_to_image) {
+  std::string key = std::filesystem::weakly_canonical(path_to_image).string();
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  std::shared_ptr<TiledImage> image = _images[key].lock();
+  if (!image) {
+    image = std::make_shared<TiledImage>(path_to_image);
+    _images[key] = image;
+  }
+  return image;
+}
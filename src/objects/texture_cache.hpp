@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "memory_stats.hpp"
+
+using glm::vec2, glm::vec3;
+
+// number of texels per tile and axis
+#define TEXTURE_TILE_SIZE 32
+
+// maximum amount of memory used by resident tiles of all textures (bytes)
+#define TEXTURE_CACHE_MEMORY (512ull << 20)
+
+// folder to store converted (tiled and mip-mapped) textures in
+#define TEXTURE_CACHE_DIR "data/cache/textures"
+
+// keep tiles BC1 compressed in memory (6x less memory, lossy)
+#define TEXTURE_COMPRESSION false
+
+enum texture_format { TEXTURE_RGB8, TEXTURE_BC1 };
+
+/// @brief interleaved rgb texels or BC1 blocks of one tile.
+struct texture_tile {
+  std::vector<unsigned char> texels;
+};
+
+/// @brief position and size of one mip level in the tiled file.
+struct mip_level {
+  uint32_t width;
+  uint32_t height;
+  uint32_t tiles_x;
+  uint32_t tiles_y;
+  /// @brief byte offset of the first tile of the level.
+  uint64_t offset;
+};
+
+/**
+ * @brief Image converted into interleaved, tiled and mip-mapped storage.
+ *
+ * The source image gets decoded on first access and is written to
+ * TEXTURE_CACHE_DIR. Afterwards tiles are only read from that file when they
+ * are touched and are kept in the TextureCache.
+ */
+class TiledImage {
+ public:
+  explicit TiledImage(std::string path_to_image);
+  ~TiledImage();
+
+  TiledImage(const TiledImage&) = delete;
+  TiledImage& operator=(const TiledImage&) = delete;
+
+  /// @brief returns color of the texel with values between 0-255.
+  vec3 get_texel(uint level, int x, int y);
+
+  uint get_num_levels();
+  vec2 get_dimensions(uint level);
+
+  std::string get_path();
+  uint32_t get_id();
+
+  /// @brief decode and convert the image now instead of on first access.
+  void prepare();
+
+  /// @brief read tile from the tiled file (called by the TextureCache).
+  std::shared_ptr<const texture_tile> load_tile(uint level, uint tile_x,
+                                                uint tile_y);
+
+ private:
+  /// @brief converts the image or opens an already converted file.
+  void initialize();
+  bool read_header(std::string path);
+  void convert(std::string cache_path);
+  void compress_tile(const unsigned char* rgb, unsigned char* dst);
+  std::string get_cache_path();
+
+  uint get_tile_bytes();
+
+  std::string _path;
+  uint32_t _id;
+  texture_format _format = TEXTURE_COMPRESSION ? TEXTURE_BC1 : TEXTURE_RGB8;
+
+  std::once_flag _initialized;
+  std::vector<mip_level> _levels;
+
+  /// @brief file descriptor of the tiled file (-1 if kept in memory).
+  int _file = -1;
+  /// @brief fallback if the tiled file could not be written.
+  std::vector<unsigned char> _resident;
+  MemoryAccount _resident_memory{MEM_TEXTURES};
+};
+
+/**
+ * @brief Process wide LRU cache for texture tiles with a memory limit.
+ */
+class TextureCache {
+ public:
+  static TextureCache& get_instance();
+
+  std::shared_ptr<const texture_tile> get_tile(TiledImage* image, uint level,
+                                               uint tile_x, uint tile_y);
+
+  void set_memory_limit(size_t bytes);
+  size_t get_memory_usage();
+
+  /// @brief removes all tiles of the image from the cache.
+  void release(uint32_t image_id);
+
+ private:
+  TextureCache() {}
+
+  struct cache_entry {
+    uint64_t key;
+    std::shared_ptr<const texture_tile> tile;
+  };
+
+  uint64_t get_key(uint32_t image_id, uint level, uint tile_x, uint tile_y);
+  void evict();
+
+  std::mutex _mutex;
+  /// @brief most recently used tile at the front.
+  std::list<cache_entry> _lru;
+  std::unordered_map<uint64_t, std::list<cache_entry>::iterator> _entries;
+
+  size_t _memory_limit = TEXTURE_CACHE_MEMORY;
+  size_t _memory_usage = 0;
+  MemoryAccount _tile_memory{MEM_TEXTURES};
+};
+
+/**
+ * @brief Process wide registry of images keyed by their canonical path.
+ *
+ * Textures referencing the same file share one TiledImage, so every image is
+ * only decoded once.
+ */
+class TextureRegistry {
+ public:
+  static TextureRegistry& get_instance();
+
+  std::shared_ptr<TiledImage> get_image(std::string path_to_image);
+
+ private:
+  TextureRegistry() {}
+
+  std::mutex _mutex;
+  std::unordered_map<std::string, std::weak_ptr<TiledImage>> _images;
+};
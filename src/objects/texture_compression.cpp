@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+#include "texture_compression.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+uint16_t to_rgb565(vec3 color) {
+  uint r = glm::clamp(static_cast<int>(color.x * 31 / 255 + 0.5f), 0, 31);
+  uint g = glm::clamp(static_cast<int>(color.y * 63 / 255 + 0.5f), 0, 63);
+  uint b = glm::clamp(static_cast<int>(color.z * 31 / 255 + 0.5f), 0, 31);
+  return (r << 11) | (g << 5) | b;
+}
+
+vec3 from_rgb565(uint16_t color) {
+  uint r = (color >> 11) & 31;
+  uint g = (color >> 5) & 63;
+  uint b = color & 31;
+  // replicate high bits into the low bits
+  return vec3((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+}
+
+/// @brief palette of a block, c0 > c1 means four colors else three + black.
+void get_palette(uint16_t c0, uint16_t c1, vec3 palette[4]) {
+  palette[0] = from_rgb565(c0);
+  palette[1] = from_rgb565(c1);
+  if (c0 > c1) {
+    palette[2] = (2.f * palette[0] + palette[1]) / 3.f;
+    palette[3] = (palette[0] + 2.f * palette[1]) / 3.f;
+  } else {
+    palette[2] = (palette[0] + palette[1]) * 0.5f;
+    palette[3] = vec3(0);
+  }
+}
+
+}  // namespace
+
+void compress_bc1_block(const unsigned char *rgb, unsigned char *block) {
+  // endpoints: bounding box of the colors inset by 1/16 of it's size
+  vec3 min = vec3(255);
+  vec3 max = vec3(0);
+  for (int i = 0; i < 16; i++) {
+    vec3 color = vec3(rgb[i * 3], rgb[i * 3 + 1], rgb[i * 3 + 2]);
+    min = glm::min(min, color);
+    max = glm::max(max, color);
+  }
+  vec3 inset = (max - min) / 16.f;
+
+  uint16_t c0 = to_rgb565(max - inset);
+  uint16_t c1 = to_rgb565(min + inset);
+  if (c0 < c1) {
+    std::swap(c0, c1);
+  }
+
+  vec3 palette[4];
+  get_palette(c0, c1, palette);
+
+  // choose the closest palette entry for every texel
+  uint32_t indices = 0;
+  if (c0 != c1) {
+    for (int i = 0; i < 16; i++) {
+      vec3 color = vec3(rgb[i * 3], rgb[i * 3 + 1], rgb[i * 3 + 2]);
+      uint best = 0;
+      float best_distance = MAXFLOAT;
+      for (uint p = 0; p < 4; p++) {
+        vec3 d = color - palette[p];
+        float distance = glm::dot(d, d);
+        if (distance < best_distance) {
+          best_distance = distance;
+          best = p;
+        }
+      }
+      indices |= best << (2 * i);
+    }
+  }
+
+  std::memcpy(block, &c0, 2);
+  std::memcpy(block + 2, &c1, 2);
+  std::memcpy(block + 4, &indices, 4);
+}
+
+vec3 decode_bc1_texel(const unsigned char *block, uint x, uint y) {
+  uint16_t c0;
+  uint16_t c1;
+  uint32_t indices;
+  std::memcpy(&c0, block, 2);
+  std::memcpy(&c1, block + 2, 2);
+  std::memcpy(&indices, block + 4, 4);
+
+  uint index = (indices >> (2 * (y * 4 + x))) & 3;
+
+  // only interpolate the entry that is needed
+  vec3 color0 = from_rgb565(c0);
+  vec3 color1 = from_rgb565(c1);
+  switch (index) {
+    case 0:
+      return color0;
+    case 1:
+      return color1;
+    case 2:
+      return c0 > c1 ? (2.f * color0 + color1) / 3.f : (color0 + color1) * 0.5f;
+    default:
+      return c0 > c1 ? (color0 + 2.f * color1) / 3.f : vec3(0);
+  }
+}
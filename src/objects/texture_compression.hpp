@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "glm/glm.hpp"
+
+using glm::vec3;
+
+// bytes of one compressed block of 4x4 texels
+#define BC1_BLOCK_BYTES 8
+
+/**
+ * @brief Compress 4x4 texels into a BC1 (DXT1) block.
+ *
+ * @param rgb 16 interleaved rgb texels in row major order.
+ * @param block output with BC1_BLOCK_BYTES bytes.
+ */
+void compress_bc1_block(const unsigned char* rgb, unsigned char* block);
+
+/**
+ * @brief Decode a single texel of a BC1 block.
+ *
+ * @param block compressed block.
+ * @param x texel inside the block (0-3).
+ * @param y texel inside the block (0-3).
+ * @return vec3 color with values between 0-255.
+ */
+vec3 decode_bc1_texel(const unsigned char* block, uint x, uint y);
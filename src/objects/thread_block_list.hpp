@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+#pragma once
+
+#include <atomic>
+
+/**
+ * @brief Lock-free list with one block of type T per thread (the recording
+ * buffers of TraversalStats, Timeline and PerfCounters).
+ *
+ * A thread gets its block on its first call of get_local() and links it into
+ * the list with a compare and swap, so recording needs neither locks nor
+ * atomics afterwards. Blocks live until the end of the process, so for_each
+ * can always read them (reading while other threads still record gives
+ * inaccurate results). Threads are numbered in the order they first called
+ * get_local().
+ *
+ * The block of a thread is found through a thread_local per T, so there can
+ * only be one list per type (the owners are singletons).
+ */
+template <typename T>
+class thread_block_list {
+ public:
+  /// @brief block of the calling thread, init(T*) runs before it is linked.
+  template <typename Init>
+  T* get_local(Init init) {
+    thread_local node* local = nullptr;
+    if (local == nullptr) {
+      local = new node;
+      local->thread_id = _next_thread_id++;
+      init(&local->block);
+      local->next = _head.load(std::memory_order_relaxed);
+      while (!_head.compare_exchange_weak(local->next, local,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed)) {
+      }
+    }
+    return &local->block;
+  }
+
+  T* get_local() {
+    return get_local([](T*) {});
+  }
+
+  /// @brief calls function(T&, uint thread_id) for every block, the thread
+  /// seen last first.
+  template <typename Function>
+  void for_each(Function function) {
+    for (node* n = _head.load(std::memory_order_acquire); n != nullptr;
+         n = n->next) {
+      function(n->block, n->thread_id);
+    }
+  }
+
+ private:
+  struct node {
+    T block;
+    uint thread_id;
+    node* next = nullptr;
+  };
+
+  std::atomic<node*> _head{nullptr};
+  std::atomic<uint> _next_thread_id{0};
+};
+
+#define SCOPE_CONCAT_INNER(a, b) a##b
+/// @brief pastes a and b after expanding them (unique names with __LINE__).
+#define SCOPE_CONCAT(a, b) SCOPE_CONCAT_INNER(a, b)
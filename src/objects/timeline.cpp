@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+#include "timeline.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+// ----------------------------------------------------------------------------
+// Timeline
+
+Timeline::Timeline() { _start = std::chrono::steady_clock::now(); }
+
+Timeline &Timeline::get_instance() {
+  static Timeline instance;
+  return instance;
+}
+
+void Timeline::enable() { _enabled.store(true, std::memory_order_relaxed); }
+
+void Timeline::disable() { _enabled.store(false, std::memory_order_relaxed); }
+
+bool Timeline::is_enabled() {
+  return _enabled.load(std::memory_order_relaxed);
+}
+
+void Timeline::record(const char *name, uint64_t begin, uint64_t end) {
+  _blocks.get_local()->events.push_back({name, begin, end});
+}
+
+void Timeline::clear() {
+  _blocks.for_each([](thread_block &block, uint) { block.events.clear(); });
+}
+
+uint64_t Timeline::get_time() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - _start)
+      .count();
+}
+
+void Timeline::write_chrome_trace(std::string path) {
+  std::ofstream file(path);
+  if (file.fail()) {
+    throw std::runtime_error("could not open " + path);
+  }
+
+  // complete events ("X") with timestamps in microseconds
+  file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  bool first = true;
+  uint64_t count = 0;
+  _blocks.for_each([&](const thread_block &block, uint thread_id) {
+    file << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": "
+         << "\"M\", \"pid\": 1, \"tid\": " << thread_id
+         << ", \"args\": {\"name\": \"thread " << thread_id << "\"}}";
+    first = false;
+    for (const timeline_event &event : block.events) {
+      file << ",\n{\"name\": \"" << event.name << "\", \"ph\": \"X\", "
+           << "\"pid\": 1, \"tid\": " << thread_id
+           << ", \"ts\": " << event.begin / 1000.0
+           << ", \"dur\": " << (event.end - event.begin) / 1000.0 << "}";
+      count++;
+    }
+  });
+  file << "\n]}\n";
+  std::cout << "wrote " << count << " trace events to " << path << "\n";
+}
+
+// ----------------------------------------------------------------------------
+// TimelineZone
+
+TimelineZone::TimelineZone(const char *name) {
+  _name = name;
+  Timeline &timeline = Timeline::get_instance();
+  _active = timeline.is_enabled();
+  if (_active) {
+    _begin = timeline.get_time();
+  }
+}
+
+TimelineZone::~TimelineZone() {
+  if (_active) {
+    Timeline &timeline = Timeline::get_instance();
+    timeline.record(_name, _begin, timeline.get_time());
+  }
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "thread_block_list.hpp"
+
+// compile the trace zones in, they are only recorded after enable()
+#define TIMELINE true
+
+/// @brief a finished zone, times in ns since the start of the timeline.
+struct timeline_event {
+  /// @brief has to outlive the timeline (string literal).
+  const char* name;
+  uint64_t begin;
+  uint64_t end;
+};
+
+/**
+ * @brief Process wide timeline of the trace zones (see TIMELINE_ZONE).
+ *
+ * Like TraversalStats every thread records into its own buffer of a
+ * thread_block_list. The buffers are read by
+ * write_chrome_trace, which should only be called while no zones are open.
+ */
+class Timeline {
+ public:
+  static Timeline& get_instance();
+
+  void enable();
+  void disable();
+  bool is_enabled();
+
+  void record(const char* name, uint64_t begin, uint64_t end);
+
+  /// @brief drops the recorded events of all threads.
+  void clear();
+
+  /// @brief ns since the timeline was created.
+  uint64_t get_time();
+
+  /**
+   * @brief Writes all events as Chrome trace-event json, which can be opened
+   * with chrome://tracing or Perfetto.
+   */
+  void write_chrome_trace(std::string path);
+
+ private:
+  Timeline();
+
+  struct thread_block {
+    std::vector<timeline_event> events;
+  };
+
+  std::chrono::steady_clock::time_point _start;
+  std::atomic<bool> _enabled{false};
+  thread_block_list<thread_block> _blocks;
+};
+
+/// @brief records the time from construction to destruction as zone.
+class TimelineZone {
+ public:
+  explicit TimelineZone(const char* name);
+  ~TimelineZone();
+
+  TimelineZone(const TimelineZone&) = delete;
+  TimelineZone& operator=(const TimelineZone&) = delete;
+
+ private:
+  const char* _name;
+  uint64_t _begin = 0;
+  bool _active;
+};
+
+#if TIMELINE
+/// @brief time the rest of the enclosing scope as zone name.
+#define TIMELINE_ZONE(name) \
+  TimelineZone SCOPE_CONCAT(timeline_zone_, __LINE__)(name)
+#else
+#define TIMELINE_ZONE(name)
+#endif
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+#include "traversal_stats.hpp"
+
+#include <algorithm>
+#include <bit>
+
+// ----------------------------------------------------------------------------
+// traversal_counters
+
+void traversal_counters::add(uint32_t node_count, uint32_t triangle_count,
+                             float seconds) {
+  rays++;
+  nodes += node_count;
+  triangles += triangle_count;
+  min_nodes = std::min(min_nodes, node_count);
+  max_nodes = std::max(max_nodes, node_count);
+  min_triangles = std::min(min_triangles, triangle_count);
+  max_triangles = std::max(max_triangles, triangle_count);
+
+  histogram_nodes[get_bin(node_count)]++;
+  histogram_triangles[get_bin(triangle_count)]++;
+
+  if (seconds >= 0) {
+    timed_rays++;
+    time += seconds;
+  }
+}
+
+void traversal_counters::merge(const traversal_counters &other) {
+  rays += other.rays;
+  nodes += other.nodes;
+  triangles += other.triangles;
+  min_nodes = std::min(min_nodes, other.min_nodes);
+  max_nodes = std::max(max_nodes, other.max_nodes);
+  min_triangles = std::min(min_triangles, other.min_triangles);
+  max_triangles = std::max(max_triangles, other.max_triangles);
+  timed_rays += other.timed_rays;
+  time += other.time;
+
+  for (uint i = 0; i < STATS_HISTOGRAM_BINS; i++) {
+    histogram_nodes[i] += other.histogram_nodes[i];
+    histogram_triangles[i] += other.histogram_triangles[i];
+  }
+}
+
+double traversal_counters::get_estimated_time() const {
+  if (timed_rays == 0) {
+    return 0;
+  }
+  return time / timed_rays * rays;
+}
+
+uint traversal_counters::get_bin(uint32_t value) {
+  return std::bit_width(value);
+}
+
+// ----------------------------------------------------------------------------
+// TraversalStats
+
+TraversalStats &TraversalStats::get_instance() {
+  static TraversalStats instance;
+  return instance;
+}
+
+uint TraversalStats::add_counters() { return _next_id++; }
+
+void TraversalStats::record(uint id, uint32_t node_count,
+                            uint32_t triangle_count, float seconds) {
+  thread_block *block = _blocks.get_local();
+  if (id >= block->counters.size()) {
+    block->counters.resize(id + 1);
+  }
+  block->counters[id].add(node_count, triangle_count, seconds);
+
+  pixel_counters &pixel = get_pixel_counters();
+  pixel.nodes += node_count;
+  pixel.triangles += triangle_count;
+}
+
+traversal_counters TraversalStats::merge(uint id) {
+  traversal_counters result;
+  _blocks.for_each([&result, id](const thread_block &block, uint) {
+    if (id < block.counters.size()) {
+      result.merge(block.counters[id]);
+    }
+  });
+  return result;
+}
+
+bool TraversalStats::sample_timing() {
+  thread_local uint count = 0;
+  return count++ % STATS_TIMING_RATE == 0;
+}
+
+pixel_counters &TraversalStats::get_pixel_counters() {
+  thread_local pixel_counters counters;
+  return counters;
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "thread_block_list.hpp"
+
+// time one of n traversals (timing every ray costs more than the traversal)
+#define STATS_TIMING_RATE 64
+
+// bins of the log2 histograms (bin i holds values in [2^(i-1), 2^i))
+#define STATS_HISTOGRAM_BINS 33
+
+/// @brief traversal counters of one mesh (per thread or merged).
+struct traversal_counters {
+  uint64_t rays = 0;
+  uint64_t nodes = 0;
+  uint64_t triangles = 0;
+  uint32_t min_nodes = UINT32_MAX;
+  uint32_t max_nodes = 0;
+  uint32_t min_triangles = UINT32_MAX;
+  uint32_t max_triangles = 0;
+
+  /// @brief number of rays that were timed and their summed time (sec).
+  uint64_t timed_rays = 0;
+  double time = 0;
+
+  std::array<uint64_t, STATS_HISTOGRAM_BINS> histogram_nodes{};
+  std::array<uint64_t, STATS_HISTOGRAM_BINS> histogram_triangles{};
+
+  /// @brief adds one traversal, time < 0 if it was not timed.
+  void add(uint32_t node_count, uint32_t triangle_count, float seconds);
+  void merge(const traversal_counters& other);
+
+  /// @brief estimated time of all traversals from the timed ones.
+  double get_estimated_time() const;
+
+  static uint get_bin(uint32_t value);
+};
+
+/// @brief work done for the pixel a thread currently traces (for AOVs).
+struct pixel_counters {
+  uint32_t nodes = 0;
+  uint32_t triangles = 0;
+  uint32_t shadow_rays = 0;
+};
+
+/**
+ * @brief Process wide traversal statistics with thread local counters.
+ *
+ * Every thread writes into its own block of counters, so recording needs
+ * neither locks nor atomics. Blocks are linked into a lock-free list on their
+ * first use and summed up by merge() after a frame is finished (merging while
+ * other threads still record gives inaccurate results).
+ */
+class TraversalStats {
+ public:
+  static TraversalStats& get_instance();
+
+  /// @brief returns the id of a new set of counters (e.g. for a mesh).
+  uint add_counters();
+
+  void record(uint id, uint32_t node_count, uint32_t triangle_count,
+              float seconds);
+
+  /// @brief sums up the counters of all threads.
+  traversal_counters merge(uint id);
+
+  /// @brief returns true for every STATS_TIMING_RATE-th call of a thread.
+  static bool sample_timing();
+
+  /// @brief counters of the current pixel of the calling thread.
+  static pixel_counters& get_pixel_counters();
+
+ private:
+  TraversalStats() {}
+
+  struct thread_block {
+    std::vector<traversal_counters> counters;
+  };
+
+  thread_block_list<thread_block> _blocks;
+  std::atomic<uint> _next_id{0};
+};
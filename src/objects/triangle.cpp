@@ -134,6 +134,7 @@ void Triangle::set_vertex_texture(vec2 texture_uv[3]) {
 
 vec3 Triangle::get_normal() { return _normal; }
 vec3 Triangle::get_pos() { return calculate_middle(); }
+vec3 Triangle::get_vertex(uint id) { return _p[id]; }
 uint Triangle::get_material(void) { return _material_id; }
 
 void Triangle::set_material(uint material_id) { _material_id = material_id; }
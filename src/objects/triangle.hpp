@@ -20,7 +20,7 @@ struct TriangleIntersection {
   /// @brief Normal of the intersecting surface.
   vec3 normal = vec3(0, 0, 0);
   /// @brief Material of the interscting surface.
-  uint material_id;
+  uint material_id = 0;
   /// @brief texture coordinates if available.
   vec2 texture_uv = vec2(-1, -1);
   /// @brief coordinates if available.
@@ -46,6 +46,7 @@ class Triangle : public Object {
   // getters
   vec3 get_normal();
   vec3 get_pos();
+  vec3 get_vertex(uint id);
   uint get_material(void);
   void set_material(uint material_id);
 
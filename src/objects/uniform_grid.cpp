@@ -3,7 +3,11 @@
  */
 #include "uniform_grid.hpp"
 
+#include <cmath>
+#include <limits>
+
 #include "box.hpp"
+#include "timeline.hpp"
 
 UniformGrid::UniformGrid(std::vector<Triangle> *triangles) {
   _data.triangles = triangles;
@@ -14,13 +18,21 @@ UniformGrid &UniformGrid::operator=(const UniformGrid &old) {
   _data = old._data;
   return *this;
 }
+UniformGrid::UniformGrid(UniformGrid &&old) noexcept {
+  _data = std::move(old._data);
+}
+UniformGrid &UniformGrid::operator=(UniformGrid &&old) noexcept {
+  _data = std::move(old._data);
+  return *this;
+}
 
-void UniformGrid::build(std::vector<Triangle> *triangles) {
+void UniformGrid::build(std::vector<Triangle> *triangles, uint grid_size) {
+  TIMELINE_ZONE("build grid");
   _data.triangles = triangles;
-  _data.morton.initialize_grid_size(_data.triangles, GRID_SIZE);
+  _data.morton.initialize_grid_size(_data.triangles, grid_size);
 
   // set properties
-  _data.resolution = vec3(GRID_SIZE);
+  _data.resolution = vec3(grid_size);
 
   // calculate bounds
   // TODO(tobi) calculate bounds in the right way
@@ -34,11 +46,26 @@ void UniformGrid::build(std::vector<Triangle> *triangles) {
 
   _data.cell_size = (_data.bounds.max - _data.bounds.min) / _data.resolution;
 
+  // cells reach from 0 to grid_size (inclusive) on every axis
+  glm::ivec3 num_cells = glm::ivec3(grid_size + 1);
+  initialize_mask(&_data.occupancy, num_cells);
+  initialize_mask(&_data.macrocells,
+                  (num_cells + MACROCELL_SIZE - 1) / MACROCELL_SIZE);
+
   for (uint triangle_id = 0; triangle_id < _data.triangles->size();
        triangle_id++) {
     add_to_grid(triangle_id);
   }
   std::cout << "filled cells: " << _data.grid.size() << "\n";
+
+  // hash map nodes hold the next pointer and the cell besides the ids
+  uint64_t bytes = get_vector_bytes(_data.occupancy.bits) +
+                   get_vector_bytes(_data.macrocells.bits) +
+                   _data.grid.bucket_count() * sizeof(void *);
+  for (const auto &cell : _data.grid) {
+    bytes += sizeof(void *) + sizeof(cell) + get_vector_bytes(cell.second);
+  }
+  _data.memory.set(bytes);
 }
 
 vec3 UniformGrid::compute_index(const vec3 &point) {
@@ -58,6 +85,10 @@ void UniformGrid::add_id(vec3 index, uint id) {
   uint64_t morton_code = _data.morton.get_value(index);
   // insert id
   _data.grid[morton_code].push_back(id);
+
+  glm::ivec3 cell = glm::ivec3(index);
+  set_occupied(&_data.occupancy, cell);
+  set_occupied(&_data.macrocells, cell / MACROCELL_SIZE);
 }
 
 void UniformGrid::add_to_grid(uint triangle_id) {
@@ -65,6 +96,9 @@ void UniformGrid::add_to_grid(uint triangle_id) {
   Triangle *triangle = _data.triangles->data() + triangle_id;
   vec3 index_min = get_cell(triangle->get_min_bounding());
   vec3 index_max = get_cell(triangle->get_max_bounding());
+  // rounding errors must not push the index out of the occupancy masks
+  index_min = glm::max(index_min, vec3(0));
+  index_max = glm::min(index_max, _data.resolution);
 
   // add to all cells in between
   for (uint x = index_min.x; x <= index_max.x; x++) {
@@ -81,95 +115,100 @@ void UniformGrid::set_triangles(std::vector<Triangle> *triangles) {
 }
 
 TriangleIntersection UniformGrid::intersect(const Ray &ray) {
-  _best_intersection = TriangleIntersection();
+  TriangleIntersection best;
   // check if box is intersected
   // find first intersecting cell -> convert ray origin to be in first cell
   float t_0 = intersect_bounds(_data.bounds, ray);
 
   if (t_0 < 0) {
     // ray does not intersect
-    return _best_intersection;
+    return best;
   }
 
   vec3 ray_origin = ray.get_point(t_0);
   vec3 ray_origin_grid = ray_origin - _data.bounds.min;
   vec3 ray_direction = ray.get_direction();
 
-  // intersect cells recursively using DDA-Algorithm
-  vec3 current_cell = get_cell(ray_origin);
+  // intersect cells using DDA-Algorithm, the entry point can lie slightly
+  // outside of the grid because of rounding errors.
+  glm::ivec3 current_cell =
+      glm::clamp(glm::ivec3(get_cell(ray_origin)), glm::ivec3(0),
+                 _data.occupancy.size - 1);
+
+  // defines the step directions for every axis
+  glm::ivec3 step;
+  // offset of the next cell bound in step direction (1 positive, 0 negative)
+  glm::ivec3 bound_offset;
 
   // parameter t of the ray such that it intersects the next x,y,z-bounds of the
   // cell
   vec3 t_next = vec3(0);
   vec3 delta_t = vec3(0);
 
-  // defines the step directions for every axis
-  vec3 step;
-  step.x = ray_direction.x > 0 ? 1 : -1;
-  step.y = ray_direction.y > 0 ? 1 : -1;
-  step.z = ray_direction.z > 0 ? 1 : -1;
-
-  // calculate t_0  and delta_t
-  if (ray_direction.x >= 0) {
-    delta_t.x = _data.cell_size.x / ray_direction.x;
-    t_next.x = ((current_cell.x + 1) * _data.cell_size.x - ray_origin_grid.x) /
-               ray_direction.x;
-  } else {
-    delta_t.x = -_data.cell_size.x / ray_direction.x;
-    t_next.x = (current_cell.x * _data.cell_size.x - ray_origin_grid.x) /
-               ray_direction.x;
-  }
-
-  if (ray_direction.y >= 0) {
-    delta_t.y = _data.cell_size.y / ray_direction.y;
-    t_next.y = ((current_cell.y + 1) * _data.cell_size.y - ray_origin_grid.y) /
-               ray_direction.y;
-  } else {
-    delta_t.y = -_data.cell_size.y / ray_direction.y;
-    t_next.y = (current_cell.y * _data.cell_size.y - ray_origin_grid.y) /
-               ray_direction.y;
-  }
-
-  if (ray_direction.z >= 0) {
-    delta_t.z = _data.cell_size.z / ray_direction.z;
-    t_next.z = ((current_cell.z + 1) * _data.cell_size.z - ray_origin_grid.z) /
-               ray_direction.z;
-  } else {
-    delta_t.z = -_data.cell_size.z / ray_direction.z;
-    t_next.z = (current_cell.z * _data.cell_size.z - ray_origin_grid.z) /
-               ray_direction.z;
+  for (size_t a = 0; a < 3; a++) {
+    // the sign bit also decides for -0, whose divisions give -inf
+    bool positive = !std::signbit(ray_direction[a]);
+    step[a] = positive ? 1 : -1;
+    bound_offset[a] = positive ? 1 : 0;
+    delta_t[a] = glm::abs(_data.cell_size[a] / ray_direction[a]);
+    t_next[a] = ((current_cell[a] + bound_offset[a]) * _data.cell_size[a] -
+                 ray_origin_grid[a]) /
+                ray_direction[a];
   }
 
   // iterating trough the cells
-  // ray parrameter of the current intersection
-  float t = 0;
-
-  // std::cout << "start\n";
   while (inside_grid(current_cell)) {
-    // std::cout << "checkt cell: " << current_cell.x << ","<< current_cell.y <<
-    // ","<< current_cell.z << "\n";
-    if (intersect_cell(current_cell, ray)) {
-      return _best_intersection;
+    glm::ivec3 macrocell = current_cell / MACROCELL_SIZE;
+
+    if (!is_occupied(_data.macrocells, macrocell)) {
+      // skip the whole macrocell: find the bound where the ray leaves it
+      vec3 t_exit_axis;
+      for (size_t a = 0; a < 3; a++) {
+        float bound = (macrocell[a] + bound_offset[a]) * MACROCELL_SIZE *
+                      _data.cell_size[a];
+        // a ray parallel to the bound never leaves through it (0 / 0 is nan)
+        t_exit_axis[a] = ray_direction[a] == 0
+                             ? std::numeric_limits<float>::infinity()
+                             : (bound - ray_origin_grid[a]) / ray_direction[a];
+      }
+      uint exit_axis = get_min_axis(t_exit_axis);
+      float t_exit = t_exit_axis[exit_axis];
+
+      // first cell behind the exit point
+      vec3 exit_point = ray_origin_grid + t_exit * ray_direction;
+      for (size_t a = 0; a < 3; a++) {
+        int first = macrocell[a] * MACROCELL_SIZE;
+        if (a == exit_axis) {
+          current_cell[a] =
+              bound_offset[a] ? first + MACROCELL_SIZE : first - 1;
+        } else {
+          current_cell[a] = glm::clamp(
+              static_cast<int>(glm::floor(exit_point[a] / _data.cell_size[a])),
+              first, first + MACROCELL_SIZE - 1);
+        }
+        t_next[a] = ((current_cell[a] + bound_offset[a]) * _data.cell_size[a] -
+                     ray_origin_grid[a]) /
+                    ray_direction[a];
+      }
+      continue;
     }
 
-    // update cell -> one step into direection of smallest t_next
-    if (t_next.x <= t_next.y && t_next.x <= t_next.z) {
-      t = t_next.x;
-      t_next.x += delta_t.x;
-      current_cell.x += step.x;
-    } else if (t_next.y <= t_next.x && t_next.y <= t_next.z) {
-      t = t_next.y;
-      t_next.y += delta_t.y;
-      current_cell.y += step.y;
-    } else if (t_next.z <= t_next.x && t_next.z <= t_next.y) {
-      t = t_next.z;
-      t_next.z += delta_t.z;
-      current_cell.z += step.z;
+    if (is_occupied(_data.occupancy, current_cell) &&
+        intersect_cell(vec3(current_cell), ray, &best)) {
+      // triangles can reach into the next cells, only accept intersections
+      // inside of the current cell.
+      if (best.t <= t_0 + t_next[get_min_axis(t_next)]) {
+        return best;
+      }
     }
+
+    // update cell -> one step into direction of smallest t_next
+    uint axis = get_min_axis(t_next);
+    t_next[axis] += delta_t[axis];
+    current_cell[axis] += step[axis];
   }
 
-  _best_intersection = TriangleIntersection();
-  return _best_intersection;
+  return best;
 }
 
 vec3 UniformGrid::get_cell(vec3 point) {
@@ -179,23 +218,47 @@ vec3 UniformGrid::get_cell(vec3 point) {
   return glm::floor(point_grid / _data.cell_size);
 }
 
-bool UniformGrid::inside_grid(vec3 index) {
+bool UniformGrid::inside_grid(glm::ivec3 index) {
   for (size_t a = 0; a < 3; a++) {
-    if (index[a] < 0 || index[a] > _data.resolution[a] + 1) {
+    if (index[a] < 0 || index[a] >= _data.occupancy.size[a]) {
       return false;
     }
   }
   return true;
 }
 
-bool UniformGrid::intersect_cell(vec3 index, const Ray &ray) {
-  // std::cout << "intersect cell\n";
-  uint64_t morton_code = _data.morton.get_value(index);
+uint UniformGrid::get_min_axis(const vec3 &v) {
+  // bit pattern of the comparisons -> axis with smallest value
+  // see pbrt-v3 GridAccel for the table.
+  static const uint cmp_to_axis[8] = {2, 1, 2, 1, 2, 2, 0, 0};
+  uint bits = ((v.x < v.y) << 2) + ((v.x < v.z) << 1) + (v.y < v.z);
+  return cmp_to_axis[bits];
+}
 
-  if (!_data.grid.contains(morton_code)) {
-    _best_intersection = TriangleIntersection();
-    return false;
-  }
+void UniformGrid::initialize_mask(occupancy_mask *mask, glm::ivec3 size) {
+  mask->size = size;
+  size_t num_cells = static_cast<size_t>(size.x) * size.y * size.z;
+  mask->bits.assign((num_cells + 63) / 64, 0);
+}
+
+void UniformGrid::set_occupied(occupancy_mask *mask, glm::ivec3 index) {
+  size_t i = (static_cast<size_t>(index.z) * mask->size.y + index.y) *
+                 mask->size.x +
+             index.x;
+  mask->bits[i / 64] |= uint64_t(1) << (i % 64);
+}
+
+bool UniformGrid::is_occupied(const occupancy_mask &mask, glm::ivec3 index) {
+  size_t i =
+      (static_cast<size_t>(index.z) * mask.size.y + index.y) * mask.size.x +
+      index.x;
+  return (mask.bits[i / 64] >> (i % 64)) & 1;
+}
+
+bool UniformGrid::intersect_cell(vec3 index, const Ray &ray,
+                                 TriangleIntersection *best) {
+  // std::cout << "intersect cell\n";
+  // empty cells are already filtered by the occupancy mask
   std::vector<uint> *triangle_ids = get_ids(index);
 
   uint best_triangle_id = 0;
@@ -213,9 +276,9 @@ bool UniformGrid::intersect_cell(vec3 index, const Ray &ray) {
   TriangleIntersection res =
       (_data.triangles->data() + best_triangle_id)->intersect_triangle(ray);
 
-  update_intersection(&_best_intersection, res);
+  update_intersection(best, res);
 
-  return _best_intersection.found;
+  return best->found;
 }
 
 bool UniformGrid::update_intersection(
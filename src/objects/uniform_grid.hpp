@@ -11,11 +11,25 @@
 #include <vector>
 
 #include "bvh_tree.hpp"
+#include "memory_stats.hpp"
 #include "morton.hpp"
 #include "triangle.hpp"
 
-// number of cells per axis = grid size + 1
-#define GRID_SIZE 100
+// default number of cells per axis = grid size + 1
+#define UNIFORM_GRID_SIZE 100
+
+// number of grid cells per axis that are combined into one macrocell. Empty
+// macrocells are skipped by the DDA in a single step.
+#define MACROCELL_SIZE 8
+
+/// @brief bit-packed occupancy flags of a three dimensional array of cells.
+struct occupancy_mask {
+  /// @brief number of cells per axis.
+  glm::ivec3 size = glm::ivec3(0);
+
+  /// @brief one bit per cell, cells are stored x-major.
+  std::vector<uint64_t> bits;
+};
 
 /// @brief struct to store data needed by the uniform grid.
 struct grid_data {
@@ -25,7 +39,7 @@ struct grid_data {
   bvh_box bounds;
 
   /// @brief number of grid cells per axis.
-  vec3 resolution = vec3(GRID_SIZE);
+  vec3 resolution = vec3(UNIFORM_GRID_SIZE);
 
   vec3 cell_size;
 
@@ -35,6 +49,14 @@ struct grid_data {
 
   /// @brief class to calculate morton indices.
   Morton morton;
+
+  /// @brief marks every cell that contains at least one triangle.
+  occupancy_mask occupancy;
+
+  /// @brief marks every macrocell that contains at least one filled cell.
+  occupancy_mask macrocells;
+
+  MemoryAccount memory{MEM_GRID};
 };
 
 // alternative: grid cells in array indexed by morton codes.
@@ -56,8 +78,11 @@ class UniformGrid {
   explicit UniformGrid(std::vector<Triangle>* triangles);
   UniformGrid(const UniformGrid& old);
   UniformGrid& operator=(const UniformGrid& old);
+  UniformGrid(UniformGrid&& old) noexcept;
+  UniformGrid& operator=(UniformGrid&& old) noexcept;
 
-  void build(std::vector<Triangle>* triangles);
+  void build(std::vector<Triangle>* triangles,
+             uint grid_size = UNIFORM_GRID_SIZE);
 
   /**
    * @brief Return best triangle intersection if found.
@@ -86,16 +111,25 @@ class UniformGrid {
   /// @brief calculates the cell corrosponding to a point in space.
   vec3 get_cell(vec3 point);
 
-  /// @brief intersect cell best intersection is saved in _best_intersection
-  bool intersect_cell(vec3 index, const Ray& ray);
+  /// @brief intersect cell, the best intersection is updated in best.
+  bool intersect_cell(vec3 index, const Ray& ray, TriangleIntersection* best);
+
+  // --------------------------------------------------------------------------
+  // occupancy masks
+
+  void initialize_mask(occupancy_mask* mask, glm::ivec3 size);
+  void set_occupied(occupancy_mask* mask, glm::ivec3 index);
+  bool is_occupied(const occupancy_mask& mask, glm::ivec3 index);
+
+  /// @brief returns the axis of the smallest component without branching.
+  uint get_min_axis(const vec3& v);
 
   bool update_intersection(TriangleIntersection* intersect,
                            const TriangleIntersection& new_intersect);
 
-  TriangleIntersection _best_intersection;
 
   /// @brief checks if given cell index is inside the grid.
-  bool inside_grid(vec3 index);
+  bool inside_grid(glm::ivec3 index);
 
   grid_data _data;
 };
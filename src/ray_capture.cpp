@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+
+#include "ray_capture.hpp"
+
+#include <iostream>
+#include <stdexcept>
+
+Ray captured_ray::get_ray() const {
+  return Ray(vec3(origin[0], origin[1], origin[2]),
+             vec3(direction[0], direction[1], direction[2]));
+}
+
+/**
+ * @brief Create the capture file, an existing file gets overwritten.
+ *
+ * @param path path of the capture file.
+ */
+RayCapture::RayCapture(std::string path) {
+  _path = path;
+  _file.open(path, std::ios::binary | std::ios::trunc);
+  if (_file.fail()) {
+    throw std::runtime_error("could not open " + path);
+  }
+  // the count gets written on close
+  ray_capture_header header = {RAY_CAPTURE_MAGIC, RAY_CAPTURE_VERSION, 0};
+  _file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  _buffer.reserve(RAY_CAPTURE_BUFFER);
+}
+
+RayCapture::~RayCapture() { close(); }
+
+void RayCapture::record(const Ray &ray, float t_max, RayType type) {
+  vec3 o = ray.get_origin();
+  vec3 d = ray.get_direction();
+  std::lock_guard<std::mutex> lock(_mutex);
+  _buffer.push_back({{o.x, o.y, o.z}, {d.x, d.y, d.z}, t_max, type});
+  _count++;
+  if (_buffer.size() >= RAY_CAPTURE_BUFFER) {
+    flush();
+  }
+}
+
+uint64_t RayCapture::get_count() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _count;
+}
+
+void RayCapture::close() {
+  if (!_file.is_open()) {
+    return;
+  }
+  flush();
+  ray_capture_header header = {RAY_CAPTURE_MAGIC, RAY_CAPTURE_VERSION,
+                               _count};
+  _file.seekp(0);
+  _file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  _file.close();
+  std::cout << "captured " << _count << " rays in " << _path << "\n";
+}
+
+void RayCapture::flush() {
+  _file.write(reinterpret_cast<const char *>(_buffer.data()),
+              _buffer.size() * sizeof(captured_ray));
+  _buffer.clear();
+}
+
+std::vector<captured_ray> RayCapture::load(std::string path) {
+  std::ifstream file(path, std::ios::binary);
+  ray_capture_header header;
+  if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      header.magic != RAY_CAPTURE_MAGIC ||
+      header.version != RAY_CAPTURE_VERSION) {
+    throw std::runtime_error("no ray capture: " + path);
+  }
+
+  // check the count against the file before allocating the records
+  std::streamoff data_begin = file.tellg();
+  file.seekg(0, std::ios::end);
+  uint64_t data_size = file.tellg() - data_begin;
+  file.seekg(data_begin);
+  if (header.count > data_size / sizeof(captured_ray)) {
+    throw std::runtime_error("ray capture is truncated: " + path);
+  }
+
+  std::vector<captured_ray> rays(header.count);
+  if (!file.read(reinterpret_cast<char *>(rays.data()),
+                 header.count * sizeof(captured_ray))) {
+    throw std::runtime_error("ray capture is truncated: " + path);
+  }
+  for (const captured_ray &ray : rays) {
+    if (ray.type >= RAY_TYPE_COUNT) {
+      throw std::runtime_error("ray capture has unknown ray types: " + path);
+    }
+  }
+  return rays;
+}
+
+std::string RayCapture::get_name(RayType type) {
+  switch (type) {
+    case RAY_PRIMARY:
+      return "primary";
+    case RAY_REFLECTION:
+      return "reflection";
+    case RAY_SHADOW:
+      return "shadow";
+  }
+  return "unknown";
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "objects/ray.hpp"
+
+#define RAY_CAPTURE_MAGIC 0x59415252  // "RRAY"
+#define RAY_CAPTURE_VERSION 1
+
+// rays collected before they get written to the file
+#define RAY_CAPTURE_BUFFER 65536
+
+enum RayType : uint32_t { RAY_PRIMARY = 0, RAY_REFLECTION = 1, RAY_SHADOW = 2 };
+
+#define RAY_TYPE_COUNT 3
+
+/// @brief a ray as stored in the capture file (32 bytes).
+struct captured_ray {
+  float origin[3];
+  float direction[3];
+  /// @brief MAXFLOAT for closest hit rays, distance to the light for shadows.
+  float t_max;
+  RayType type;
+
+  Ray get_ray() const;
+};
+
+struct ray_capture_header {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t count;
+};
+
+/**
+ * @brief Writes all rays traced by a render into a binary file.
+ *
+ * The file is a ray_capture_header followed by count captured_ray records.
+ * Replaying the file (see replay) measures the accelerators on the ray
+ * distribution of a real render without shading and camera code.
+ *
+ * record can be called from several threads at once, the rays of different
+ * threads are then stored in the order they arrive.
+ */
+class RayCapture {
+ public:
+  explicit RayCapture(std::string path);
+  ~RayCapture();
+
+  void record(const Ray &ray, float t_max, RayType type);
+  uint64_t get_count();
+
+  /// @brief write the remaining rays and the final header.
+  void close();
+
+  /// @brief read all rays of a capture file (throws if it is no capture, is
+  /// truncated or has unknown ray types).
+  static std::vector<captured_ray> load(std::string path);
+
+  static std::string get_name(RayType type);
+
+ private:
+  std::string _path;
+  std::ofstream _file;
+  /// @brief guards the buffer, the count and the file while recording.
+  std::mutex _mutex;
+  std::vector<captured_ray> _buffer;
+  uint64_t _count = 0;
+
+  void flush();
+};
@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "benchmark.hpp"
+
+/**
+ * Performance regression suite, renders a fixed set of scenes and compares
+ * build time, render time, rays/s, ray count and image checksum against the
+ * stored baselines. Prints PASS or FAIL per scene and metric and returns 1 if
+ * anything failed or a metric has no baseline (unless --allow-missing is
+ * given). Cases whose scene can't be loaded (e.g. the obj files are not in
+ * data/input) are reported as SKIP.
+ *
+ * usage: regression [--baseline file] [--update] [--allow-missing]
+ *                   [--iterations n] [--case name]
+ *
+ * Baselines depend on the machine, store them with --update on the machine
+ * the suite runs on.
+ */
+
+#define REGRESSION_BASELINE "data/regression/baseline.txt"
+#define REGRESSION_ITERATIONS 5
+
+// a timing fails if it is worse by more than the tolerance and by more than
+// REGRESSION_SIGMA standard deviations of baseline and current run
+#define REGRESSION_TOLERANCE 0.05
+#define REGRESSION_BUILD_TOLERANCE 0.1
+#define REGRESSION_SIGMA 3
+
+struct regression_case {
+  std::string name;
+  std::string scene;
+  int width;
+  int height;
+  int samples;
+};
+
+// small and medium scenes, the camera jitter is hashed from the pixel, so
+// the images are deterministic. synthetic is generated and always available.
+const std::vector<regression_case> regression_cases = {
+    {"synthetic_small", "synthetic", 256, 144, 1},
+    {"performance_small", "performance", 256, 144, 1},
+    {"performance_medium", "performance", 640, 360, 4},
+    {"kathedral_small", "kathedral", 320, 180, 1},
+    {"coffe_house_small", "coffe_house", 320, 180, 1}};
+
+/// @brief measured value of a metric with its standard deviation.
+struct measurement {
+  double value = 0;
+  double spread = 0;
+};
+
+enum metric_kind { LOWER_IS_BETTER, HIGHER_IS_BETTER, EXACT };
+
+struct metric {
+  std::string name;
+  metric_kind kind;
+  double tolerance;
+};
+
+const std::vector<metric> metrics = {
+    {"build_time", LOWER_IS_BETTER, REGRESSION_BUILD_TOLERANCE},
+    {"render_time", LOWER_IS_BETTER, REGRESSION_TOLERANCE},
+    {"mrays_per_sec", HIGHER_IS_BETTER, REGRESSION_TOLERANCE},
+    {"rays", EXACT, 0},
+    {"checksum", EXACT, 0}};
+
+// case -> metric -> measurement
+using measurements = std::map<std::string, std::map<std::string, measurement>>;
+
+struct regression_options {
+  std::string baseline = REGRESSION_BASELINE;
+  bool update = false;
+  bool allow_missing = false;
+  int iterations = REGRESSION_ITERATIONS;
+  std::string filter = "";
+};
+
+void print_usage() {
+  std::cerr << "usage: regression [--baseline file] [--update] "
+               "[--allow-missing]\n"
+               "                  [--iterations n] [--case name]\n";
+}
+
+regression_options parse_options(int argc, char **argv) {
+  regression_options options;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--update") {
+      options.update = true;
+      continue;
+    }
+    if (arg == "--allow-missing") {
+      options.allow_missing = true;
+      continue;
+    }
+    if (arg == "--help" || i + 1 >= argc) {
+      print_usage();
+      exit(arg == "--help" ? 0 : 1);
+    }
+
+    std::string value = argv[++i];
+    if (arg == "--baseline") {
+      options.baseline = value;
+    } else if (arg == "--iterations") {
+      options.iterations = std::max(2, std::stoi(value));
+    } else if (arg == "--case") {
+      options.filter = value;
+    } else {
+      print_usage();
+      exit(1);
+    }
+  }
+  return options;
+}
+
+/// @brief median and standard deviation (from the median absolute deviation).
+measurement get_measurement(std::vector<float> values) {
+  measurement result;
+  if (values.empty()) {
+    return result;
+  }
+  std::sort(values.begin(), values.end());
+  result.value = values[values.size() / 2];
+
+  std::vector<float> deviations;
+  for (float v : values) {
+    deviations.push_back(std::abs(v - result.value));
+  }
+  std::sort(deviations.begin(), deviations.end());
+  result.spread = 1.4826 * deviations[deviations.size() / 2];
+  return result;
+}
+
+std::map<std::string, measurement> run_case(const regression_case &c,
+                                            int iterations) {
+  bench_options options;
+  options.scene = c.scene;
+  options.width = c.width;
+  options.height = c.height;
+  options.samples = c.samples;
+  options.warmup = 1;
+  options.iterations = iterations;
+  bench_result result = run_benchmark(options);
+
+  std::map<std::string, measurement> values;
+  values["build_time"] = {result.build_time, 0};
+  values["render_time"] = get_measurement(result.render_times);
+
+  std::vector<float> rays_per_sec;
+  for (float t : result.render_times) {
+    rays_per_sec.push_back(result.rays / t / 1000000.0);
+  }
+  values["mrays_per_sec"] = get_measurement(rays_per_sec);
+  values["rays"] = {static_cast<double>(result.rays), 0};
+  // 64 bit checksums do not fit into a double, compare the upper 52 bits
+  values["checksum"] = {static_cast<double>(result.checksum >> 12), 0};
+  return values;
+}
+
+// -----------------------------------------------------------------------------
+// baseline file: one line "case metric value spread" per measurement
+
+measurements load_baseline(std::string path) {
+  measurements baseline;
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream stream(line);
+    std::string name;
+    std::string metric_name;
+    measurement m;
+    if (stream >> name >> metric_name >> m.value >> m.spread) {
+      baseline[name][metric_name] = m;
+    }
+  }
+  return baseline;
+}
+
+void save_baseline(std::string path, const measurements &baseline) {
+  std::filesystem::path parent = std::filesystem::path(path).parent_path();
+  if (!parent.empty()) {
+    std::filesystem::create_directories(parent);
+  }
+  std::ofstream file(path);
+  if (file.fail()) {
+    throw std::runtime_error("could not write " + path);
+  }
+  file << "# case metric value spread\n";
+  file << std::setprecision(17);
+  for (const auto &[name, values] : baseline) {
+    for (const auto &[metric_name, m] : values) {
+      file << name << " " << metric_name << " " << m.value << " " << m.spread
+           << "\n";
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+// comparison
+
+/// @brief prints the comparison of one metric and returns true if it passed.
+bool compare(const std::string &name, const metric &m,
+             const measurement &current, const measurement &base) {
+  bool passed = true;
+  std::ostringstream limit;
+  double change = base.value != 0 ? current.value / base.value - 1 : 0;
+
+  if (m.kind == EXACT) {
+    passed = current.value == base.value;
+    limit << "exact";
+  } else {
+    // relative noise of both runs
+    double spread = std::sqrt(base.spread * base.spread +
+                              current.spread * current.spread);
+    double noise = base.value != 0 ? spread / base.value : 0;
+    double allowed = std::max(m.tolerance, REGRESSION_SIGMA * noise);
+    double worse = m.kind == LOWER_IS_BETTER ? change : -change;
+    passed = worse <= allowed;
+    limit << (m.kind == LOWER_IS_BETTER ? "+" : "-") << std::fixed
+          << std::setprecision(1) << allowed * 100 << "%";
+  }
+
+  std::cout << std::left << std::setw(20) << name << std::setw(15) << m.name
+            << std::right << std::setw(17)
+            << std::setprecision(m.kind == EXACT ? 17 : 6)
+            << current.value << "  baseline " << std::setw(17) << base.value
+            << "  " << std::showpos << std::fixed << std::setprecision(1)
+            << std::setw(7) << change * 100 << "%" << std::noshowpos
+            << std::defaultfloat << "  limit " << std::setw(7) << limit.str()
+            << "  " << (passed ? "PASS" : "FAIL") << "\n";
+  return passed;
+}
+
+int main(int argc, char **argv) {
+  regression_options options;
+  try {
+    options = parse_options(argc, argv);
+  } catch (const std::exception &e) {
+    std::cerr << "invalid option: " << e.what() << "\n";
+    print_usage();
+    return 1;
+  }
+
+  // keep stdout for the results, progress of the renderer goes to stderr
+  std::streambuf *stdout_buffer = std::cout.rdbuf(std::cerr.rdbuf());
+
+  measurements baseline = load_baseline(options.baseline);
+  measurements current;
+  // case -> reason
+  std::map<std::string, std::string> skipped;
+  for (const regression_case &c : regression_cases) {
+    if (!options.filter.empty() && options.filter != c.name) {
+      continue;
+    }
+    std::cerr << "regression case " << c.name << "\n";
+    try {
+      current[c.name] = run_case(c, options.iterations);
+    } catch (const std::exception &e) {
+      skipped[c.name] = e.what();
+    }
+  }
+  std::cout.rdbuf(stdout_buffer);
+
+  for (const auto &[name, reason] : skipped) {
+    std::cout << std::left << std::setw(20) << name << std::setw(15)
+              << "load" << std::right << reason << "  SKIP\n";
+  }
+
+  if (options.update) {
+    for (const auto &[name, values] : current) {
+      baseline[name] = values;
+    }
+    save_baseline(options.baseline, baseline);
+    std::cout << "stored baselines in " << options.baseline << "\n";
+    return 0;
+  }
+
+  uint failed = 0;
+  uint missing = 0;
+  for (const auto &[name, values] : current) {
+    for (const metric &m : metrics) {
+      if (baseline.count(name) == 0 || baseline[name].count(m.name) == 0) {
+        std::cout << std::left << std::setw(20) << name << std::setw(15)
+                  << m.name << std::right << "no baseline\n";
+        missing++;
+        continue;
+      }
+      if (!compare(name, m, values.at(m.name), baseline[name][m.name])) {
+        failed++;
+      }
+    }
+  }
+
+  // metrics without a baseline (or only skipped cases) compare nothing
+  bool passed = failed == 0 && !current.empty() &&
+                (missing == 0 || options.allow_missing);
+  std::cout << (passed ? "PASS" : "FAIL") << ": " << failed << " failed, "
+            << missing << " without baseline, " << skipped.size()
+            << " skipped\n";
+  if (missing > 0 && !options.allow_missing) {
+    std::cout << "store the baselines with --update (make regression_update) "
+                 "or pass --allow-missing\n";
+  }
+  return passed ? 0 : 1;
+}
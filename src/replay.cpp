@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "benchmark.hpp"
+#include "ray_capture.hpp"
+
+/**
+ * Replays a ray capture (see bench --capture) against the meshes of a scene
+ * built with every given acceleration structure. Reports build time, replay
+ * throughput and how many rays get the same result as with the reference
+ * structure. Only triangle meshes are intersected, shading, spheres and
+ * planes are left out.
+ *
+ * usage: replay --rays file.rays [--scene name]
+ *               [--algorithms grid,sah,lbvh,hlbvh,mid] [--reference sah]
+ *               [--iterations n] [--triangles n] [--distribution name]
+ *               [--seed n]
+ *
+ * The scene has to be the one the rays were captured in, the generator flags
+ * have to match for the scene "synthetic".
+ */
+
+#define REPLAY_ITERATIONS 3
+
+// hit distances closer than this (relative to the distance) agree
+#define REPLAY_T_EPSILON 1e-4f
+
+struct replay_options {
+  std::string rays = "";
+  bench_options scene;
+  std::vector<std::string> algorithms = {"grid", "sah", "lbvh", "hlbvh",
+                                         "mid"};
+  std::string reference = "sah";
+  int iterations = REPLAY_ITERATIONS;
+};
+
+/// @brief result of one ray, t is MAXFLOAT if nothing was hit.
+struct replay_hit {
+  bool found;
+  float t;
+};
+
+struct replay_result {
+  float build_time = 0;
+  std::vector<float> times;
+  std::vector<replay_hit> hits;
+
+  float get_median_time() const {
+    std::vector<float> sorted = times;
+    std::sort(sorted.begin(), sorted.end());
+    return sorted.empty() ? 0 : sorted[sorted.size() / 2];
+  }
+};
+
+void print_usage() {
+  std::cerr << "usage: replay --rays file.rays [--scene name]\n"
+               "              [--algorithms grid,sah,lbvh,hlbvh,mid] "
+               "[--reference sah]\n"
+               "              [--iterations n] [--triangles n] "
+               "[--distribution name]\n"
+               "              [--seed n]\n";
+}
+
+std::vector<std::string> split(const std::string &value, char delimiter) {
+  std::vector<std::string> parts;
+  std::istringstream stream(value);
+  std::string part;
+  while (std::getline(stream, part, delimiter)) {
+    if (!part.empty()) {
+      parts.push_back(part);
+    }
+  }
+  return parts;
+}
+
+replay_options parse_options(int argc, char **argv) {
+  replay_options options;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--help" || i + 1 >= argc) {
+      print_usage();
+      exit(arg == "--help" ? 0 : 1);
+    }
+
+    std::string value = argv[++i];
+    if (arg == "--rays") {
+      options.rays = value;
+    } else if (arg == "--scene") {
+      options.scene.scene = value;
+    } else if (arg == "--algorithms") {
+      options.algorithms = split(value, ',');
+    } else if (arg == "--reference") {
+      options.reference = value;
+    } else if (arg == "--iterations") {
+      options.iterations = std::max(1, std::stoi(value));
+    } else if (arg == "--triangles") {
+      options.scene.generator.triangles = std::stoull(value);
+    } else if (arg == "--distribution") {
+      if (bench_distributions.find(value) == bench_distributions.end()) {
+        throw std::invalid_argument("unknown distribution: " + value);
+      }
+      options.scene.generator.distribution = bench_distributions.at(value);
+    } else if (arg == "--seed") {
+      options.scene.generator.seed = std::stoul(value);
+    } else {
+      print_usage();
+      exit(1);
+    }
+  }
+
+  if (options.rays.empty()) {
+    print_usage();
+    exit(1);
+  }
+  for (const std::string &algorithm : options.algorithms) {
+    if (bench_algorithms.find(algorithm) == bench_algorithms.end()) {
+      throw std::invalid_argument("unknown algorithm: " + algorithm);
+    }
+  }
+  if (bench_algorithms.find(options.reference) == bench_algorithms.end()) {
+    throw std::invalid_argument("unknown algorithm: " + options.reference);
+  }
+  return options;
+}
+
+/**
+ * @brief Trace the rays in captured order, closest hit for primary and
+ * reflection rays and a hit closer than t_max for shadow rays (like the
+ * renderer, which does not stop at the first hit either).
+ */
+void replay_rays(Scene *scene, const std::vector<captured_ray> &rays,
+                 std::vector<replay_hit> *hits) {
+  size_t meshes = scene->get_mesh_count();
+  for (size_t r = 0; r < rays.size(); r++) {
+    Ray ray = rays[r].get_ray();
+    replay_hit best = {false, MAXFLOAT};
+    for (size_t m = 0; m < meshes; m++) {
+      TriangleIntersection hit =
+          scene->get_obj_mesh(m)->intersect_triangles(ray);
+      if (hit.found && hit.t < best.t) {
+        best = {true, hit.t};
+      }
+    }
+    if (rays[r].type == RAY_SHADOW) {
+      best.found = best.found && best.t < rays[r].t_max;
+    }
+    (*hits)[r] = best;
+  }
+}
+
+replay_result run_algorithm(Scene *scene, const std::vector<captured_ray> &rays,
+                            Algorithm algorithm, int iterations) {
+  replay_result result;
+  for (size_t m = 0; m < scene->get_mesh_count(); m++) {
+    Mesh *mesh = scene->get_obj_mesh(m);
+    mesh->set_algorithm(algorithm);
+    result.build_time += mesh->get_stats().time_building;
+  }
+
+  result.hits.resize(rays.size());
+  // warmup, also the result used for the comparison
+  replay_rays(scene, rays, &result.hits);
+
+  std::vector<replay_hit> hits(rays.size());
+  for (int i = 0; i < iterations; i++) {
+    std::chrono::steady_clock::time_point begin =
+        std::chrono::steady_clock::now();
+    replay_rays(scene, rays, &hits);
+    std::chrono::steady_clock::time_point end =
+        std::chrono::steady_clock::now();
+    result.times.push_back(std::chrono::duration<float>(end - begin).count());
+  }
+  return result;
+}
+
+bool agrees(const captured_ray &ray, const replay_hit &hit,
+            const replay_hit &reference) {
+  if (hit.found != reference.found) {
+    return false;
+  }
+  // shadow rays only need the same visibility
+  if (!hit.found || ray.type == RAY_SHADOW) {
+    return true;
+  }
+  return std::abs(hit.t - reference.t) <=
+         REPLAY_T_EPSILON * std::max(1.f, reference.t);
+}
+
+int main(int argc, char **argv) {
+  replay_options options;
+  std::vector<captured_ray> rays;
+  try {
+    options = parse_options(argc, argv);
+    rays = RayCapture::load(options.rays);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  std::array<uint64_t, RAY_TYPE_COUNT> type_counts = {};
+  for (const captured_ray &ray : rays) {
+    type_counts[ray.type]++;
+  }
+
+  // keep stdout for the results, progress of the renderer goes to stderr
+  std::streambuf *stdout_buffer = std::cout.rdbuf(std::cerr.rdbuf());
+  Scene scene;
+  try {
+    scene = load_scene(options.scene);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  replay_result reference =
+      run_algorithm(&scene, rays, bench_algorithms.at(options.reference), 0);
+  std::vector<replay_result> results;
+  for (const std::string &algorithm : options.algorithms) {
+    std::cerr << "replay " << algorithm << "\n";
+    results.push_back(run_algorithm(
+        &scene, rays, bench_algorithms.at(algorithm), options.iterations));
+  }
+  std::cout.rdbuf(stdout_buffer);
+
+  std::cout << rays.size() << " rays of " << options.scene.scene << ":";
+  for (int t = 0; t < RAY_TYPE_COUNT; t++) {
+    std::cout << " " << type_counts[t] << " "
+              << RayCapture::get_name(static_cast<RayType>(t));
+  }
+  std::cout << "\nreference: " << options.reference << "\n\n";
+
+  std::cout << std::left << std::setw(10) << "algorithm" << std::right
+            << std::setw(12) << "build [s]" << std::setw(12) << "replay [s]"
+            << std::setw(10) << "Mrays/s" << std::setw(10) << "hits"
+            << std::setw(12) << "agreement" << std::setw(12) << "mismatches"
+            << "\n";
+  for (size_t a = 0; a < results.size(); a++) {
+    const replay_result &result = results[a];
+    uint64_t hits = 0;
+    uint64_t mismatches = 0;
+    for (size_t r = 0; r < rays.size(); r++) {
+      hits += result.hits[r].found;
+      mismatches += !agrees(rays[r], result.hits[r], reference.hits[r]);
+    }
+    float time = result.get_median_time();
+    double count = std::max<size_t>(rays.size(), 1);
+    std::cout << std::left << std::setw(10) << options.algorithms[a]
+              << std::right << std::fixed << std::setprecision(3)
+              << std::setw(12) << result.build_time << std::setw(12) << time
+              << std::setw(10) << (time > 0 ? rays.size() / time / 1e6 : 0)
+              << std::setprecision(2) << std::setw(9) << hits / count * 100
+              << "%" << std::setw(11)
+              << (1 - mismatches / count) * 100 << "%" << std::setw(12)
+              << mismatches << std::defaultfloat << "\n";
+  }
+  return 0;
+}
@@ -6,13 +6,21 @@
 
 #include <time.h>
 
+#include <algorithm>
+#include <bit>
 #include <chrono>
+#include <execution>
 #include <fstream>
 #include <glm/gtx/string_cast.hpp>
 #include <memory>
 #include <string>
+#include <utility>
 
+#include "objects/hash.hpp"
+#include "objects/perf_counters.hpp"
 #include "objects/plane.hpp"
+#include "objects/timeline.hpp"
+#include "wavefront.hpp"
 
 using std::fstream;
 
@@ -33,6 +41,7 @@ Scene::Scene(vec3 standart_color) {
 
 Scene::Scene(const Scene &old_scene) {
   _lights = old_scene._lights;
+  _area_lights = old_scene._area_lights;
   _obj_planes = old_scene._obj_planes;
   _obj_spheres = old_scene._obj_spheres;
   _obj_meshes = old_scene._obj_meshes;
@@ -41,10 +50,16 @@ Scene::Scene(const Scene &old_scene) {
   _standart_light = old_scene._standart_light;
   _tonemapping_gray = old_scene._tonemapping_gray;
   _aliasing_positions = old_scene._aliasing_positions;
+  _aov_prefix = old_scene._aov_prefix;
+  _capture_path = old_scene._capture_path;
+  _integrator = old_scene._integrator;
+  _primary_packets = old_scene._primary_packets;
+  _use_light_tree = old_scene._use_light_tree;
 }
 
 Scene &Scene::operator=(const Scene &old_scene) {
   _lights = old_scene._lights;
+  _area_lights = old_scene._area_lights;
   _obj_planes = old_scene._obj_planes;
   _obj_spheres = old_scene._obj_spheres;
   _obj_meshes = old_scene._obj_meshes;
@@ -53,6 +68,11 @@ Scene &Scene::operator=(const Scene &old_scene) {
   _standart_light = old_scene._standart_light;
   _tonemapping_gray = old_scene._tonemapping_gray;
   _aliasing_positions = old_scene._aliasing_positions;
+  _aov_prefix = old_scene._aov_prefix;
+  _capture_path = old_scene._capture_path;
+  _integrator = old_scene._integrator;
+  _primary_packets = old_scene._primary_packets;
+  _use_light_tree = old_scene._use_light_tree;
 
   return *this;
 }
@@ -68,6 +88,17 @@ size_t Scene::add_light(Pointlight light) {
   return _lights.size() - 1;
 }
 
+/**
+ * @brief Add an AreaLight to the scene.
+ *
+ * @param light
+ * @return size_t id of the area light.
+ */
+size_t Scene::add_light(AreaLight light) {
+  _area_lights.push_back(light);
+  return _area_lights.size() - 1;
+}
+
 /**
  * @brief Add a plane to the scene.
  *
@@ -75,7 +106,7 @@ size_t Scene::add_light(Pointlight light) {
  * @return size_t id of plane
  */
 size_t Scene::add_object(Plane plane) {
-  _obj_planes.push_back(plane);
+  _obj_planes.push_back(std::move(plane));
   return _obj_planes.size() - 1;
 }
 
@@ -86,7 +117,7 @@ size_t Scene::add_object(Plane plane) {
  * @return size_t id of plane
  */
 size_t Scene::add_object(Sphere sphere) {
-  _obj_spheres.push_back(sphere);
+  _obj_spheres.push_back(std::move(sphere));
   return _obj_spheres.size() - 1;
 }
 
@@ -97,13 +128,23 @@ size_t Scene::add_object(Sphere sphere) {
  * @return size_t id of mesh
  */
 size_t Scene::add_object(Mesh mesh) {
-  _obj_meshes.push_back(mesh);
+  _obj_meshes.push_back(std::move(mesh));
   return _obj_meshes.size() - 1;
 }
 
 void Scene::rotate_obj_mesh(size_t id, vec3 axis, float degree) {
   _obj_meshes.at(id).rotate(axis, degree);
 }
+size_t Scene::get_mesh_count(void) { return _obj_meshes.size(); }
+
+Scene_stats Scene::get_stats(void) {
+  Scene_stats stats = _stats;
+  for (const render_scratch &scratch : _scratch) {
+    stats.rays += scratch.rays;
+  }
+  return stats;
+}
+
 Mesh *Scene::get_obj_mesh(size_t id) {
   std::cout << "mesh size: " << _obj_meshes.size() << "\n";
   return &_obj_meshes.at(id);
@@ -149,6 +190,16 @@ void Scene::set_tonemapping_value(float tonemapping_gray) {
   _tonemapping_gray = tonemapping_gray;
 }
 
+void Scene::set_aov_output(std::string prefix) { _aov_prefix = prefix; }
+
+void Scene::set_ray_capture(std::string path) { _capture_path = path; }
+
+void Scene::set_integrator(Integrator integrator) { _integrator = integrator; }
+
+void Scene::set_primary_packets(bool enable) { _primary_packets = enable; }
+
+void Scene::set_light_tree(bool enable) { _use_light_tree = enable; }
+
 /**
  * @brief Get pointer to the camera in the scene.
  *
@@ -157,14 +208,66 @@ void Scene::set_tonemapping_value(float tonemapping_gray) {
 Camera *Scene::get_camera(void) { return &_camera; }
 
 /**
- * @brief Check if a Ray intersects with an Object in the Scene.
+ * @brief Shadow test of the rays from one point to every light.
  *
- * @param ray
- * @param t_max maximum length of ray to check.
- * @return true if intersection found
- * @return false else
+ * The rays are traced in packets of RAY_PACKET_SIZE lights, so every mesh is
+ * traversed once per packet instead of once per light. Lights that add no
+ * light at the point don't get a shadow ray.
+ *
+ * @param terms phong terms of every light.
+ * @param occluded set to 1 for every light with an object in front of it.
  */
-bool Scene::check_intersection(Ray ray, float t_max) {
+void Scene::check_shadow_rays(const std::vector<phong_terms> &terms,
+                              std::vector<uint8_t> *occluded) {
+  PERF_SCOPE(PERF_SHADOW);
+  render_scratch &scratch = get_scratch();
+  occluded->assign(terms.size(), 0);
+  ray_packet packet;
+  float t_max[RAY_PACKET_SIZE];
+  uint8_t packet_occluded[RAY_PACKET_SIZE];
+  for (size_t start = 0; start < terms.size(); start += RAY_PACKET_SIZE) {
+    uint open = 0;
+    for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+      size_t l = start + lane;
+      packet.active[lane] = 0;
+      packet_occluded[lane] = 0;
+      if (l >= terms.size() || terms[l].unshadowed == vec3(0)) {
+        continue;
+      }
+      const Ray &ray = terms[l].ray_to_light;
+      packet.set(lane, ray);
+      t_max[lane] = terms[l].distance;
+      scratch.rays++;
+      if (_capture) {
+        _capture->record(ray, t_max[lane], RAY_SHADOW);
+      }
+      TraversalStats::get_pixel_counters().shadow_rays++;
+
+      for (size_t i = 0; i < _obj_spheres.size() && !packet_occluded[lane];
+           i++) {
+        packet_occluded[lane] =
+            (_obj_spheres.data() + i)->intersect_bool(ray, t_max[lane]);
+      }
+      for (size_t i = 0; i < _obj_planes.size() && !packet_occluded[lane];
+           i++) {
+        packet_occluded[lane] =
+            (_obj_planes.data() + i)->intersect_bool(ray, t_max[lane]);
+      }
+      open += !packet_occluded[lane];
+    }
+
+    for (size_t i = 0; i < _obj_meshes.size() && open > 0; i++) {
+      (_obj_meshes.data() + i)->occluded_packet(packet, t_max, packet_occluded);
+    }
+    for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+      if (start + lane < terms.size()) {
+        (*occluded)[start + lane] = packet_occluded[lane];
+      }
+    }
+  }
+}
+
+bool Scene::intersect_any(const Ray &ray, float t_max) {
   for (size_t i = 0; i < _obj_spheres.size(); i++) {
     if ((_obj_spheres.data() + i)->intersect_bool(ray, t_max)) {
       return true;
@@ -188,9 +291,15 @@ bool Scene::check_intersection(Ray ray, float t_max) {
 /**
  * @brief Render an Image of the Scene.
  *
+ * The image is rendered in tiles, the tiles of a strip in parallel. If a
+ * writer is given, every finished strip of tiles gets streamed to the file
+ * (after rendering if tonemapping is used).
+ *
+ * @param writer optional writer of the output file.
  * @return Image rendered image.
  */
-Image Scene::trace_image() {
+Image Scene::trace_image(ImageWriter *writer) {
+  TIMELINE_ZONE("render");
   // initialize_objects();
   Image image = Image(_camera.get_resolution().x, _camera.get_resolution().y);
 
@@ -199,14 +308,39 @@ Image Scene::trace_image() {
 
   uint count_pix = 0;
 
+  std::unique_ptr<AovLayers> aovs;
+  if (!_aov_prefix.empty()) {
+    aovs = std::make_unique<AovLayers>(resolution[0], resolution[1]);
+  }
+  if (!_capture_path.empty()) {
+    _capture = std::make_unique<RayCapture>(_capture_path);
+  }
+  if (_use_light_tree && _lights.size() >= LIGHT_TREE_MIN_LIGHTS) {
+    _light_tree = LightTree(_lights);
+  }
+  // cost layers need the counters of every single pixel, area lights and
+  // light cuts are only used by the recursive integrator
+  std::unique_ptr<WavefrontIntegrator> wavefront;
+  if (_integrator == IWAVEFRONT && !aovs && _area_lights.empty() &&
+      _light_tree.empty()) {
+    wavefront = std::make_unique<WavefrontIntegrator>(this);
+  }
+
   // start time
   std::chrono::steady_clock::time_point begin =
       std::chrono::steady_clock::now();
   std::cout << "------------------------------------------------\n";
   std::cout << "rendering\n\n";
 
-  // #pragma omp parallel for num_threads(5)
-  for (int x = 0; x < resolution[0]; x++) {
+  // x start of the tiles of a strip
+  std::vector<int> tiles;
+  for (int x_start = 0; x_start < resolution[0]; x_start += RENDER_TILE_SIZE) {
+    tiles.push_back(x_start);
+  }
+
+  // strips of tiles from the top row of the image to the bottom
+  for (int y_end = resolution[1]; y_end > 0; y_end -= RENDER_TILE_SIZE) {
+    int y_start = std::max(0, y_end - RENDER_TILE_SIZE);
 #ifdef PRINT_PROGRESS
     std::cout << "\e[2K\e[1A"
               << "Progress: "
@@ -215,25 +349,34 @@ Image Scene::trace_image() {
               << "%\n";
 #endif
 
-    for (int y = 0; y < resolution[1]; y++) {
-      // get color from ray
-      vec3 color = vec3(0, 0, 0);
-      for (size_t i = 0; i < _aliasing_positions.size(); i++) {
-        vec3 light =
-            get_light(_camera.get_ray({x, y}, _aliasing_positions.at(i), 0.2));
+    if (wavefront) {
+      wavefront->trace_rows(y_start, y_end, &image);
+    } else {
+      std::for_each(std::execution::par, tiles.begin(), tiles.end(),
+                    [&](int x_start) {
+                      int x_end = std::min(resolution[0],
+                                           x_start + RENDER_TILE_SIZE);
+                      trace_tile({x_start, y_start}, {x_end, y_end}, &image,
+                                 aovs.get());
+                    });
+    }
+    count_pix += (y_end - y_start) * resolution[0];
 
-        if (light.x == -1) {
-          light = _standart_light;
-        }
-        light *= 1.f / _aliasing_positions.size();
-        color += light;
-      }
-      image.set_pixel({x, y}, color);
-      count_pix++;
+    if (writer != nullptr && _tonemapping_gray <= 0) {
+      image.write_rows(writer, y_end - y_start);
     }
   }
+  // keep the ray counts, the scratch of the threads is rebuilt next time
+  for (const render_scratch &scratch : _scratch) {
+    _stats.rays += scratch.rays;
+  }
+  _scratch.clear();
+  _light_tree = LightTree();
   if (_tonemapping_gray > 0) {
     image.apply_tonemapping(_tonemapping_gray);
+    if (writer != nullptr) {
+      image.write_rows(writer, resolution[1]);
+    }
   }
   // stop and print time
   std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
@@ -242,9 +385,13 @@ Image Scene::trace_image() {
            .count()) /
       1000000.0;
   std::cout << "Time for rendering (sec) = " << _stats.time_rendering << "\n";
+  if (aovs) {
+    aovs->write_to_files(_aov_prefix);
+  }
+  _capture.reset();
   std::cout << "------------------------------------------------\n";
 #if GET_STATS
-  for (Mesh m : _obj_meshes) {
+  for (Mesh &m : _obj_meshes) {
     _stats.time_build = m.get_stats().time_building;
     m.print_stats();
     m.print_triangle_stats();
@@ -257,20 +404,162 @@ Image Scene::trace_image() {
 }
 
 /**
- * @brief Caluclate phong wiht diffuse, specular and ambient light.
+ * @brief Trace the pixels [start, end) on the calling thread.
+ *
+ * @param start upper left pixel.
+ * @param end pixel after the lower right one.
+ * @param image image to store the colors in.
+ * @param aovs optional cost layers.
+ */
+void Scene::trace_tile(point start, point end, Image *image,
+                       AovLayers *aovs) {
+  TIMELINE_ZONE("render tile");
+#if TILE_FRUSTUM_CULLING
+  update_entry_nodes(start, end);
+#endif
+  if (_primary_packets && aovs == nullptr) {
+    for (int y = start.y; y < end.y; y += RAY_PACKET_WIDTH) {
+      for (int x = start.x; x < end.x; x += RAY_PACKET_WIDTH) {
+        point size = {std::min(RAY_PACKET_WIDTH, end.x - x),
+                      std::min(RAY_PACKET_WIDTH, end.y - y)};
+        trace_packet({x, y}, size, image);
+      }
+    }
+    return;
+  }
+  for (int y = start.y; y < end.y; y++) {
+    for (int x = start.x; x < end.x; x++) {
+      trace_pixel({x, y}, image, aovs);
+    }
+  }
+}
+
+/**
+ * @brief Trace a pixel and store its cost in the AOV layers if given.
+ *
+ * @param pixel pixel cordinate as {x, y}.
+ * @param image image to store the color in.
+ * @param aovs optional cost layers.
+ */
+void Scene::trace_pixel(point pixel, Image *image, AovLayers *aovs) {
+  if (aovs == nullptr) {
+    image->set_pixel(pixel, get_pixel_color(pixel));
+    return;
+  }
+
+  TraversalStats::get_pixel_counters() = pixel_counters();
+  std::chrono::steady_clock::time_point begin =
+      std::chrono::steady_clock::now();
+  image->set_pixel(pixel, get_pixel_color(pixel));
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+  aovs->set_pixel(pixel, TraversalStats::get_pixel_counters(),
+                  std::chrono::duration<float>(end - begin).count());
+}
+
+/// @brief scratch of the calling thread.
+render_scratch &Scene::get_scratch() { return _scratch.local(); }
+
+void Scene::update_entry_nodes(point start, point end) {
+  TIMELINE_ZONE("frustum culling");
+  frustum f = _camera.get_tile_frustum(vec2(start.x, start.y),
+                                       vec2(end.x, end.y));
+  std::vector<uint> &entry_nodes = get_scratch().entry_nodes;
+  entry_nodes.resize(_obj_meshes.size());
+  for (size_t i = 0; i < _obj_meshes.size(); i++) {
+    entry_nodes[i] = _obj_meshes[i].get_entry_node(f);
+  }
+}
+
+/// @brief entry node for rays of the current tile of the calling thread
+/// (only camera rays).
+uint Scene::get_entry_node(size_t mesh_id, RayType type) {
+  if (type != RAY_PRIMARY) {
+    return 0;
+  }
+  const std::vector<uint> &entry_nodes = get_scratch().entry_nodes;
+  return entry_nodes.empty() ? 0 : entry_nodes[mesh_id];
+}
+
+/**
+ * @brief Trace a block of pixels with one packet of camera rays per aliasing
+ * position (the colors are the same as the ones of get_pixel_color).
+ *
+ * @param pixel first pixel of the block as {x, y}.
+ * @param size {width, height} of the block (at most RAY_PACKET_WIDTH).
+ * @param image image to store the colors in.
+ */
+void Scene::trace_packet(point pixel, point size, Image *image) {
+  ray_packet packet;
+  vec3 colors[RAY_PACKET_SIZE] = {};
+  vec3 lights[RAY_PACKET_SIZE];
+  for (size_t i = 0; i < _aliasing_positions.size(); i++) {
+    _camera.get_ray_packet(vec2(pixel.x, pixel.y), vec2(size.x, size.y),
+                           _aliasing_positions.at(i), 0.2, &packet);
+    get_light_packet(packet, lights);
+    for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+      vec3 light = lights[lane];
+      if (light.x == -1) {
+        light = _standart_light;
+      }
+      light *= 1.f / _aliasing_positions.size();
+      colors[lane] += light;
+    }
+  }
+  for (int y = 0; y < size.y; y++) {
+    for (int x = 0; x < size.x; x++) {
+      image->set_pixel({pixel.x + x, pixel.y + y},
+                       colors[y * RAY_PACKET_WIDTH + x]);
+    }
+  }
+}
+
+/**
+ * @brief Get color of a pixel averaged over all aliasing positions.
+ *
+ * @param pixel pixel cordinate as {x, y}.
+ * @return vec3 color of the pixel.
+ */
+vec3 Scene::get_pixel_color(point pixel) {
+  vec3 color = vec3(0, 0, 0);
+  for (size_t i = 0; i < _aliasing_positions.size(); i++) {
+    vec3 light =
+        get_light(_camera.get_ray(vec2(pixel.x, pixel.y),
+                                  _aliasing_positions.at(i), 0.2));
+
+    if (light.x == -1) {
+      light = _standart_light;
+    }
+    light *= 1.f / _aliasing_positions.size();
+    color += light;
+  }
+  return color;
+}
+
+/**
+ * @brief Caluclate phong wiht diffuse, specular and ambient light, the shadow
+ * ray is traced by the caller.
  *
  * @param light Lightsource to get light from.
  * @param material
  * @param point Point where light get's reflected.
  * @param normal surface normal at given point.
  * @param viewing_direction
- * @return vec3
+ * @return phong_terms
  */
-vec3 Scene::get_phong(const Pointlight &light, const Material &material,
-                      vec3 point, vec3 normal, vec3 viewing_direction) {
-  vec3 incoming_light = light.get_color();
+phong_terms Scene::get_phong_terms(const Pointlight &light,
+                                   const Material &material, vec3 point,
+                                   vec3 normal, vec3 viewing_direction) {
+  return get_phong_terms(light.get_position(), light.get_color(), material,
+                         point, normal, viewing_direction);
+}
 
-  Ray ray_to_light = Ray(point, light.get_light_direction(point));
+/// @brief get_phong_terms of a light at light_position (e.g. a sample of an
+/// area light).
+phong_terms Scene::get_phong_terms(vec3 light_position, vec3 incoming_light,
+                                   const Material &material, vec3 point,
+                                   vec3 normal, vec3 viewing_direction) {
+  Ray ray_to_light = Ray(point, glm::normalize(light_position - point));
   ray_to_light.move_into_dir(0.01);
 
   vec3 light_direction = ray_to_light.get_direction();
@@ -288,8 +577,6 @@ vec3 Scene::get_phong(const Pointlight &light, const Material &material,
 
   float rdotv = glm::dot(r, viewing_direction);
 
-  vec3 l_material = vec3(0, 0, 0);
-
   vec3 l_ambient = material.color * material.ambient;
   vec3 l_diffuse = material.diffuse * material.color;
 
@@ -300,12 +587,150 @@ vec3 Scene::get_phong(const Pointlight &light, const Material &material,
         material.specular[1] * incoming_light * glm::pow(rdotv, material.pow_m);
   }
 
-  // only ad the ones which are not blocked
-  if (!check_intersection(ray_to_light, light.get_distance(point))) {
-    l_material = incoming_light * ndotl * l_diffuse + ndotl * l_specular;
+  return {ray_to_light, glm::distance(light_position, point),
+          incoming_light * ndotl * l_diffuse + ndotl * l_specular,
+          incoming_light * l_ambient};
+}
+
+/**
+ * @brief Light cut of the point lights (see Lightcuts, Walter et al. 2005).
+ *
+ * Starting at the root of the LightTree, the cluster with the largest error
+ * bound gets replaced by its children until every bound is below
+ * LIGHT_CUT_MAX_ERROR of the estimated light or the cut has
+ * LIGHT_CUT_MAX_SIZE clusters. Every cluster is shaded (and gets one shadow
+ * ray) like its representative light with the color of the whole cluster, so
+ * the cost only grows with the size of the cut. Clusters behind the surface
+ * are never split and only add their ambient light.
+ *
+ * @param material
+ * @param point Point where light get's reflected.
+ * @param normal normalized surface normal at given point.
+ * @param viewing_direction
+ */
+void Scene::add_light_cut(const Material &material, vec3 point, vec3 normal,
+                          vec3 viewing_direction) {
+  // largest diffuse and specular light of a light with color 1 and ndotl 1
+  vec3 l_diffuse = material.diffuse * material.color;
+  float material_bound =
+      std::max({l_diffuse.x, l_diffuse.y, l_diffuse.z}) + material.specular[1];
+
+  std::vector<light_cut_node> &light_cut = get_scratch().light_cut;
+  auto by_error = [](const light_cut_node &a, const light_cut_node &b) {
+    return a.error < b.error;
+  };
+  auto get_estimate = [](const phong_terms &terms) {
+    vec3 light = terms.unshadowed + terms.ambient;
+    return std::max({light.x, light.y, light.z});
+  };
+  // returns the estimated light of the cluster
+  auto add_cluster = [&](uint id) {
+    const light_node &node = _light_tree.get_node(id);
+    light_cut_node cluster = {id, 0,
+                              get_phong_terms(
+                                  _lights[node.representative].get_position(),
+                                  node.color, material, point, normal,
+                                  viewing_direction)};
+    if (node.count > 1) {
+      cluster.error = std::max({node.color.x, node.color.y, node.color.z}) *
+                      material_bound *
+                      _light_tree.get_cos_bound(id, point, normal);
+    }
+    light_cut.push_back(cluster);
+    std::push_heap(light_cut.begin(), light_cut.end(), by_error);
+    return get_estimate(cluster.terms);
+  };
+
+  light_cut.clear();
+  float estimate = add_cluster(0);
+  while (light_cut.size() < LIGHT_CUT_MAX_SIZE &&
+         light_cut.front().error > LIGHT_CUT_MAX_ERROR * estimate) {
+    light_cut_node cluster = light_cut.front();
+    std::pop_heap(light_cut.begin(), light_cut.end(), by_error);
+    light_cut.pop_back();
+    estimate -= get_estimate(cluster.terms);
+
+    const light_node &node = _light_tree.get_node(cluster.node);
+    estimate += add_cluster(node.left);
+    estimate += add_cluster(node.right);
+  }
+  std::vector<phong_terms> &light_terms = get_scratch().light_terms;
+  for (const light_cut_node &cluster : light_cut) {
+    light_terms.push_back(cluster.terms);
   }
+}
 
-  return l_material + incoming_light * l_ambient;
+/**
+ * @brief Light of an area light with stratified, adaptive sampling.
+ *
+ * AREA_LIGHT_MIN_STRATA^2 stratified samples are traced first. If all of
+ * their shadow rays agree (fully lit or in the umbra) their mean is used,
+ * only in the penumbra AREA_LIGHT_MAX_STRATA^2 samples are added. The jitter
+ * is hashed from the point, so every render gives the same image.
+ *
+ * @param light
+ * @param material
+ * @param point Point where light get's reflected.
+ * @param normal surface normal at given point.
+ * @param viewing_direction
+ * @return vec3 mean phong light of the samples.
+ */
+vec3 Scene::get_area_light(const AreaLight &light, const Material &material,
+                           vec3 point, vec3 normal, vec3 viewing_direction) {
+  uint32_t seed = hash_position(std::bit_cast<uint32_t>(point.x),
+                                std::bit_cast<uint32_t>(point.y),
+                                std::bit_cast<uint32_t>(point.z));
+
+  uint occluded = 0;
+  uint traced = 0;
+  vec3 res_light =
+      sample_area_light(light, AREA_LIGHT_MIN_STRATA, seed, material, point,
+                        normal, viewing_direction, &occluded, &traced);
+  uint samples = AREA_LIGHT_MIN_STRATA * AREA_LIGHT_MIN_STRATA;
+
+  // penumbra if the shadow rays disagree
+  if (occluded > 0 && occluded < traced) {
+    res_light +=
+        sample_area_light(light, AREA_LIGHT_MAX_STRATA, seed + 1, material,
+                          point, normal, viewing_direction, &occluded, &traced);
+    samples += AREA_LIGHT_MAX_STRATA * AREA_LIGHT_MAX_STRATA;
+  }
+  return res_light / static_cast<float>(samples);
+}
+
+/**
+ * @brief Sum of the phong light of strata x strata samples of an area light.
+ *
+ * @param occluded number of occluded shadow rays.
+ * @param traced number of traced shadow rays (samples that add light).
+ */
+vec3 Scene::sample_area_light(const AreaLight &light, uint strata,
+                              uint32_t seed, const Material &material,
+                              vec3 point, vec3 normal, vec3 viewing_direction,
+                              uint *occluded, uint *traced) {
+  render_scratch &scratch = get_scratch();
+  std::vector<phong_terms> &light_terms = scratch.light_terms;
+  light_terms.clear();
+  for (uint s = 0; s < strata * strata; s++) {
+    light_terms.push_back(get_phong_terms(
+        light.get_sample_point(s, strata, seed), light.get_color(), material,
+        point, normal, viewing_direction));
+  }
+  check_shadow_rays(light_terms, &scratch.light_occluded);
+
+  vec3 res_light = vec3(0, 0, 0);
+  *occluded = 0;
+  *traced = 0;
+  for (size_t l = 0; l < light_terms.size(); l++) {
+    vec3 l_material = vec3(0, 0, 0);
+    if (!scratch.light_occluded[l]) {
+      l_material = light_terms[l].unshadowed;
+    }
+    res_light += l_material + light_terms[l].ambient;
+    *occluded += scratch.light_occluded[l];
+    *traced += light_terms[l].unshadowed != vec3(0);
+  }
+  return res_light;
 }
 
 /**
@@ -323,7 +748,8 @@ vec3 Scene::get_mirroring_light(Material material, vec3 point, vec3 normal,
   vec3 color = vec3(0, 0, 0);
   if (material.mirror > 0) {
     color =
-        get_light(generate_reflection_ray(point, normal, viewing_direction));
+        get_light(generate_reflection_ray(point, normal, viewing_direction),
+                  RAY_REFLECTION);
     if (color.x == -1) {
       color = vec3(0, 0, 0);
     }
@@ -348,6 +774,7 @@ void Scene::tonemapping(vec3 *light) {
  */
 vec3 Scene::calculate_light(const vec3 &point, const Material &material,
                             vec3 surface_normal, const Ray &ray) {
+  PERF_SCOPE(PERF_SHADING);
   vec3 res_light = vec3(0, 0, 0);
 
   vec3 v = ray.get_direction();
@@ -355,10 +782,28 @@ vec3 Scene::calculate_light(const vec3 &point, const Material &material,
   surface_normal = glm::normalize(surface_normal);
   // calculate light for all lightsources
   vec3 mirror_light = get_mirroring_light(material, point, surface_normal, v);
-  for (Pointlight light : _lights) {
-    vec3 phong_light = get_phong(light, material, point, surface_normal, v);
-
-    res_light += phong_light;
+  render_scratch &scratch = get_scratch();
+  std::vector<phong_terms> &light_terms = scratch.light_terms;
+  light_terms.clear();
+  if (_light_tree.empty()) {
+    for (const Pointlight &light : _lights) {
+      light_terms.push_back(
+          get_phong_terms(light, material, point, surface_normal, v));
+    }
+  } else {
+    add_light_cut(material, point, surface_normal, v);
+  }
+  check_shadow_rays(light_terms, &scratch.light_occluded);
+  for (size_t l = 0; l < light_terms.size(); l++) {
+    // only ad the ones which are not blocked
+    vec3 l_material = vec3(0, 0, 0);
+    if (!scratch.light_occluded[l]) {
+      l_material = light_terms[l].unshadowed;
+    }
+    res_light += l_material + light_terms[l].ambient;
+  }
+  for (const AreaLight &light : _area_lights) {
+    res_light += get_area_light(light, material, point, surface_normal, v);
   }
 
   res_light =
@@ -446,50 +891,127 @@ void Scene::stats_append_csv(std::string path) {
  * @brief Calculates light transport in the scene along a ray.
  *
  * @param ray
+ * @param type kind of the ray for the ray capture.
  * @return amount of light reflected into ray directions.
  */
-vec3 Scene::get_light(const Ray &ray) {
+vec3 Scene::get_light(const Ray &ray, RayType type) {
+  get_scratch().rays++;
+  if (_capture) {
+    _capture->record(ray, MAXFLOAT, type);
+  }
   // calculate object intersections
   Material material;
   Intersection best_intersection = {false, MAXFLOAT, vec3(0, 0, 0),
                                     vec3(0, 0, 0), material};
 
-  // find closest intersection in Scene
-  for (size_t i = 0; i < _obj_spheres.size(); i++) {
-    Intersection intersect = (_obj_spheres.data() + i)->intersect(ray);
+  {
+    PERF_SCOPE(PERF_PRIMARY);
+    // find closest intersection in Scene
+    for (size_t i = 0; i < _obj_spheres.size(); i++) {
+      Intersection intersect = (_obj_spheres.data() + i)->intersect(ray);
 
-    if (intersect.found) {
-      if (intersect.t <= best_intersection.t) {
-        best_intersection = intersect;
+      if (intersect.found) {
+        if (intersect.t <= best_intersection.t) {
+          best_intersection = intersect;
+        }
       }
     }
-  }
-  for (size_t i = 0; i < _obj_planes.size(); i++) {
-    Intersection intersect = (_obj_planes.data() + i)->intersect(ray);
+    for (size_t i = 0; i < _obj_planes.size(); i++) {
+      Intersection intersect = (_obj_planes.data() + i)->intersect(ray);
 
-    if (intersect.found) {
-      if (intersect.t <= best_intersection.t) {
-        best_intersection = intersect;
+      if (intersect.found) {
+        if (intersect.t <= best_intersection.t) {
+          best_intersection = intersect;
+        }
+      }
+    }
+    for (size_t i = 0; i < _obj_meshes.size(); i++) {
+      Mesh *mesh = _obj_meshes.data() + i;
+      Intersection intersect = mesh->get_intersect(
+          mesh->intersect_triangles(ray, get_entry_node(i, type)));
+
+      if (intersect.found) {
+        if (intersect.t <= best_intersection.t) {
+          best_intersection = intersect;
+        }
       }
     }
   }
-  for (size_t i = 0; i < _obj_meshes.size(); i++) {
-    Intersection intersect = (_obj_meshes.data() + i)->intersect(ray);
 
-    if (intersect.found) {
-      if (intersect.t <= best_intersection.t) {
-        best_intersection = intersect;
+  return get_surface_light(best_intersection, ray);
+}
+
+/**
+ * @brief Get light of packet of camera rays, the spheres and planes are
+ * intersected ray by ray, the meshes with the whole packet.
+ *
+ * @param packet
+ * @param light light of every active lane (like get_light).
+ */
+void Scene::get_light_packet(const ray_packet &packet, vec3 *light) {
+  Intersection best_intersection[RAY_PACKET_SIZE];
+  get_scratch().rays += packet.get_active_count();
+  {
+    PERF_SCOPE(PERF_PRIMARY);
+    for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+      if (!packet.active[lane]) {
+        continue;
+      }
+      Ray ray = packet.get_ray(lane);
+      if (_capture) {
+        _capture->record(ray, MAXFLOAT, RAY_PRIMARY);
+      }
+      Intersection &best = best_intersection[lane];
+      for (size_t i = 0; i < _obj_spheres.size(); i++) {
+        Intersection intersect = (_obj_spheres.data() + i)->intersect(ray);
+        if (intersect.found && intersect.t <= best.t) {
+          best = intersect;
+        }
+      }
+      for (size_t i = 0; i < _obj_planes.size(); i++) {
+        Intersection intersect = (_obj_planes.data() + i)->intersect(ray);
+        if (intersect.found && intersect.t <= best.t) {
+          best = intersect;
+        }
+      }
+    }
+
+    TriangleIntersection hits[RAY_PACKET_SIZE];
+    for (size_t i = 0; i < _obj_meshes.size(); i++) {
+      Mesh *mesh = _obj_meshes.data() + i;
+      mesh->intersect_packet(packet, hits, get_entry_node(i, RAY_PRIMARY));
+      for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+        if (packet.active[lane] && hits[lane].found &&
+            hits[lane].t <= best_intersection[lane].t) {
+          best_intersection[lane] = mesh->get_intersect(hits[lane]);
+        }
       }
     }
   }
 
+  for (uint lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+    if (packet.active[lane]) {
+      light[lane] =
+          get_surface_light(best_intersection[lane], packet.get_ray(lane));
+    }
+  }
+}
+
+/**
+ * @brief Light reflected along the ray at its closest intersection.
+ *
+ * @param intersection closest intersection of the ray.
+ * @param ray
+ * @return vec3 light or vec3(-1) if the ray didn't hit anything.
+ */
+vec3 Scene::get_surface_light(const Intersection &intersection,
+                              const Ray &ray) {
 #if NO_SHADING
-  return best_intersection.material.color * vec3(255);
+  return intersection.material.color * vec3(255);
 #endif
-  if (best_intersection.found) {
-    vec3 light =
-        calculate_light(best_intersection.point, best_intersection.material,
-                        best_intersection.normal, ray);
+  if (intersection.found) {
+    vec3 light = calculate_light(intersection.point, intersection.material,
+                                 intersection.normal, ray);
     return light;
   }
   // didn't hit any object
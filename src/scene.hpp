@@ -4,25 +4,90 @@
 
 #pragma once
 
+#include <tbb/enumerable_thread_specific.h>
+
+#include <string>
+#include <utility>
 #include <vector>
 
+#include "aov.hpp"
 #include "image.hpp"
 #include "memory"
+#include "objects/area_light.hpp"
 #include "objects/camera.hpp"
+#include "objects/light_tree.hpp"
 #include "objects/mesh.hpp"
 #include "objects/object.hpp"
 #include "objects/plane.hpp"
 #include "objects/pointlight.hpp"
 #include "objects/sphere.hpp"
+#include "ray_capture.hpp"
 
 // #define DEBUG
 #define PRINT_PROGRESS
 
 #define NO_SHADING false
 
+// width and height of the tiles an image is rendered in
+#define RENDER_TILE_SIZE 32
+
+// start the camera rays of a tile at the deepest BVH node that contains
+// everything the frustum of the tile sees (recursive integrator)
+#define TILE_FRUSTUM_CULLING true
+
+// with set_light_tree scenes with at least this many point lights are shaded
+// with light cuts, fewer lights are always shaded one by one
+#define LIGHT_TREE_MIN_LIGHTS 16
+// a cluster of a light cut is split while its error bound is larger than
+// this fraction of the light of the whole cut
+#define LIGHT_CUT_MAX_ERROR 0.02f
+// most clusters (and shadow rays) in the light cut of a shading point
+#define LIGHT_CUT_MAX_SIZE 64
+
+enum Integrator {
+  /// @brief depth first, every camera ray is shaded before the next one.
+  IRECURSIVE,
+  /// @brief stages over queues of rays, see WavefrontIntegrator.
+  IWAVEFRONT
+};
+
+/// @brief phong light of one light source before the shadow test.
+struct phong_terms {
+  Ray ray_to_light;
+  /// @brief distance to the light, occluders have to be closer.
+  float distance;
+  /// @brief diffuse and specular light if the light is not occluded.
+  vec3 unshadowed;
+  vec3 ambient;
+};
+
+/// @brief cluster of a light cut, shaded like its representative light.
+struct light_cut_node {
+  uint node;
+  /// @brief upper bound of the light of the cluster (0 for single lights).
+  float error;
+  phong_terms terms;
+};
+
+/// @brief state of the shading of one thread (see Scene::get_scratch).
+struct render_scratch {
+  /// @brief BVH entry node of every mesh for the camera rays of the current
+  /// tile (empty: the root).
+  std::vector<uint> entry_nodes;
+  /// @brief lights of the current shading point (calculate_light).
+  std::vector<phong_terms> light_terms;
+  std::vector<uint8_t> light_occluded;
+  /// @brief max heap of the clusters of the current light cut by error.
+  std::vector<light_cut_node> light_cut;
+  /// @brief rays traced by the thread, added to Scene_stats::rays.
+  uint64_t rays = 0;
+};
+
 struct Scene_stats {
-  float time_rendering;
-  float time_build;
+  float time_rendering = 0;
+  float time_build = 0;
+  /// @brief number of traced rays (camera, reflection and shadow rays).
+  uint64_t rays = 0;
 };
 
 class Scene {
@@ -32,14 +97,29 @@ class Scene {
 
   Scene(const Scene &old_scene);
   Scene &operator=(const Scene &old_scene);
+  Scene(Scene &&old_scene) = default;
+  Scene &operator=(Scene &&old_scene) = default;
 
   /***** Adding things to scene *****/
 
   size_t add_light(Pointlight light);
+  size_t add_light(AreaLight light);
   size_t add_object(Plane plane);
   size_t add_object(Sphere sphere);
   size_t add_object(Mesh mesh);
 
+  /**
+   * @brief Construct a mesh directly inside the scene.
+   *
+   * @param args arguments of a Mesh constructor.
+   * @return size_t id of mesh.
+   */
+  template <typename... Args>
+  size_t emplace_mesh(Args &&...args) {
+    _obj_meshes.emplace_back(std::forward<Args>(args)...);
+    return _obj_meshes.size() - 1;
+  }
+
   void rotate_obj_mesh(size_t id, vec3 axis, float degree);
   Mesh *get_obj_mesh(size_t id);
 
@@ -47,22 +127,40 @@ class Scene {
 
   void set_aliasing(uint rays_per_pixel);
   void set_tonemapping_value(float tonemapping_gray);
+  /// @brief write cost layers as <prefix>_<layer> files (empty disables).
+  void set_aov_output(std::string prefix);
+  /// @brief record all rays of the next renders into path (empty disables).
+  void set_ray_capture(std::string path);
+  /// @brief cost layers, scenes with area lights and scenes shaded with light
+  /// cuts are always rendered with IRECURSIVE.
+  void set_integrator(Integrator integrator);
+  /// @brief trace the camera rays of IRECURSIVE in packets of
+  /// RAY_PACKET_WIDTH x RAY_PACKET_WIDTH pixels (same image).
+  void set_primary_packets(bool enable);
+  /// @brief shade scenes with many point lights with light cuts of a
+  /// LightTree (approximates the light, IRECURSIVE only).
+  void set_light_tree(bool enable);
 
   /***** Getters *****/
 
   Camera *get_camera(void);
+  size_t get_mesh_count(void);
+  Scene_stats get_stats(void);
 
-  vec3 get_light(const Ray &ray);
+  vec3 get_light(const Ray &ray, RayType type = RAY_PRIMARY);
 
   void update_view_transform(void);
   void stats_append_csv(std::string path);
 
   /***** Rendering *****/
 
-  Image trace_image();
+  Image trace_image(ImageWriter *writer = nullptr);
 
  private:
+  friend class WavefrontIntegrator;
+
   std::vector<Pointlight> _lights;
+  std::vector<AreaLight> _area_lights;
 
   std::vector<Plane> _obj_planes;
   std::vector<Sphere> _obj_spheres;
@@ -75,15 +173,56 @@ class Scene {
   vec3 _standart_light;
   float _tonemapping_gray = 0.8;
   std::vector<vec2> _aliasing_positions;
-
+  std::string _aov_prefix = "";
+  std::string _capture_path = "";
+  /// @brief open while an image gets rendered with a capture path.
+  std::unique_ptr<RayCapture> _capture;
+  Integrator _integrator = IRECURSIVE;
+  bool _primary_packets = false;
+  bool _use_light_tree = false;
+  /// @brief clusters of _lights while an image gets rendered with light cuts
+  /// (empty: every light is shaded).
+  LightTree _light_tree;
+  /// @brief one per rendering thread, the tiles of a strip are rendered in
+  /// parallel.
+  tbb::enumerable_thread_specific<render_scratch> _scratch;
+
+  render_scratch &get_scratch();
+  vec3 get_pixel_color(point pixel);
+  void trace_tile(point start, point end, Image *image, AovLayers *aovs);
+  void trace_pixel(point pixel, Image *image, AovLayers *aovs);
+  void trace_packet(point pixel, point size, Image *image);
+  /// @brief cull the meshes against the frustum of the tile [start, end).
+  void update_entry_nodes(point start, point end);
+  uint get_entry_node(size_t mesh_id, RayType type);
+  /// @brief get_light of every active lane of a packet of camera rays.
+  void get_light_packet(const ray_packet &packet, vec3 *light);
+  vec3 get_surface_light(const Intersection &intersection, const Ray &ray);
   Ray generate_reflection_ray(vec3 point, vec3 normal, vec3 viewer_direction);
 
   vec3 calculate_light(const vec3 &point, const Material &material,
                        vec3 surface_normal, const Ray &camera_ray);
-  vec3 get_phong(const Pointlight &light, const Material &material, vec3 point,
-                 vec3 normal, vec3 viewing_direction);
+  phong_terms get_phong_terms(const Pointlight &light,
+                              const Material &material, vec3 point,
+                              vec3 normal, vec3 viewing_direction);
+  phong_terms get_phong_terms(vec3 light_position, vec3 incoming_light,
+                              const Material &material, vec3 point,
+                              vec3 normal, vec3 viewing_direction);
+  /// @brief append the terms of the light cut of the point to the light
+  /// terms of the scratch.
+  void add_light_cut(const Material &material, vec3 point, vec3 normal,
+                     vec3 viewing_direction);
+  vec3 get_area_light(const AreaLight &light, const Material &material,
+                      vec3 point, vec3 normal, vec3 viewing_direction);
+  vec3 sample_area_light(const AreaLight &light, uint strata, uint32_t seed,
+                         const Material &material, vec3 point, vec3 normal,
+                         vec3 viewing_direction, uint *occluded,
+                         uint *traced);
   vec3 get_mirroring_light(Material material, vec3 point, vec3 normal,
                            vec3 viewing_direction);
   void tonemapping(vec3 *light);
-  bool check_intersection(Ray ray, float t_max);
+  void check_shadow_rays(const std::vector<phong_terms> &terms,
+                         std::vector<uint8_t> *occluded);
+  /// @brief any hit closer than t_max (without counting the ray).
+  bool intersect_any(const Ray &ray, float t_max);
 };
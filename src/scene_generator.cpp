@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+
+#include "scene_generator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <glm/gtx/transform.hpp>
+#include <iostream>
+#include <numeric>
+
+namespace {
+
+vec3 random_vec3(std::mt19937 *rng, float min, float max) {
+  std::uniform_real_distribution<float> dist(min, max);
+  return vec3(dist(*rng), dist(*rng), dist(*rng));
+}
+
+vec3 random_direction(std::mt19937 *rng) {
+  std::normal_distribution<float> dist(0, 1);
+  vec3 d = vec3(dist(*rng), dist(*rng), dist(*rng));
+  return glm::length(d) > 0 ? glm::normalize(d) : vec3(1, 0, 0);
+}
+
+}  // namespace
+
+SceneGenerator::SceneGenerator(generator_settings settings) {
+  _settings = settings;
+
+  // cluster centers are shared by all chunks
+  std::mt19937 rng(_settings.seed);
+  for (uint i = 0; i < _settings.clusters; i++) {
+    _cluster_centers.push_back(
+        _settings.center +
+        random_vec3(&rng, -0.8 * _settings.extent, 0.8 * _settings.extent));
+  }
+}
+
+/**
+ * @brief Generate the triangles in parallel chunks.
+ *
+ * @return std::vector<Triangle> exactly _settings.triangles triangles.
+ */
+std::vector<Triangle> SceneGenerator::generate_triangles() {
+  std::vector<Triangle> triangles(_settings.triangles);
+  if (_settings.distribution == DNESTED) {
+    generate_nested(&triangles);
+    return triangles;
+  }
+
+  size_t chunks =
+      (_settings.triangles + GENERATOR_CHUNK_SIZE - 1) / GENERATOR_CHUNK_SIZE;
+  std::vector<size_t> ids(chunks);
+  std::iota(ids.begin(), ids.end(), 0);
+  std::for_each(std::execution::par, ids.begin(), ids.end(),
+                [&](size_t chunk) { generate_chunk(&triangles, chunk); });
+  return triangles;
+}
+
+Mesh SceneGenerator::generate_mesh() {
+  return Mesh(generate_triangles(),
+              {.color = vec3(0.8, 0.2, 0.2), .specular = vec3(0.1)},
+              _settings.build);
+}
+
+void SceneGenerator::add_to(Scene *scene) {
+  std::cout << "generating " << _settings.triangles << " triangles and "
+            << _settings.spheres << " spheres\n";
+  if (_settings.triangles > 0) {
+    scene->emplace_mesh(generate_triangles(),
+                        Material{.color = vec3(0.8, 0.2, 0.2),
+                                 .specular = vec3(0.1)},
+                        _settings.build);
+  }
+
+  std::mt19937 rng(_settings.seed + 1);
+  float radius = 0.4 * _settings.extent /
+                 std::cbrt(static_cast<float>(std::max(_settings.spheres, 1u)));
+  for (uint i = 0; i < _settings.spheres; i++) {
+    vec3 position = _settings.center + random_vec3(&rng, -_settings.extent,
+                                                   _settings.extent);
+    scene->add_object(
+        Sphere(position, radius, {.color = random_vec3(&rng, 0.1, 0.9)}));
+  }
+}
+
+Scene SceneGenerator::get_scene() {
+  Scene scene = Scene(vec3(102, 255, 102));
+
+  scene.get_camera()->set_resolution(800, 600);
+  scene.get_camera()->set_sensor_size(1.2, 0.9);
+  scene.set_aliasing(1);
+  scene.set_tonemapping_value(-1);
+
+  float e = _settings.extent;
+  scene.add_light(Pointlight(_settings.center + vec3(-e, 2 * e, 2 * e), 300));
+  add_to(&scene);
+  return scene;
+}
+
+void SceneGenerator::generate_chunk(std::vector<Triangle> *triangles,
+                                    size_t chunk) {
+  std::mt19937 rng(_settings.seed * 7919 + chunk);
+  size_t begin = chunk * GENERATOR_CHUNK_SIZE;
+  size_t end = std::min(begin + GENERATOR_CHUNK_SIZE, triangles->size());
+  for (size_t i = begin; i < end; i++) {
+    (*triangles)[i] = generate_triangle(&rng);
+  }
+}
+
+Triangle SceneGenerator::generate_triangle(std::mt19937 *rng) {
+  float e = _settings.extent;
+  float size = get_spacing() * _settings.triangle_scale;
+  vec3 center = _settings.center + random_vec3(rng, -e, e);
+  vec3 points[3];
+
+  switch (_settings.distribution) {
+    case DCLUSTERED: {
+      // same number of triangles per cluster, so the clusters are denser
+      float sigma = 0.05 * e;
+      std::normal_distribution<float> offset(0, sigma);
+      std::uniform_int_distribution<size_t> cluster(
+          0, _cluster_centers.size() - 1);
+      center = _cluster_centers.at(cluster(*rng)) +
+               vec3(offset(*rng), offset(*rng), offset(*rng));
+      float volume = _cluster_centers.size() * std::pow(4 * sigma, 3);
+      size = std::cbrt(volume / _settings.triangles) * _settings.triangle_scale;
+      for (int v = 0; v < 3; v++) {
+        points[v] = center + random_vec3(rng, -0.5 * size, 0.5 * size);
+      }
+      break;
+    }
+    case DTHIN: {
+      vec3 direction = random_direction(rng);
+      vec3 side = glm::cross(direction, random_direction(rng));
+      side = glm::length(side) > 0 ? glm::normalize(side) : vec3(0, 1, 0);
+      float length =
+          std::uniform_real_distribution<float>(0.125 * e, 0.5 * e)(*rng);
+      points[0] = center - 0.5f * length * direction;
+      points[1] = center + 0.5f * length * direction;
+      points[2] = center + 0.05f * size * side;
+      break;
+    }
+    default:
+      for (int v = 0; v < 3; v++) {
+        points[v] = center + random_vec3(rng, -0.5 * size, 0.5 * size);
+      }
+      break;
+  }
+  return Triangle(points, 0);
+}
+
+/**
+ * @brief Fill triangles with 8^depth transformed copies of a uniform base
+ * mesh. Every level places 8 copies of the level below into the octants of
+ * its cube, each scaled by 0.5 and randomly rotated, so the copies overlap
+ * like instances in a scene graph.
+ */
+void SceneGenerator::generate_nested(std::vector<Triangle> *triangles) {
+  // use less levels than configured if there are not enough triangles
+  uint depth = 0;
+  size_t instances = 1;
+  while (depth < _settings.nesting_depth &&
+         instances * 8 <= triangles->size()) {
+    depth++;
+    instances *= 8;
+  }
+
+  // base mesh in the cube around the origin, the first rest instances get
+  // one triangle more so the count is exact
+  size_t base_size = triangles->size() / instances;
+  size_t rest = triangles->size() % instances;
+  generator_settings base_settings = _settings;
+  base_settings.triangles = base_size + (rest > 0 ? 1 : 0);
+  base_settings.distribution = DUNIFORM;
+  base_settings.center = vec3(0);
+  std::vector<Triangle> base =
+      SceneGenerator(base_settings).generate_triangles();
+
+  // transformation of every instance, level by level
+  std::mt19937 rng(_settings.seed + 2);
+  std::uniform_real_distribution<float> angle(0, 360);
+  std::vector<mat4> transforms = {glm::translate(_settings.center)};
+  for (uint level = 0; level < depth; level++) {
+    std::vector<mat4> children;
+    for (const mat4 &parent : transforms) {
+      for (int octant = 0; octant < 8; octant++) {
+        vec3 offset = vec3(octant & 1 ? 1 : -1, octant & 2 ? 1 : -1,
+                           octant & 4 ? 1 : -1) *
+                      (0.5f * _settings.extent);
+        children.push_back(parent * glm::translate(offset) *
+                           glm::rotate(glm::radians(angle(rng)),
+                                       random_direction(&rng)) *
+                           glm::scale(vec3(0.5)));
+      }
+    }
+    transforms = std::move(children);
+  }
+
+  std::vector<size_t> ids(instances);
+  std::iota(ids.begin(), ids.end(), 0);
+  std::for_each(std::execution::par, ids.begin(), ids.end(), [&](size_t i) {
+    size_t count = base_size + (i < rest ? 1 : 0);
+    size_t first = i * base_size + std::min(i, rest);
+    for (size_t t = 0; t < count; t++) {
+      Triangle triangle = base[t];
+      triangle.apply_transform(transforms[i]);
+      (*triangles)[first + t] = triangle;
+    }
+  });
+}
+
+float SceneGenerator::get_spacing() {
+  return 2 * _settings.extent /
+         std::cbrt(static_cast<float>(std::max<uint64_t>(_settings.triangles,
+                                                         1)));
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <random>
+#include <vector>
+
+#include "objects/mesh.hpp"
+#include "objects/triangle.hpp"
+#include "scene.hpp"
+
+using glm::vec3;
+
+// triangles generated by one task, every chunk has its own random sequence so
+// the result does not depend on the number of threads
+#define GENERATOR_CHUNK_SIZE 65536
+
+enum Distribution {
+  /// @brief triangles uniformly distributed in the cube.
+  DUNIFORM,
+  /// @brief triangles in gaussian clusters with a lot of empty space.
+  DCLUSTERED,
+  /// @brief long and thin triangles in random directions.
+  DTHIN,
+  /// @brief copies of copies of a small mesh, scaled and rotated on every
+  /// level (the flattened form of nested instances).
+  DNESTED
+};
+
+struct generator_settings {
+  uint64_t triangles = 1000000;
+  Distribution distribution = DUNIFORM;
+  uint spheres = 0;
+  uint32_t seed = 1;
+
+  /// @brief center and half edge length of the cube holding the primitives.
+  vec3 center = vec3(0, 0, -3.5);
+  float extent = 1;
+
+  /// @brief edge length of the triangles relative to their mean distance.
+  float triangle_scale = 1;
+  uint clusters = 64;
+  /// @brief levels of DNESTED, every level holds 8 copies of the one below.
+  uint nesting_depth = 3;
+
+  /// @brief acceleration structure of the generated mesh.
+  mesh_build build = ASAH;
+};
+
+/**
+ * @brief Generates meshes and scenes of a given size and triangle
+ * distribution, for measurements independent of downloaded assets.
+ *
+ * The same settings always generate the same primitives.
+ */
+class SceneGenerator {
+ public:
+  explicit SceneGenerator(generator_settings settings);
+
+  std::vector<Triangle> generate_triangles();
+  Mesh generate_mesh();
+
+  /// @brief add the generated mesh and spheres to scene.
+  void add_to(Scene *scene);
+
+  /// @brief scene with camera and light looking at the generated primitives.
+  Scene get_scene();
+
+ private:
+  generator_settings _settings;
+  std::vector<vec3> _cluster_centers;
+
+  void generate_chunk(std::vector<Triangle> *triangles, size_t chunk);
+  Triangle generate_triangle(std::mt19937 *rng);
+  void generate_nested(std::vector<Triangle> *triangles);
+
+  /// @brief mean distance of the triangles in the cube.
+  float get_spacing();
+};
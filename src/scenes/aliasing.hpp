@@ -7,6 +7,8 @@
 #include "../objects/sphere.hpp"
 #include "../scene.hpp"
 
+namespace scenes::aliasing {
+
 inline Scene get_scene() {
   Scene scene = Scene(vec3(255, 255, 255));
 
@@ -29,8 +31,10 @@ inline Scene get_scene() {
   scene.set_aliasing(4);
   scene.set_tonemapping_value(-1);
 
-  scene.add_object(m);
+  scene.add_object(std::move(m));
   scene.add_light(light1);
 
   return scene;
 }
+
+}  // namespace scenes::aliasing
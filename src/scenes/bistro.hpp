@@ -1,6 +1,8 @@
 /*
  * Copyright (c) 2023 Tobias Vonier. All rights reserved.
  */
+#include <optional>
+
 #include "../object_factory.hpp"
 #include "../objects/mesh.hpp"
 #include "../objects/plane.hpp"
@@ -14,7 +16,9 @@
  * VISUALIZE_RANGE: 100, 1200
  */
 
-inline Scene get_scene() {
+namespace scenes::bistro {
+
+inline Scene get_scene(std::optional<mesh_build> build = std::nullopt) {
   Scene scene = Scene(vec3(102, 255, 102));
 
   vec3 origin = vec3(0, 0, 0);
@@ -24,7 +28,7 @@ inline Scene get_scene() {
                 {.color = vec3(0.2, 0.2, 0.2),
                  .ambient = vec3(0.25),
                  .specular = vec3(0.15)},
-                AHLBVH);
+                build.value_or(AHLBVH));
 
   vec3 light = vec3(1, 0.9, 0.9);
   ObjectFactory factory = ObjectFactory(&scene);
@@ -42,7 +46,7 @@ inline Scene get_scene() {
   scene.set_aliasing(1);
   scene.set_tonemapping_value(-1);
 
-  scene.add_object(m);
+  scene.add_object(std::move(m));
   // scene.add_light(light1);
 
   // adjust camera y and z are switched in blender
@@ -61,3 +65,5 @@ inline void animation_step(Scene *scene) {
   scene->get_obj_mesh(0)->rotate(vec3(0, -0.7, -2), vec3(0, 1, 0), 10);
   scene->update_view_transform();
 }
+
+}  // namespace scenes::bistro
@@ -7,6 +7,8 @@
 #include "../objects/sphere.hpp"
 #include "../scene.hpp"
 
+namespace scenes::bvh_test {
+
 inline Scene get_scene() {
   Scene scene = Scene(vec3(255, 255, 255));
 
@@ -29,7 +31,7 @@ inline Scene get_scene() {
   scene.set_aliasing(1);
   scene.set_tonemapping_value(-1);
 
-  scene.add_object(m);
+  scene.add_object(std::move(m));
   scene.add_light(light1);
 
   return scene;
@@ -38,3 +40,5 @@ inline Scene get_scene() {
 inline void animation_step(Scene *scene) {
   scene->rotate_obj_mesh(0, vec3(0, 0, 1), 30);
 }
+
+}  // namespace scenes::bvh_test
@@ -1,24 +1,27 @@
 /*
  * Copyright (c) 2023 Tobias Vonier. All rights reserved.
  */
+#include <optional>
+
 #include "../object_factory.hpp"
 #include "../objects/mesh.hpp"
 #include "../objects/plane.hpp"
 #include "../objects/sphere.hpp"
 #include "../scene.hpp"
 
-inline Scene get_scene() {
+namespace scenes::coffe_house {
+
+inline Scene get_scene(std::optional<mesh_build> build = std::nullopt) {
   Scene scene = Scene(vec3(0));
 
   vec3 origin = vec3(-6, -4, -10);
 
-  vec3 tree_pos = vec3(0, -14, -28);
-
   Mesh house =
       Mesh("data/input/coffe_house", "coffee_house.obj", origin,
-           {.color = vec3(0.32, 0.21, 0.01), .specular = vec3(0.0)}, ASAH);
+           {.color = vec3(0.32, 0.21, 0.01), .specular = vec3(0.0)},
+           build.value_or(ASAH));
 
-  Pointlight light = Pointlight(vec3(0, 10, 0), 350);
+  // Pointlight light = Pointlight(vec3(0, 10, 0), 350);
   // scene.add_light(light);
   Pointlight light1 = Pointlight(vec3(13, 15, 0), 550);
   scene.add_light(light1);
@@ -31,7 +34,7 @@ inline Scene get_scene() {
   scene.set_aliasing(5);
   scene.set_tonemapping_value(-1);
 
-  scene.add_object(house);
+  scene.add_object(std::move(house));
 
   scene.get_obj_mesh(0)->rotate(origin, vec3(0, 1, 0), 20);
   scene.update_view_transform();
@@ -44,3 +47,5 @@ inline void animation_step(Scene *scene) {
   scene->get_camera()->rotate(vec3(0, 0, -5), vec3(0, 1, 0), -20);
   scene->update_view_transform();
 }
+
+}  // namespace scenes::coffe_house
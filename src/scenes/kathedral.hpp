@@ -1,6 +1,8 @@
 /*
  * Copyright (c) 2023 Tobias Vonier. All rights reserved.
  */
+#include <optional>
+
 #include "../object_factory.hpp"
 #include "../objects/mesh.hpp"
 #include "../objects/plane.hpp"
@@ -12,7 +14,9 @@
  * HLBVH: TREELETBITS: 25
  */
 
-inline Scene get_scene() {
+namespace scenes::kathedral {
+
+inline Scene get_scene(std::optional<mesh_build> build = std::nullopt) {
   Scene scene = Scene(vec3(102, 255, 102));
 
   vec3 origin = vec3(0, 0, 0);
@@ -22,7 +26,7 @@ inline Scene get_scene() {
            {.color = vec3(0.2, 0.2, 0.2),
             .ambient = vec3(0.3),
             .specular = vec3(0.15)},
-           ASAH);
+           build.value_or(ASAH));
 
   ObjectFactory factory = ObjectFactory(&scene);
   factory.new_xy_square_light(origin + vec3(0.8, 2, -3), 300, 4, 0.05);
@@ -36,7 +40,7 @@ inline Scene get_scene() {
   scene.set_aliasing(1);
   scene.set_tonemapping_value(-1);
 
-  scene.add_object(m);
+  scene.add_object(std::move(m));
   // scene.add_light(light1);
 
   return scene;
@@ -47,3 +51,5 @@ inline void animation_step(Scene *scene) {
   scene->get_obj_mesh(0)->rotate(vec3(0, -0.7, -2), vec3(0, 1, 0), 10);
   scene->update_view_transform();
 }
+
+}  // namespace scenes::kathedral
@@ -1,6 +1,8 @@
 /*
  * Copyright (c) 2023 Tobias Vonier. All rights reserved.
  */
+#include <optional>
+
 #include "../object_factory.hpp"
 #include "../objects/mesh.hpp"
 #include "../objects/plane.hpp"
@@ -8,7 +10,9 @@
 #include "../scene.hpp"
 
 #define TEXTURE true
-inline Scene get_scene() {
+namespace scenes::kingshall {
+
+inline Scene get_scene(std::optional<mesh_build> build = std::nullopt) {
   Scene scene = Scene(vec3(102, 255, 102));
 
   vec3 origin_plane = vec3(0, -0.7, -2);
@@ -16,7 +20,7 @@ inline Scene get_scene() {
 #if TEXTURE
   Mesh m = Mesh("data/input", "kingshall.obj", origin_plane + vec3(0, 0, -18),
                 {.color = vec3(0.2, 0.2, 0.2), .specular = vec3(0.0)},
-                "data/input/textures/kingshall.png", AHLBVH);
+                "data/input/textures/kingshall.png", build.value_or(AHLBVH));
 #else
   Mesh m = Mesh("data/input/kingshall.obj", origin_plane + vec3(0, 0, -18),
                 {.color = vec3(0.2, 0.2, 0.2), .specular = vec3(0.0)});
@@ -33,7 +37,7 @@ inline Scene get_scene() {
   scene.set_aliasing(1);
   scene.set_tonemapping_value(-1);
 
-  scene.add_object(m);
+  scene.add_object(std::move(m));
   // scene.add_light(light1);
 
   return scene;
@@ -43,3 +47,5 @@ inline void animation_step(Scene *scene) {
   scene->get_camera()->rotate(vec3(0, 0, -5), vec3(0, 1, 0), 5);
   scene->update_view_transform();
 }
+
+}  // namespace scenes::kingshall
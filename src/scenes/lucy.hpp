@@ -7,6 +7,8 @@
 #include "../objects/sphere.hpp"
 #include "../scene.hpp"
 
+namespace scenes::lucy {
+
 inline Scene get_scene() {
   Scene scene = Scene(vec3(102, 255, 102));
 
@@ -27,7 +29,7 @@ inline Scene get_scene() {
   scene.set_aliasing(1);
   scene.set_tonemapping_value(-1);
 
-  scene.add_object(m);
+  scene.add_object(std::move(m));
   // scene.add_light(light1);
 
   return scene;
@@ -38,3 +40,5 @@ inline void animation_step(Scene *scene) {
   scene->get_obj_mesh(0)->rotate(vec3(0, -0.7, -2), vec3(0, 1, 0), 10);
   scene->update_view_transform();
 }
+
+}  // namespace scenes::lucy
@@ -5,6 +5,8 @@
 #include "../objects/sphere.hpp"
 #include "../scene.hpp"
 
+namespace scenes::material_properties {
+
 inline Scene get_scene() {
   Scene scene = Scene(vec3(0, 50, 100));
 
@@ -32,3 +34,5 @@ inline Scene get_scene() {
 
   return scene;
 }
+
+}  // namespace scenes::material_properties
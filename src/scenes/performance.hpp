@@ -1,20 +1,21 @@
 /*
  * Copyright (c) 2023 Tobias Vonier. All rights reserved.
  */
+#include <optional>
+
 #include "../object_factory.hpp"
 #include "../objects/mesh.hpp"
 #include "../objects/plane.hpp"
 #include "../objects/sphere.hpp"
 #include "../scene.hpp"
 
-inline Scene get_scene() {
+namespace scenes::performance {
+
+inline Scene get_scene(std::optional<mesh_build> build = std::nullopt) {
   Scene scene = Scene(vec3(102, 255, 102));
 
   vec3 origin_plane = vec3(0.7, -1.8, -2);
 
-  Mesh m = Mesh("data/input", "dragon.obj", origin_plane + vec3(0, -0.1, 0),
-                {.color = vec3(0.8, 0.2, 0.2), .specular = vec3(0.1)}, AHLBVH);
-
   ObjectFactory factory = ObjectFactory(&scene);
   factory.new_xy_square_light(origin_plane + vec3(-1.5, 2, 2), 370, 6, 0.02);
 
@@ -24,7 +25,11 @@ inline Scene get_scene() {
   scene.set_aliasing(1);
   scene.set_tonemapping_value(-1);
 
-  scene.add_object(m);
+  scene.emplace_mesh("data/input", "dragon.obj",
+                     origin_plane + vec3(0, -0.1, 0),
+                     Material{.color = vec3(0.8, 0.2, 0.2),
+                              .specular = vec3(0.1)},
+                     build.value_or(AHLBVH));
   scene.add_object(Plane(origin_plane, vec3(0, 1, 0), {.color = vec3(0.2)},
                          {.color = vec3(0.8)}));
   // scene.add_light(light1);
@@ -46,3 +51,5 @@ inline void animation_step(Scene *scene) {
   scene->get_obj_mesh(0)->rotate(vec3(0, -0.7, -2), vec3(0, 1, 0), 10);
   scene->update_view_transform();
 }
+
+}  // namespace scenes::performance
@@ -7,6 +7,8 @@
 #include "../objects/sphere.hpp"
 #include "../scene.hpp"
 
+namespace scenes::pool {
+
 inline Scene get_scene() {
   Scene scene = Scene(vec3(0, 0, 0));
 
@@ -57,3 +59,5 @@ inline Scene get_scene() {
   scene.update_view_transform();
   return scene;
 }
+
+}  // namespace scenes::pool
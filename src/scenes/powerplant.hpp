@@ -1,6 +1,8 @@
 /*
  * Copyright (c) 2023 Tobias Vonier. All rights reserved.
  */
+#include <optional>
+
 #include "../object_factory.hpp"
 #include "../objects/mesh.hpp"
 #include "../objects/plane.hpp"
@@ -15,7 +17,9 @@
  * VISUALIZE_RANGE:
  */
 
-inline Scene get_scene() {
+namespace scenes::powerplant {
+
+inline Scene get_scene(std::optional<mesh_build> build = std::nullopt) {
   Scene scene = Scene(vec3(255));
 
   vec3 origin = vec3(0, 0, 0);
@@ -25,12 +29,12 @@ inline Scene get_scene() {
                 {.color = vec3(0.9, 0.2, 0.2),
                  .ambient = vec3(0.15),
                  .specular = vec3(0.0)},
-                AHLBVH);
+                build.value_or(AHLBVH));
 
   scene.add_object(Plane(origin - camera_pos, vec3(0, 1, 0),
                          {.color = vec3(0.2)}, {.color = vec3(0.8)}));
 
-  ObjectFactory factory = ObjectFactory(&scene);
+  // ObjectFactory factory = ObjectFactory(&scene);
   // factory.new_xy_square_light(origin + vec3(-200000, 10, 100000), 480, 4,
   // 100);
 
@@ -46,7 +50,7 @@ inline Scene get_scene() {
   scene.set_aliasing(1);
   scene.set_tonemapping_value(-1);
 
-  scene.add_object(m);
+  scene.add_object(std::move(m));
   // scene.add_light(light1);
 
   // adjust camera y and z are switched in blender
@@ -65,3 +69,5 @@ inline void animation_step(Scene *scene) {
   scene->get_obj_mesh(0)->rotate(vec3(0, -0.7, -2), vec3(0, 1, 0), 10);
   scene->update_view_transform();
 }
+
+}  // namespace scenes::powerplant
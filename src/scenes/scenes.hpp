@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+#pragma once
+
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+
+#include "../scene.hpp"
+#include "bistro.hpp"
+#include "coffe_house.hpp"
+#include "hairball.hpp"
+#include "kathedral.hpp"
+#include "kingshall.hpp"
+#include "performance.hpp"
+#include "powerplant.hpp"
+#include "smooth_shading.hpp"
+#include "smooth_shadows.hpp"
+#include "synthetic.hpp"
+
+namespace scenes {
+
+/**
+ * @brief Scenes which can be selected by name at runtime, the meshes are
+ * built with the given mesh_build or the default of the scene if not set.
+ *
+ * @return name -> get_scene.
+ */
+inline std::map<std::string,
+                std::function<Scene(std::optional<mesh_build>)>>
+get_registry() {
+  return {{"bistro", bistro::get_scene},
+          {"coffe_house", coffe_house::get_scene},
+          {"hairball", hairball::get_scene},
+          {"kathedral", kathedral::get_scene},
+          {"kingshall", kingshall::get_scene},
+          {"performance", performance::get_scene},
+          {"powerplant", powerplant::get_scene},
+          {"smooth_shading", smooth_shading::get_scene},
+          {"smooth_shadows", smooth_shadows::get_scene},
+          {"synthetic", [](std::optional<mesh_build> build) {
+             return synthetic::get_scene(build);
+           }}};
+}
+
+}  // namespace scenes
@@ -5,6 +5,8 @@
 #include "../objects/sphere.hpp"
 #include "../scene.hpp"
 
+namespace scenes::shading {
+
 inline Scene get_scene() {
   Scene scene = Scene(vec3(255));
 
@@ -24,3 +26,5 @@ inline Scene get_scene() {
   scene.add_object(s);
   return scene;
 }
+
+}  // namespace scenes::shading
@@ -1,27 +1,33 @@
 /*
  * Copyright (c) 2023 Tobias Vonier. All rights reserved.
  */
+#include <optional>
+
 #include "../object_factory.hpp"
 #include "../objects/mesh.hpp"
 #include "../objects/plane.hpp"
 #include "../objects/sphere.hpp"
 #include "../scene.hpp"
 
-inline Scene get_scene() {
+namespace scenes::smooth_shading {
+
+inline Scene get_scene(std::optional<mesh_build> build = std::nullopt) {
   Scene scene = Scene(vec3(0, 50, 100));
 
   vec3 origin_plane = vec3(0, 0, -13);
 
-  Mesh m = Mesh("data/input/bunny_fin.obj", origin_plane + vec3(-2, 0, 0),
-                {.color = vec3(0, 1, 0), .specular = 0.2});
+  Mesh m = Mesh("data/input", "bunny_fin.obj", origin_plane + vec3(-2, 0, 0),
+                {.color = vec3(0, 1, 0), .specular = vec3(0.2)},
+                build.value_or(ASAH));
   Mesh m_s =
-      Mesh("data/input/bunny_fin_smooth.obj", origin_plane + vec3(2, 0, 0),
-           {.color = vec3(0, 1, 0), .specular = 0.2});
+      Mesh("data/input", "bunny_fin_smooth.obj", origin_plane + vec3(2, 0, 0),
+           {.color = vec3(0, 1, 0), .specular = vec3(0.2)},
+           build.value_or(ASAH));
 
   Plane plane =
       Plane(origin_plane, vec3(0, 1, 0),
-            {.color = vec3(1, 1, 1), .specular = 0, .mirror = 0.0},
-            {.color = vec3(0.6, 0.6, 0.6), .specular = 0, .mirror = 0.0},
+            {.color = vec3(1, 1, 1), .specular = vec3(0), .mirror = 0.0},
+            {.color = vec3(0.6, 0.6, 0.6), .specular = vec3(0), .mirror = 0.0},
             vec2(100, 15));
 
   ObjectFactory factory = ObjectFactory(&scene);
@@ -33,8 +39,8 @@ inline Scene get_scene() {
   scene.set_aliasing(4);
   scene.set_tonemapping_value(-1);
 
-  scene.add_object(m);
-  scene.add_object(m_s);
+  scene.add_object(std::move(m));
+  scene.add_object(std::move(m_s));
   scene.add_object(plane);
 
   scene.get_camera()->move(vec3(0, 2.5, 0));
@@ -43,3 +49,5 @@ inline Scene get_scene() {
 
   return scene;
 }
+
+}  // namespace scenes::smooth_shading
@@ -1,30 +1,34 @@
 /*
  * Copyright (c) 2023 Tobias Vonier. All rights reserved.
  */
+#include <optional>
+
 #include "../object_factory.hpp"
 #include "../objects/mesh.hpp"
 #include "../objects/plane.hpp"
 #include "../objects/sphere.hpp"
 #include "../scene.hpp"
 
-inline Scene get_scene() {
+namespace scenes::smooth_shadows {
+
+inline Scene get_scene(std::optional<mesh_build> build = std::nullopt) {
   Scene scene = Scene(vec3(0, 50, 100));
 
   vec3 origin = vec3(0, 0, -11);
 
-  Mesh c = Mesh("data/input/cube.obj", origin + vec3(1.5, 1, 0),
-                {.color = vec3(0, 1, 0), .specular = 0.2});
-  Sphere s = Sphere(origin + vec3(-1.5, 1, 0), 1,
-                    {.color = vec3(1, 0, 1), .specular = 0.9, .pow_m = 10});
+  Mesh c = Mesh("data/input", "cube.obj", origin + vec3(1.5, 1, 0),
+                {.color = vec3(0, 1, 0), .specular = vec3(0.2)},
+                build.value_or(ASAH));
+  Sphere s =
+      Sphere(origin + vec3(-1.5, 1, 0), 1,
+             {.color = vec3(1, 0, 1), .specular = vec3(0.9), .pow_m = 10});
 
   Plane plane =
       Plane(origin, vec3(0, 1, 0),
-            {.color = vec3(1, 1, 1), .specular = 0, .mirror = 0.0},
-            {.color = vec3(0.6, 0.6, 0.6), .specular = 0, .mirror = 0.4},
+            {.color = vec3(1, 1, 1), .specular = vec3(0), .mirror = 0.0},
+            {.color = vec3(0.6, 0.6, 0.6), .specular = vec3(0), .mirror = 0.4},
             vec2(100, 50));
 
-  Pointlight light1 = Pointlight(origin + vec3(-3, 5, 4), 250);
-
   scene.get_camera()->set_resolution(600);
   scene.get_camera()->set_sensor_size(1, 1);
 
@@ -33,9 +37,10 @@ inline Scene get_scene() {
 
   ObjectFactory factory = ObjectFactory(&scene);
 
-  factory.new_xy_square_light(origin + vec3(-3, 4, 5), 250, 5, 0.4);
+  // same square as the former 5 x 5 point lights with a spacing of 0.4
+  factory.new_xy_area_light(origin + vec3(-3.2, 3.8, 5), 250, 2);
 
-  scene.add_object(c);
+  scene.add_object(std::move(c));
   scene.add_object(s);
   scene.add_object(plane);
 
@@ -45,3 +50,5 @@ inline Scene get_scene() {
 
   return scene;
 }
+
+}  // namespace scenes::smooth_shadows
@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+#include <optional>
+
+#include "../scene.hpp"
+#include "../scene_generator.hpp"
+
+namespace scenes::synthetic {
+
+/**
+ * @brief Generated scene, needs no assets (see SceneGenerator).
+ *
+ * @param settings triangle count, distribution and spheres of the scene.
+ */
+inline Scene get_scene(const generator_settings &settings) {
+  return SceneGenerator(settings).get_scene();
+}
+
+/**
+ * @brief Generated scene with the default settings.
+ *
+ * @param build acceleration structure of the mesh, the default if not set.
+ */
+inline Scene get_scene(std::optional<mesh_build> build = std::nullopt) {
+  generator_settings settings;
+  if (build) {
+    settings.build = *build;
+  }
+  return get_scene(settings);
+}
+
+}  // namespace scenes::synthetic
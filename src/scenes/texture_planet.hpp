@@ -5,6 +5,8 @@
 #include "../objects/plane.hpp"
 #include "../objects/sphere.hpp"
 
+namespace scenes::texture_planet {
+
 inline Scene get_scene() {
   Scene scene = Scene(vec3(0, 50, 100));
 
@@ -34,3 +36,5 @@ inline Scene get_scene() {
 
   return scene;
 }
+
+}  // namespace scenes::texture_planet
@@ -7,6 +7,8 @@
 #include "../objects/sphere.hpp"
 #include "../scene.hpp"
 
+namespace scenes::willow_tree {
+
 inline Scene get_scene() {
   Scene scene = Scene(vec3(255, 255, 255));
 
@@ -28,7 +30,7 @@ inline Scene get_scene() {
   scene.set_aliasing(1);
   scene.set_tonemapping_value(-1);
 
-  scene.add_object(tree);
+  scene.add_object(std::move(tree));
 
   return scene;
 }
@@ -37,3 +39,5 @@ inline void animation_step(Scene *scene) {
   scene->get_camera()->rotate(vec3(0, 0, -5), vec3(0, 1, 0), 5);
   scene->update_view_transform();
 }
+
+}  // namespace scenes::willow_tree
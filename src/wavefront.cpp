@@ -0,0 +1,369 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+
+#include "wavefront.hpp"
+
+#include <algorithm>
+#include <execution>
+#include <limits>
+#include <numeric>
+
+#include "objects/perf_counters.hpp"
+#include "objects/timeline.hpp"
+#include "scene.hpp"
+
+// ----------------------------------------------------------------------------
+// ray_batch
+
+size_t ray_batch::size() const { return t_max.size(); }
+
+void ray_batch::clear() { resize(0); }
+
+void ray_batch::resize(size_t size) {
+  for (int a = 0; a < 3; a++) {
+    origin[a].resize(size);
+    direction[a].resize(size);
+  }
+  t_max.resize(size);
+  owner.resize(size);
+}
+
+void ray_batch::set(size_t i, const Ray &ray, float t, uint32_t ray_owner) {
+  vec3 o = ray.get_origin();
+  vec3 d = ray.get_direction();
+  for (int a = 0; a < 3; a++) {
+    origin[a][i] = o[a];
+    direction[a][i] = d[a];
+  }
+  t_max[i] = t;
+  owner[i] = ray_owner;
+}
+
+void ray_batch::push_back(const Ray &ray, float t, uint32_t ray_owner) {
+  resize(size() + 1);
+  set(size() - 1, ray, t, ray_owner);
+}
+
+Ray ray_batch::get_ray(size_t i) const {
+  return Ray::from_normalized(
+      vec3(origin[0][i], origin[1][i], origin[2][i]),
+      vec3(direction[0][i], direction[1][i], direction[2][i]));
+}
+
+// ----------------------------------------------------------------------------
+// wavefront_wave
+
+void wavefront_wave::clear() {
+  rays.clear();
+  hits.clear();
+  unshadowed.clear();
+  ambient.clear();
+  visible.clear();
+  child.clear();
+  light.clear();
+}
+
+// ----------------------------------------------------------------------------
+// WavefrontIntegrator
+
+WavefrontIntegrator::WavefrontIntegrator(Scene *scene) {
+  _scene = scene;
+  _waves.resize(1);
+}
+
+void WavefrontIntegrator::trace_rows(int y_start, int y_end, Image *image) {
+  generate(y_start, y_end);
+
+  // every wave spawns the next one, the last one is empty
+  uint depth = 0;
+  while (_waves[depth].rays.size() > 0) {
+    extend(depth);
+    shade(depth);
+    trace_shadows(depth);
+    depth++;
+  }
+
+  // reflected light is needed first, so resolve from the last wave back
+  for (uint d = depth; d-- > 0;) {
+    resolve(d);
+  }
+  write_pixels(image);
+}
+
+template <typename Function>
+void WavefrontIntegrator::for_each_chunk(size_t count, Function function) {
+  std::vector<size_t> chunks((count + WAVEFRONT_CHUNK_SIZE - 1) /
+                             WAVEFRONT_CHUNK_SIZE);
+  std::iota(chunks.begin(), chunks.end(), 0);
+  std::for_each(std::execution::par, chunks.begin(), chunks.end(),
+                [&](size_t chunk) {
+                  size_t begin = chunk * WAVEFRONT_CHUNK_SIZE;
+                  function(begin,
+                           std::min(begin + WAVEFRONT_CHUNK_SIZE, count));
+                });
+}
+
+/**
+ * @brief Camera rays of all samples of the rows, tile by tile so
+ * neighbouring rays are close in the queue.
+ */
+void WavefrontIntegrator::generate(int y_start, int y_end) {
+  TIMELINE_ZONE("wavefront generate");
+  Scene &scene = *_scene;
+  int width = scene._camera.get_resolution().x;
+
+  _pixels.clear();
+  for (int x_start = 0; x_start < width; x_start += RENDER_TILE_SIZE) {
+    int x_end = std::min(width, x_start + RENDER_TILE_SIZE);
+    for (int y = y_start; y < y_end; y++) {
+      for (int x = x_start; x < x_end; x++) {
+        _pixels.push_back({x, y});
+      }
+    }
+  }
+
+  size_t samples = scene._aliasing_positions.size();
+  wavefront_wave &wave = _waves[0];
+  wave.clear();
+  wave.rays.resize(_pixels.size() * samples);
+  for_each_chunk(wave.rays.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      point pixel = _pixels[i / samples];
+      Ray ray = scene._camera.get_ray(vec2(pixel.x, pixel.y),
+                                      scene._aliasing_positions[i % samples],
+                                      0.2);
+      wave.rays.set(i, ray, MAXFLOAT, i);
+    }
+  });
+}
+
+/**
+ * @brief Closest hit of every ray of the wave, like Scene::get_light (mesh
+ * materials are looked up when shading).
+ */
+void WavefrontIntegrator::extend(uint depth) {
+  TIMELINE_ZONE("wavefront extend");
+  Scene &scene = *_scene;
+  wavefront_wave &wave = _waves[depth];
+  RayType type = depth == 0 ? RAY_PRIMARY : RAY_REFLECTION;
+
+  size_t count = wave.rays.size();
+  scene._stats.rays += count;
+  wave.hits.assign(count, wavefront_hit());
+  for_each_chunk(count, [&](size_t begin, size_t end) {
+    PERF_SCOPE(PERF_PRIMARY);
+    for (size_t i = begin; i < end; i++) {
+      Ray ray = wave.rays.get_ray(i);
+      if (scene._capture) {
+        scene._capture->record(ray, MAXFLOAT, type);
+      }
+
+      wavefront_hit &hit = wave.hits[i];
+      for (Sphere &sphere : scene._obj_spheres) {
+        Intersection intersect = sphere.intersect(ray);
+        if (intersect.found && intersect.t <= hit.intersection.t) {
+          hit.intersection = intersect;
+        }
+      }
+      for (Plane &plane : scene._obj_planes) {
+        Intersection intersect = plane.intersect(ray);
+        if (intersect.found && intersect.t <= hit.intersection.t) {
+          hit.intersection = intersect;
+        }
+      }
+      float t_best = hit.intersection.t;
+      for (size_t m = 0; m < scene._obj_meshes.size(); m++) {
+        TriangleIntersection intersect =
+            scene._obj_meshes[m].intersect_triangles(ray);
+        if (intersect.found && intersect.t <= t_best) {
+          hit.mesh = m;
+          hit.triangle = intersect;
+          t_best = intersect.t;
+        }
+      }
+    }
+  });
+}
+
+/**
+ * @brief Phong terms of all hits and lights, grouped by material. Spawns the
+ * shadow rays (sorted by light) and the reflection rays of the next wave.
+ */
+void WavefrontIntegrator::shade(uint depth) {
+  TIMELINE_ZONE("wavefront shade");
+  if (_waves.size() <= depth + 1) {
+    _waves.resize(depth + 2);
+  }
+  Scene &scene = *_scene;
+  wavefront_wave &wave = _waves[depth];
+  wavefront_wave &next = _waves[depth + 1];
+
+  size_t count = wave.rays.size();
+  size_t lights = scene._lights.size();
+  wave.unshadowed.assign(count * lights, vec3(0));
+  wave.ambient.assign(count * lights, vec3(0));
+  wave.visible.assign(count * lights, 1);
+  wave.child.assign(count, -1);
+  _light_rays.resize(count * lights);
+
+  // misses last, mesh hits by mesh and material
+  auto get_key = [&wave](uint32_t i) {
+    const wavefront_hit &hit = wave.hits[i];
+    if (hit.mesh < 0) {
+      return hit.intersection.found ? uint64_t(0)
+                                    : std::numeric_limits<uint64_t>::max();
+    }
+    return (uint64_t(hit.mesh) + 1) << 32 | hit.triangle.material_id;
+  };
+  _shading_order.resize(count);
+  std::iota(_shading_order.begin(), _shading_order.end(), 0);
+  std::sort(_shading_order.begin(), _shading_order.end(),
+            [&get_key](uint32_t a, uint32_t b) {
+              uint64_t key_a = get_key(a);
+              uint64_t key_b = get_key(b);
+              return key_a < key_b || (key_a == key_b && a < b);
+            });
+
+  for_each_chunk(count, [&](size_t begin, size_t end) {
+    PERF_SCOPE(PERF_SHADING);
+    for (size_t k = begin; k < end; k++) {
+      uint32_t i = _shading_order[k];
+      wavefront_hit &hit = wave.hits[i];
+      if (hit.mesh >= 0) {
+        hit.intersection =
+            scene._obj_meshes[hit.mesh].get_intersect(hit.triangle);
+      }
+      if (!hit.intersection.found || NO_SHADING) {
+        continue;
+      }
+
+      // same terms as Scene::calculate_light
+      vec3 v = wave.rays.get_ray(i).get_direction();
+      hit.intersection.normal = glm::normalize(hit.intersection.normal);
+      for (size_t l = 0; l < lights; l++) {
+        phong_terms terms = scene.get_phong_terms(
+            scene._lights[l], hit.intersection.material,
+            hit.intersection.point, hit.intersection.normal, v);
+        size_t id = i * lights + l;
+        wave.unshadowed[id] = terms.unshadowed;
+        wave.ambient[id] = terms.ambient;
+        _light_rays.set(id, terms.ray_to_light, terms.distance, id);
+      }
+    }
+  });
+
+  next.clear();
+  for (size_t i = 0; i < count && !NO_SHADING; i++) {
+    const Intersection &hit = wave.hits[i].intersection;
+    if (hit.found && hit.material.mirror > 0) {
+      wave.child[i] = next.rays.size();
+      next.rays.push_back(
+          scene.generate_reflection_ray(hit.point, hit.normal,
+                                        wave.rays.get_ray(i).get_direction()),
+          MAXFLOAT, i);
+    }
+  }
+
+  // the light is only visible or not if it adds light
+  _shadow_rays.clear();
+  for (size_t l = 0; l < lights; l++) {
+    for (size_t i = 0; i < count; i++) {
+      size_t id = i * lights + l;
+      if (wave.unshadowed[id] != vec3(0)) {
+        _shadow_rays.push_back(_light_rays.get_ray(id), _light_rays.t_max[id],
+                               id);
+      }
+    }
+  }
+}
+
+void WavefrontIntegrator::trace_shadows(uint depth) {
+  TIMELINE_ZONE("wavefront shadow rays");
+  Scene &scene = *_scene;
+  wavefront_wave &wave = _waves[depth];
+
+  // every shadow ray has its own owner, so the chunks write disjoint entries
+  scene._stats.rays += _shadow_rays.size();
+  for_each_chunk(_shadow_rays.size(), [&](size_t begin, size_t end) {
+    PERF_SCOPE(PERF_SHADOW);
+    for (size_t j = begin; j < end; j++) {
+      Ray ray = _shadow_rays.get_ray(j);
+      float t_max = _shadow_rays.t_max[j];
+      if (scene._capture) {
+        scene._capture->record(ray, t_max, RAY_SHADOW);
+      }
+      wave.visible[_shadow_rays.owner[j]] = !scene.intersect_any(ray, t_max);
+    }
+  });
+}
+
+/**
+ * @brief Light along every ray of the wave, combined like in
+ * Scene::calculate_light (needs the light of the next wave).
+ */
+void WavefrontIntegrator::resolve(uint depth) {
+  TIMELINE_ZONE("wavefront resolve");
+  Scene &scene = *_scene;
+  wavefront_wave &wave = _waves[depth];
+  const std::vector<vec3> &reflected = _waves[depth + 1].light;
+  size_t lights = scene._lights.size();
+
+  wave.light.resize(wave.rays.size());
+  for_each_chunk(wave.rays.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      const Intersection &hit = wave.hits[i].intersection;
+      if (NO_SHADING) {
+        wave.light[i] = hit.material.color * vec3(255);
+        continue;
+      }
+      if (!hit.found) {
+        wave.light[i] = vec3(-1);
+        continue;
+      }
+
+      vec3 res_light = vec3(0, 0, 0);
+      for (size_t l = 0; l < lights; l++) {
+        size_t id = i * lights + l;
+        vec3 l_material = vec3(0, 0, 0);
+        if (wave.visible[id]) {
+          l_material = wave.unshadowed[id];
+        }
+        res_light += l_material + wave.ambient[id];
+      }
+
+      vec3 mirror_light = vec3(0, 0, 0);
+      if (wave.child[i] >= 0) {
+        mirror_light = reflected[wave.child[i]];
+        if (mirror_light.x == -1) {
+          mirror_light = vec3(0, 0, 0);
+        }
+      }
+      res_light = (res_light * (1 - hit.material.mirror)) +
+                  (mirror_light * hit.material.mirror);
+      wave.light[i] = glm::round(res_light);
+    }
+  });
+}
+
+/// @brief average the samples of every pixel like Scene::get_pixel_color.
+void WavefrontIntegrator::write_pixels(Image *image) {
+  Scene &scene = *_scene;
+  const std::vector<vec3> &lights = _waves[0].light;
+  size_t samples = scene._aliasing_positions.size();
+
+  for_each_chunk(_pixels.size(), [&](size_t begin, size_t end) {
+    for (size_t p = begin; p < end; p++) {
+      vec3 color = vec3(0, 0, 0);
+      for (size_t s = 0; s < samples; s++) {
+        vec3 light = lights[p * samples + s];
+        if (light.x == -1) {
+          light = scene._standart_light;
+        }
+        light *= 1.f / samples;
+        color += light;
+      }
+      image->set_pixel(_pixels[p], color);
+    }
+  });
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2023 Tobias Vonier. All rights reserved.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "image.hpp"
+#include "objects/object.hpp"
+#include "objects/ray.hpp"
+#include "objects/triangle.hpp"
+
+using glm::vec3;
+
+class Scene;
+
+// rays per task of the parallel stages
+#define WAVEFRONT_CHUNK_SIZE 1024
+
+/// @brief rays in structure of arrays layout.
+struct ray_batch {
+  std::array<std::vector<float>, 3> origin;
+  std::array<std::vector<float>, 3> direction;
+  std::vector<float> t_max;
+  /// @brief what the ray belongs to (e.g. the ray that spawned it).
+  std::vector<uint32_t> owner;
+
+  size_t size() const;
+  void clear();
+  void resize(size_t size);
+  void set(size_t i, const Ray &ray, float t, uint32_t ray_owner);
+  void push_back(const Ray &ray, float t, uint32_t ray_owner);
+  Ray get_ray(size_t i) const;
+};
+
+/// @brief closest hit of an extension ray.
+struct wavefront_hit {
+  /// @brief hit of a sphere or plane, of a mesh after shading.
+  Intersection intersection;
+  /// @brief hit of the mesh, the material is looked up when shading.
+  TriangleIntersection triangle;
+  /// @brief id of the hit mesh or -1.
+  int mesh = -1;
+};
+
+/// @brief the rays of one bounce and their shading.
+struct wavefront_wave {
+  /// @brief camera rays (owner is the sample) or reflection rays (owner is
+  /// the ray of the previous wave).
+  ray_batch rays;
+  std::vector<wavefront_hit> hits;
+  /// @brief phong terms per ray and light, at [ray * lights + light].
+  std::vector<vec3> unshadowed;
+  std::vector<vec3> ambient;
+  std::vector<uint8_t> visible;
+  /// @brief index of the reflection ray in the next wave or -1.
+  std::vector<int32_t> child;
+  /// @brief light along the ray as Scene::get_light returns it.
+  std::vector<vec3> light;
+
+  void clear();
+};
+
+/**
+ * @brief Renders rows of an image in stages over queues of rays instead of
+ * depth first per camera ray (Scene::get_light).
+ *
+ * Every bounce is one wave: all rays of the wave are intersected (extension),
+ * the hits are shaded grouped by material, which spawns the shadow rays
+ * (traced light by light) and the reflection rays of the next wave. When no
+ * rays are left the light is resolved from the last wave back to the camera.
+ * Every stage runs in parallel chunks of the queues (the acceleration
+ * structures keep the state of a query on the stack of the tracing thread).
+ *
+ * The image is the same as with the recursive integrator, the rays are only
+ * traced in a different order. Shadow rays of lights that add no light
+ * (surface facing away) are not traced.
+ */
+class WavefrontIntegrator {
+ public:
+  explicit WavefrontIntegrator(Scene *scene);
+
+  /// @brief render the rows [y_start, y_end) into image.
+  void trace_rows(int y_start, int y_end, Image *image);
+
+ private:
+  Scene *_scene;
+  std::vector<wavefront_wave> _waves;
+  /// @brief pixels in tile order, every pixel has one ray per sample.
+  std::vector<point> _pixels;
+  /// @brief shadow ray of every ray and light of the current wave.
+  ray_batch _light_rays;
+  /// @brief shadow rays that have to be traced, sorted by light.
+  ray_batch _shadow_rays;
+  /// @brief order of the hits in which they get shaded.
+  std::vector<uint32_t> _shading_order;
+
+  void generate(int y_start, int y_end);
+  void extend(uint depth);
+  void shade(uint depth);
+  void trace_shadows(uint depth);
+  void resolve(uint depth);
+  void write_pixels(Image *image);
+
+  template <typename Function>
+  void for_each_chunk(size_t count, Function function);
+};